@@ -0,0 +1,592 @@
+// Minimal ElasticSearch stand-in for import benchmarks. It answers the calls
+// MeSHImport makes (index admin, aliases, _bulk, index/update, search and
+// scroll) with plausible responses, keeps no documents and records the
+// request count, bytes, documents and latency per endpoint:
+//
+//   ./es_standin --port 9299 [--latency <ms>] [--bulk-document-cost <us>]
+//                [--reject <percent>] [--reject-items <percent>]
+//   curl -s localhost:9299/_standin/stats
+//   curl -s -XPOST localhost:9299/_standin/reset
+//
+// --latency and --bulk-document-cost add a fixed and a per-document delay,
+// to get closer to a real cluster than an instant reply. --reject answers that
+// share of _bulk requests with 429, and --reject-items rejects that share of
+// the actions in the others with es_rejected_execution_exception.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_PORT (9299)
+
+
+struct EndpointStats
+{
+    EndpointStats() : requests(0), documents(0), bytes_received(0), bytes_sent(0) {}
+
+    long requests;
+    long documents;
+    long bytes_received;
+    long bytes_sent;
+    std::vector<double> latencies_ms;
+};
+
+struct Request
+{
+    std::string method;
+    std::string path;  //Without the query string
+    std::string query;
+    std::string body;
+    bool keep_alive;
+};
+
+struct Response
+{
+    Response() : status(200) {}
+
+    int status;
+    std::string body;
+};
+
+
+static int s_latency_ms = 0;
+static int s_bulk_document_cost_us = 0;
+static int s_reject_percent = 0;
+static int s_reject_items_percent = 0;
+
+static std::mutex s_mutex; //Guards everything below
+static std::map<std::string, EndpointStats> s_stats;
+static std::chrono::steady_clock::time_point s_stats_start = std::chrono::steady_clock::now();
+static std::map<std::string, std::set<std::string> > s_indices; //Index name -> aliases
+
+
+double Percentile(std::vector<double>& values, double percentile)
+{
+    if (values.empty())
+        return 0.0;
+
+    size_t rank = std::min(values.size()-1, static_cast<size_t>(percentile/100.0*values.size()));
+    std::nth_element(values.begin(), values.begin()+rank, values.end());
+    return values[rank];
+}
+
+std::string StatsJson()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    long requests = 0, documents = 0, bytes_received = 0, bytes_sent = 0;
+    std::ostringstream endpoints;
+    endpoints.setf(std::ios::fixed);
+    endpoints.precision(3);
+    for (std::map<std::string, EndpointStats>::iterator it=s_stats.begin(); it!=s_stats.end(); ++it)
+    {
+        EndpointStats& stats = it->second;
+        requests += stats.requests;
+        documents += stats.documents;
+        bytes_received += stats.bytes_received;
+        bytes_sent += stats.bytes_sent;
+
+        endpoints << (s_stats.begin()==it ? "" : ", ") << "\"" << it->first << "\": {"
+                  << "\"requests\": " << stats.requests << ", \"documents\": " << stats.documents
+                  << ", \"bytes_received\": " << stats.bytes_received << ", \"bytes_sent\": " << stats.bytes_sent
+                  << ", \"p50_ms\": " << Percentile(stats.latencies_ms, 50) << ", \"p95_ms\": " << Percentile(stats.latencies_ms, 95)
+                  << ", \"p99_ms\": " << Percentile(stats.latencies_ms, 99) << ", \"max_ms\": " << Percentile(stats.latencies_ms, 100) << "}";
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-s_stats_start).count();
+    std::ostringstream json;
+    json << "{\"seconds\": " << seconds << ", \"requests\": " << requests << ", \"documents\": " << documents
+         << ", \"bytes_received\": " << bytes_received << ", \"bytes_sent\": " << bytes_sent
+         << ", \"endpoints\": {" << endpoints.str() << "}}\n";
+    return json.str();
+}
+
+void Split(const std::string& path, std::vector<std::string>& segments)
+{
+    std::string::size_type start = 1;
+    while (start < path.length())
+    {
+        std::string::size_type end = path.find('/', start);
+        if (std::string::npos == end)
+            end = path.length();
+        if (end > start)
+            segments.push_back(path.substr(start, end-start));
+        start = end+1;
+    }
+}
+
+bool MatchesPattern(const std::string& name, const std::string& pattern) //Only a trailing '*' is supported
+{
+    if (!pattern.empty() && '*'==pattern[pattern.length()-1])
+        return 0 == name.compare(0, pattern.length()-1, pattern, 0, pattern.length()-1);
+    return name == pattern;
+}
+
+long CountBulkDocuments(const std::string& body)
+{
+    //Action lines start with {"index", {"create", {"update" or {"delete". Sources follow all but delete
+    long documents = 0;
+    std::string::size_type line_start = 0;
+    bool expect_source = false;
+    while (line_start < body.length())
+    {
+        std::string::size_type line_end = body.find('\n', line_start);
+        if (std::string::npos == line_end)
+            line_end = body.length();
+
+        if (expect_source)
+        {
+            expect_source = false;
+        }
+        else if (line_end > line_start)
+        {
+            documents++;
+            expect_source = (0 != body.compare(line_start, 10, "{\"delete\":"));
+        }
+        line_start = line_end+1;
+    }
+    return documents;
+}
+
+std::string BulkResponse(const std::string& body, bool& errors)
+{
+    //Reports the actions in order, like Elasticsearch does, rejecting some of them
+    std::ostringstream items;
+    errors = false;
+    std::string::size_type line_start = 0;
+    bool expect_source = false;
+    bool first = true;
+    while (line_start < body.length())
+    {
+        std::string::size_type line_end = body.find('\n', line_start);
+        if (std::string::npos == line_end)
+            line_end = body.length();
+
+        if (expect_source)
+        {
+            expect_source = false;
+        }
+        else if (line_end > line_start)
+        {
+            std::string line = body.substr(line_start, line_end-line_start);
+            bool is_delete = (0 == line.compare(0, 10, "{\"delete\":"));
+            expect_source = !is_delete;
+            std::string::size_type id_start = line.find("\"_id\":\"");
+            std::string id = (std::string::npos==id_start) ? "" : line.substr(id_start+7, line.find('"', id_start+7)-id_start-7);
+
+            items << (first ? "" : ", ") << "{\"" << (is_delete ? "delete" : "index") << "\": {\"_id\": \"" << id << "\", ";
+            if (rand()%100 < s_reject_items_percent)
+            {
+                items << "\"status\": 429, \"error\": {\"type\": \"es_rejected_execution_exception\", \"reason\": \"rejected by es_standin\"}}}";
+                errors = true;
+            }
+            else
+            {
+                items << "\"status\": " << (is_delete ? 200 : 201) << "}}";
+            }
+            first = false;
+        }
+        line_start = line_end+1;
+    }
+    return "{\"took\": 1, \"errors\": " + std::string(errors ? "true" : "false") + ", \"items\": [" + items.str() + "]}";
+}
+
+std::string AliasesJson(const std::string& index_pattern, const std::string& alias_pattern, bool& found)
+{
+    std::ostringstream json;
+    json << "{";
+    found = false;
+    for (std::map<std::string, std::set<std::string> >::iterator it=s_indices.begin(); it!=s_indices.end(); ++it)
+    {
+        std::ostringstream aliases;
+        bool has_alias = false;
+        for (std::set<std::string>::iterator alias=it->second.begin(); alias!=it->second.end(); ++alias)
+        {
+            if (alias_pattern.empty() || MatchesPattern(*alias, alias_pattern))
+            {
+                aliases << (has_alias ? ", " : "") << "\"" << *alias << "\": {}";
+                has_alias = true;
+            }
+        }
+        if (MatchesPattern(it->first, index_pattern) && (has_alias || alias_pattern.empty()))
+        {
+            json << (found ? ", " : "") << "\"" << it->first << "\": {\"aliases\": {" << aliases.str() << "}}";
+            found = true;
+        }
+    }
+    json << "}";
+    return json.str();
+}
+
+void ApplyAliasActions(const std::string& body)
+{
+    //Good enough for the actions VersionedIndex sends: {"add"|"remove"|"remove_index": {"index": "...", "alias": "..."}}
+    static const char* ACTIONS[] = {"\"add\"", "\"remove_index\"", "\"remove\""};
+    std::string::size_type position = 0;
+    while (true)
+    {
+        std::string::size_type next = std::string::npos;
+        int action = -1;
+        for (int i=0; i<3; i++)
+        {
+            std::string::size_type found = body.find(ACTIONS[i], position);
+            if (found < next)
+            {
+                next = found;
+                action = i;
+            }
+        }
+        if (std::string::npos == next)
+            break;
+
+        std::string::size_type end = body.find('}', next);
+        std::string object = body.substr(next, end==std::string::npos ? std::string::npos : end-next);
+        std::string values[2];
+        const char* keys[2] = {"\"index\"", "\"alias\""};
+        for (int i=0; i<2; i++)
+        {
+            std::string::size_type key = object.find(keys[i]);
+            std::string::size_type open = (std::string::npos==key) ? key : object.find('"', key+strlen(keys[i]));
+            std::string::size_type close = (std::string::npos==open) ? open : object.find('"', open+1);
+            if (std::string::npos != close)
+                values[i] = object.substr(open+1, close-open-1);
+        }
+
+        if (0 == action)
+            s_indices[values[0]].insert(values[1]);
+        else if (1 == action)
+            s_indices.erase(values[0]);
+        else if (s_indices.count(values[0]))
+            s_indices[values[0]].erase(values[1]);
+
+        position = next+1;
+    }
+}
+
+std::string Handle(const Request& request, Response& response, long& documents)
+{
+    std::vector<std::string> segments;
+    Split(request.path, segments);
+    const std::string last = segments.empty() ? "" : segments.back();
+    documents = 0;
+
+    if (segments.empty())
+    {
+        response.body = "{\"status\": 200, \"name\": \"es_standin\", \"version\": {\"number\": \"6.8.0\"}, \"tagline\": \"You Know, for Search\"}";
+        return "root";
+    }
+
+    if ("_standin" == segments[0])
+    {
+        if (2==segments.size() && "reset"==segments[1])
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_stats.clear();
+            s_stats_start = std::chrono::steady_clock::now();
+            response.body = "{\"acknowledged\": true}";
+        }
+        else
+        {
+            response.body = StatsJson();
+        }
+        return "";
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if ("_bulk" == last)
+    {
+        documents = CountBulkDocuments(request.body);
+        if (rand()%100 < s_reject_percent)
+        {
+            response.status = 429;
+            response.body = "{\"error\": {\"type\": \"es_rejected_execution_exception\"}, \"status\": 429}";
+            return "bulk_rejected";
+        }
+        bool errors;
+        response.body = BulkResponse(request.body, errors);
+        return errors ? "bulk_partial" : "bulk";
+    }
+    if ("_search"==last || (2<=segments.size() && "_search"==segments[segments.size()-2] && "scroll"==last))
+    {
+        bool scroll = ("scroll"==last || std::string::npos!=request.query.find("scroll="));
+        response.body = std::string("{") + (scroll ? "\"_scroll_id\": \"standin\", " : "") +
+                        "\"took\": 1, \"timed_out\": false, \"hits\": {\"total\": 0, \"max_score\": null, \"hits\": []}}";
+        return scroll ? "scroll" : "search";
+    }
+    if ("_update"==last || (3<=segments.size() && "_update"==segments[segments.size()-2]))
+    {
+        documents = 1;
+        response.body = "{\"result\": \"updated\", \"_id\": \"" + last + "\"}";
+        return "update";
+    }
+    if ("_aliases" == last)
+    {
+        ApplyAliasActions(request.body);
+        response.body = "{\"acknowledged\": true}";
+        return "aliases";
+    }
+    if ("_alias" == last || (2==segments.size() && "_alias"==segments[0]))
+    {
+        bool found;
+        if ("_alias" == last) //<index pattern>/_alias
+        {
+            response.body = AliasesJson(segments.size()>1 ? segments[0] : "*", "", found);
+        }
+        else //_alias/<alias>
+        {
+            response.body = AliasesJson("*", segments[1], found);
+            response.status = found ? 200 : 404;
+        }
+        return "alias";
+    }
+    if ("_forcemerge"==last || "_refresh"==last || "_settings"==last || "_flush"==last)
+    {
+        response.body = "{\"acknowledged\": true, \"_shards\": {\"total\": 1, \"successful\": 1, \"failed\": 0}}";
+        return last.substr(1);
+    }
+    if (1 == segments.size())
+    {
+        const std::string& index = segments[0];
+        bool exists = (0 != s_indices.count(index));
+        if ("PUT" == request.method)
+        {
+            s_indices[index];
+            response.body = "{\"acknowledged\": true, \"shards_acknowledged\": true, \"index\": \"" + index + "\"}";
+            return "create_index";
+        }
+        if ("DELETE" == request.method)
+        {
+            s_indices.erase(index);
+            response.status = exists ? 200 : 404;
+            response.body = exists ? "{\"acknowledged\": true}" : "{\"error\": {\"type\": \"index_not_found_exception\"}, \"status\": 404}";
+            return "delete_index";
+        }
+        response.status = exists ? 200 : 404;
+        response.body = "{}";
+        return ("HEAD"==request.method) ? "exists" : "get_index";
+    }
+
+    //index/type/id or index/_doc/id
+    documents = 1;
+    response.body = "{\"result\": \"" + std::string("GET"==request.method ? "found" : "DELETE"==request.method ? "deleted" : "created") +
+                    "\", \"_id\": \"" + last + "\", \"found\": false}";
+    return "GET"==request.method ? "get" : "DELETE"==request.method ? "delete" : "index";
+}
+
+bool ReadRequest(int socket, std::string& buffer, Request& request)
+{
+    char chunk[64*1024];
+    std::string::size_type header_end;
+    while (std::string::npos == (header_end=buffer.find("\r\n\r\n")))
+    {
+        ssize_t count = recv(socket, chunk, sizeof(chunk), 0);
+        if (0 >= count)
+            return false;
+        buffer.append(chunk, count);
+    }
+
+    std::istringstream headers(buffer.substr(0, header_end));
+    std::string target, version, line;
+    headers >> request.method >> target >> version;
+    std::getline(headers, line);
+
+    size_t content_length = 0;
+    bool chunked = false;
+    request.keep_alive = ("HTTP/1.1" == version);
+    while (std::getline(headers, line))
+    {
+        std::string::size_type colon = line.find(':');
+        if (std::string::npos == colon)
+            continue;
+        std::string name = line.substr(0, colon);
+        std::string value = line.substr(colon+1);
+        value.erase(0, value.find_first_not_of(' '));
+        value.erase(value.find_last_not_of("\r ")+1);
+        if (0 == strcasecmp("Content-Length", name.c_str()))
+            content_length = strtoul(value.c_str(), NULL, 10);
+        else if (0==strcasecmp("Transfer-Encoding", name.c_str()) && 0==strcasecmp("chunked", value.c_str()))
+            chunked = true;
+        else if (0 == strcasecmp("Connection", name.c_str()))
+            request.keep_alive = (0 == strcasecmp("keep-alive", value.c_str()));
+    }
+    buffer.erase(0, header_end+4);
+
+    request.body.clear();
+    if (chunked)
+    {
+        while (true)
+        {
+            std::string::size_type size_end;
+            while (std::string::npos == (size_end=buffer.find("\r\n")))
+            {
+                ssize_t count = recv(socket, chunk, sizeof(chunk), 0);
+                if (0 >= count)
+                    return false;
+                buffer.append(chunk, count);
+            }
+            size_t size = strtoul(buffer.c_str(), NULL, 16);
+            while (buffer.length() < size_end+2+size+2)
+            {
+                ssize_t count = recv(socket, chunk, sizeof(chunk), 0);
+                if (0 >= count)
+                    return false;
+                buffer.append(chunk, count);
+            }
+            request.body.append(buffer, size_end+2, size);
+            buffer.erase(0, size_end+2+size+2);
+            if (0 == size)
+                break;
+        }
+    }
+    else
+    {
+        while (buffer.length() < content_length)
+        {
+            ssize_t count = recv(socket, chunk, sizeof(chunk), 0);
+            if (0 >= count)
+                return false;
+            buffer.append(chunk, count);
+        }
+        request.body = buffer.substr(0, content_length);
+        buffer.erase(0, content_length);
+    }
+
+    std::string::size_type query = target.find('?');
+    request.path = target.substr(0, query);
+    request.query = (std::string::npos==query) ? "" : target.substr(query+1);
+    return true;
+}
+
+bool SendAll(int socket, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.length())
+    {
+        ssize_t count = send(socket, data.data()+sent, data.length()-sent, MSG_NOSIGNAL);
+        if (0 >= count)
+            return false;
+        sent += count;
+    }
+    return true;
+}
+
+void ConnectionThread(int socket)
+{
+    int enable = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+    std::string buffer;
+    Request request;
+    while (ReadRequest(socket, buffer, request))
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        Response response;
+        long documents;
+        std::string endpoint = Handle(request, response, documents);
+
+        int delay_us = s_latency_ms*1000 + s_bulk_document_cost_us*documents;
+        if (!endpoint.empty() && 0<delay_us)
+            std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+
+        const char* reason = (200==response.status) ? "OK" : "Not Found";
+        std::ostringstream reply;
+        reply << "HTTP/1.1 " << response.status << " " << reason << "\r\n"
+              << "Content-Type: application/json; charset=UTF-8\r\n"
+              << "Content-Length: " << ("HEAD"==request.method ? 0 : response.body.length()) << "\r\n"
+              << (request.keep_alive ? "" : "Connection: close\r\n") << "\r\n";
+        if ("HEAD" != request.method)
+            reply << response.body;
+
+        if (!endpoint.empty())
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            EndpointStats& stats = s_stats[endpoint];
+            stats.requests++;
+            stats.documents += documents;
+            stats.bytes_received += request.body.length();
+            stats.bytes_sent += response.body.length();
+            stats.latencies_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count());
+        }
+
+        if (!SendAll(socket, reply.str()) || !request.keep_alive)
+            break;
+    }
+    close(socket);
+}
+
+void Usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s [--port <port>] [--latency <ms>] [--bulk-document-cost <us>] [--reject <percent>] [--reject-items <percent>]\n", name);
+}
+
+int main(int argc, char** argv)
+{
+    int port = DEFAULT_PORT;
+    for (int i=1; i<argc; i+=2)
+    {
+        if (i+1 >= argc)
+        {
+            Usage(argv[0]);
+            return -1;
+        }
+        if (0 == strcmp("--port", argv[i]))
+            port = atoi(argv[i+1]);
+        else if (0 == strcmp("--latency", argv[i]))
+            s_latency_ms = atoi(argv[i+1]);
+        else if (0 == strcmp("--bulk-document-cost", argv[i]))
+            s_bulk_document_cost_us = atoi(argv[i+1]);
+        else if (0 == strcmp("--reject", argv[i]))
+            s_reject_percent = atoi(argv[i+1]);
+        else if (0 == strcmp("--reject-items", argv[i]))
+            s_reject_items_percent = atoi(argv[i+1]);
+        else
+        {
+            Usage(argv[0]);
+            return -1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int enable = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (0!=bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) || 0!=listen(listener, 64))
+    {
+        perror("es_standin");
+        return -1;
+    }
+    fprintf(stdout, "es_standin listening on 127.0.0.1:%d\n", port);
+    fflush(stdout);
+
+    while (true)
+    {
+        int connection = accept(listener, NULL, NULL);
+        if (0 <= connection)
+        {
+            std::thread(ConnectionThread, connection).detach();
+        }
+    }
+    return 0;
+}
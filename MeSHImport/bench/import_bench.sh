@@ -0,0 +1,67 @@
+#!/bin/sh
+# Import throughput suite. Generates synthetic MeSH files, starts es_standin
+# and runs the importer through a clean import, two delta imports, a
+# memory-mapped clean import and a supplemental record (SCR) import. Reports
+# records/s, ES requests per record and peak RSS for each phase.
+#
+#   ./import_bench.sh [records...]        default 10000 100000
+#
+# Environment: PORT (9299), DATA (/tmp/mesh_bench), IMPORT_OPTIONS (extra
+# MeSHImport options), STANDIN_OPTIONS (e.g. "--latency 2 --bulk-document-cost 20")
+
+cd "$(dirname "$0")" || exit 1
+
+PORT=${PORT:-9299}
+DATA=${DATA:-/tmp/mesh_bench}
+RECORDS=${*:-10000 100000}
+IMPORTER=../MeSHImport
+TOPNODES=../nordesc_topnodes.xml
+
+mkdir -p "$DATA" || exit 1
+
+./es_standin --port "$PORT" $STANDIN_OPTIONS > "$DATA/es_standin.log" 2>&1 &
+STANDIN_PID=$!
+trap 'kill $STANDIN_PID 2>/dev/null' EXIT INT TERM
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    curl -s "localhost:$PORT/" > /dev/null && break
+    sleep 0.2
+done
+
+# run_phase <name> <importer options and file>
+run_phase() {
+    name=$1
+    shift
+    curl -s -XPOST "localhost:$PORT/_standin/reset" > /dev/null
+    ./run_measured "$IMPORTER" "localhost:$PORT" $IMPORT_OPTIONS "$@" > "$DATA/$name.out" 2> "$DATA/$name.err"
+    curl -s "localhost:$PORT/_standin/stats" > "$DATA/$name.stats.json"
+
+    records=$(tr '\r' '\n' < "$DATA/$name.out" | sed -n 's/^Total \(descriptors\|supplemental records\): \([0-9]*\)/\2/p' | tail -1)
+    measured=$(tail -1 "$DATA/$name.err")
+    requests=$(sed -n 's/^{"seconds": [0-9.]*, "requests": \([0-9]*\).*/\1/p' "$DATA/$name.stats.json")
+    documents=$(sed -n 's/^{"seconds": [0-9.]*, "requests": [0-9]*, "documents": \([0-9]*\).*/\1/p' "$DATA/$name.stats.json")
+
+    echo "$name ${records:-0} $measured ${requests:-0} ${documents:-0}" | awk '{
+        split($3, s, "="); split($4, r, "="); split($5, e, "=");
+        rate = (s[2] > 0) ? $2/s[2] : 0;
+        per_record = ($2 > 0) ? $6/$2 : 0;
+        printf "%-18s %9d %9.2f %11.0f %11d %10.3f %10d %10.1f %s\n", $1, $2, s[2], rate, $6, per_record, $7, r[2]/1024, (e[2]==0 ? "" : "exit=" e[2]) }'
+}
+
+printf "%-18s %9s %9s %11s %11s %10s %10s %10s\n" "phase" "records" "seconds" "records/s" "es_requests" "req/record" "es_docs" "peak_mb"
+for count in $RECORDS; do
+    file="$DATA/mesh_$count.xml"
+    revised="$DATA/mesh_${count}_r1.xml"
+    supplemental="$DATA/supp_$count.xml"
+    [ -f "$file" ] || ./mesh_generator "$count" > "$file" || exit 1
+    [ -f "$revised" ] || ./mesh_generator "$count" --revision 1 > "$revised" || exit 1
+    [ -f "$supplemental" ] || ./mesh_generator "$count" --supplemental > "$supplemental" || exit 1
+    manifest="$DATA/mesh_$count.manifest"
+    rm -f "$manifest"
+
+    run_phase "clean_$count"     --clean --topnodes "$TOPNODES" --delta "$manifest" "$file"
+    run_phase "unchanged_$count" --topnodes "$TOPNODES" --delta "$manifest" "$file"
+    run_phase "revision_$count"  --topnodes "$TOPNODES" --delta "$manifest" "$revised"
+    run_phase "mmap_$count"      --clean --mmap --topnodes "$TOPNODES" "$file"
+    run_phase "scr_$count"       --clean --supplemental "$supplemental"
+done
+echo "Output and ES stand-in statistics per phase are in $DATA"
@@ -0,0 +1,197 @@
+// Compares building a Json::Object tree per descriptor and serializing it, as
+// the importer used to, with writing the same document through a reused
+// JsonWriter. Reports CPU time and heap allocations per record:
+//
+//   ./json_bench ~/Downloads/nordesc2019.xml
+//   ./json_bench --passes 20 /tmp/mesh_bench/mesh_100000.xml
+//
+// Both write the fields the parser fills, the hierarchy fields stay empty.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libxml/xmlreader.h>
+
+#include <atomic>
+#include <new>
+
+#include "descriptor_parser.h"
+#include "json/json.h"
+#include "json_writer.h"
+
+
+static std::atomic<long> g_allocations(0);
+
+void* operator new(size_t size)
+{
+    g_allocations++;
+    void* memory = malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+
+long ParseDescriptors(const char* filename, std::vector<Descriptor>& descriptors)
+{
+    long records = 0;
+    xmlTextReaderPtr reader = xmlReaderForFile(filename, NULL, XML_PARSE_NOBLANKS|XML_PARSE_NOCDATA|XML_PARSE_COMPACT);
+    if (!reader)
+        return -1;
+
+    if (1==xmlTextReaderNext(reader) && XML_READER_TYPE_DOCUMENT_TYPE==xmlTextReaderNodeType(reader) &&
+        1==xmlTextReaderNext(reader) && 1==xmlTextReaderRead(reader))
+    {
+        bool more = true;
+        xmlNodePtr descriptor_record_ptr;
+        while (more &&
+               NULL!=(descriptor_record_ptr=xmlTextReaderExpand(reader)) &&
+               XML_ELEMENT_NODE==descriptor_record_ptr->type && 0==xmlStrcmp(BAD_CAST("DescriptorRecord"), descriptor_record_ptr->name))
+        {
+            Descriptor descriptor;
+            if (ProcessDescriptorRecord(descriptor_record_ptr, false, "nor", descriptor))
+            {
+                descriptors.push_back(std::move(descriptor));
+            }
+            records++;
+            more = (1 == xmlTextReaderNext(reader));
+        }
+    }
+
+    xmlFreeTextReader(reader);
+    return records;
+}
+
+static void AddTreeString(Json::Object& json, const std::string& key, const std::string& value)
+{
+    if (!value.empty())
+    {
+        json.addMemberByKey(key, value.c_str());
+    }
+}
+
+static void AddTreeStringArray(Json::Object& json, const std::string& key, const std::vector<std::string>& values, bool escape)
+{
+    if (values.empty())
+        return;
+
+    Json::Array array;
+    std::vector<std::string>::const_iterator iterator = values.begin();
+    for (; iterator!=values.end(); ++iterator)
+    {
+        Json::Value value;
+        value.setString(escape ? Json::Value::escapeJsonString(*iterator) : *iterator);
+        array.addElement(value);
+    }
+    json.addMemberByKey(key, array);
+}
+
+std::string DescriptorToTree(const Descriptor& descriptor)
+//The record fields of the importer's DescriptorToJson() before JsonWriter
+{
+    Json::Object json;
+    AddTreeString(json, "id", descriptor.id);
+    AddTreeString(json, "nor_name", descriptor.nor_name);
+    AddTreeString(json, "eng_name", descriptor.eng_name);
+    AddTreeStringArray(json, "see_related", descriptor.see_related, false);
+    AddTreeStringArray(json, "tree_numbers", descriptor.tree_numbers, false);
+    AddTreeStringArray(json, "parent_tree_numbers", descriptor.parent_tree_numbers, false);
+    AddTreeStringArray(json, "child_tree_numbers", descriptor.child_tree_numbers, false);
+    if (descriptor.top_node)
+    {
+        json.addMemberByKey("top_node", "yes");
+    }
+    AddTreeString(json, "eng_description", descriptor.eng_description);
+    AddTreeString(json, "nor_description", descriptor.nor_description);
+    AddTreeStringArray(json, "other_ids", descriptor.other_ids, true);
+
+    std::map<std::string, std::vector<std::string> >::const_iterator term_iterator = descriptor.term_texts.begin();
+    for (; term_iterator!=descriptor.term_texts.end(); ++term_iterator)
+    {
+        AddTreeStringArray(json, term_iterator->first, term_iterator->second, true);
+    }
+    AddTreeString(json, "language_file", descriptor.language_file);
+    return json.str();
+}
+
+double CpuSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec/1e9;
+}
+
+void Report(const char* name, long documents, double seconds, long allocations, long bytes)
+{
+    fprintf(stdout, "%-7s %ld documents, %.0f ns CPU/record, %.2f allocations/record, %.1f MB written\n",
+            name, documents, seconds*1e9/documents, (double)allocations/documents, bytes/(1024.0*1024.0));
+}
+
+int main(int argc, char **argv)
+{
+    int passes = 5;
+    if (4==argc && 0==strcmp("--passes", argv[1]))
+    {
+        passes = std::max(1, atoi(argv[2]));
+    }
+    else if (2 != argc)
+    {
+        fprintf(stderr, "Usage: %s [--passes <count>] <MeSH-file>\n", argv[0]);
+        return -1;
+    }
+    const char* filename = argv[argc-1];
+
+    LIBXML_TEST_VERSION
+
+    std::vector<Descriptor> descriptors;
+    if (0 > ParseDescriptors(filename, descriptors) || descriptors.empty())
+    {
+        fprintf(stderr, "Could not parse %s\n", filename);
+        return -1;
+    }
+    long documents = (long)descriptors.size()*passes;
+
+    long bytes = 0;
+    long allocations = g_allocations;
+    double start = CpuSeconds();
+    for (int pass=0; pass<passes; pass++)
+    {
+        std::vector<Descriptor>::const_iterator iterator = descriptors.begin();
+        for (; iterator!=descriptors.end(); ++iterator)
+        {
+            std::string document = DescriptorToTree(*iterator);
+            bytes += document.length();
+        }
+    }
+    Report("tree", documents, CpuSeconds()-start, g_allocations-allocations, bytes);
+
+    JsonWriter json;
+    bytes = 0;
+    allocations = g_allocations;
+    start = CpuSeconds();
+    for (int pass=0; pass<passes; pass++)
+    {
+        std::vector<Descriptor>::const_iterator iterator = descriptors.begin();
+        for (; iterator!=descriptors.end(); ++iterator)
+        {
+            json.Clear();
+            DescriptorToJson(*iterator, json);
+            bytes += json.GetDocument().length();
+        }
+    }
+    Report("writer", documents, CpuSeconds()-start, g_allocations-allocations, bytes);
+
+    xmlCleanupParser();
+    return 0;
+}
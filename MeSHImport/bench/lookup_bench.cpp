@@ -0,0 +1,118 @@
+// Measures the per-record cost of converting an expanded DescriptorRecord
+// (element dispatch and everything else ProcessDescriptorRecord does) and the
+// per-term cost of mapping a ThesaurusID to a language. Parsing the file is
+// not timed, all records are expanded and copied first:
+//
+//   ./lookup_bench ~/Downloads/nordesc2019.xml
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libxml/xmlreader.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "descriptor_parser.h"
+
+#define ROUNDS (20)
+
+
+void CollectThesaurusIds(xmlNodePtr node_ptr, std::vector<std::string>& thesaurus_ids)
+{
+    for (; NULL!=node_ptr; node_ptr=node_ptr->next)
+    {
+        if (XML_ELEMENT_NODE != node_ptr->type)
+            continue;
+
+        if (0==xmlStrcmp(BAD_CAST("ThesaurusID"), node_ptr->name) && NULL!=node_ptr->children && NULL!=node_ptr->children->content)
+        {
+            thesaurus_ids.push_back(CONST_CHAR(node_ptr->children->content));
+        }
+        CollectThesaurusIds(node_ptr->children, thesaurus_ids);
+    }
+}
+
+bool ReadRecords(const char* filename, std::vector<xmlNodePtr>& records, std::vector<std::string>& thesaurus_ids)
+{
+    xmlTextReaderPtr reader = xmlReaderForFile(filename, NULL, XML_PARSE_NOBLANKS|XML_PARSE_NOCDATA|XML_PARSE_COMPACT);
+    if (!reader)
+        return false;
+
+    if (1==xmlTextReaderNext(reader) && XML_READER_TYPE_DOCUMENT_TYPE==xmlTextReaderNodeType(reader) &&
+        1==xmlTextReaderNext(reader) && 1==xmlTextReaderRead(reader))
+    {
+        bool more = true;
+        xmlNodePtr descriptor_record_ptr;
+        while (more &&
+               NULL!=(descriptor_record_ptr=xmlTextReaderExpand(reader)) &&
+               XML_ELEMENT_NODE==descriptor_record_ptr->type && 0==xmlStrcmp(BAD_CAST("DescriptorRecord"), descriptor_record_ptr->name))
+        {
+            records.push_back(xmlCopyNode(descriptor_record_ptr, 1)); //Like the importer hands records to its converter threads
+            CollectThesaurusIds(descriptor_record_ptr->children, thesaurus_ids);
+            more = (1 == xmlTextReaderNext(reader));
+        }
+    }
+
+    xmlFreeTextReader(reader);
+    return !records.empty();
+}
+
+double ElapsedNanoseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now()-start).count();
+}
+
+int main(int argc, char** argv)
+{
+    if (2 != argc)
+    {
+        fprintf(stderr, "Usage: %s <MeSH-file>\n", argv[0]);
+        return -1;
+    }
+
+    LIBXML_TEST_VERSION
+
+    std::vector<xmlNodePtr> records;
+    std::vector<std::string> thesaurus_ids;
+    if (!ReadRecords(argv[1], records, thesaurus_ids))
+    {
+        fprintf(stderr, "Could not read %s\n", argv[1]);
+        return -1;
+    }
+
+    long descriptor_count = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int round=0; round<ROUNDS; round++)
+    {
+        for (size_t i=0; i<records.size(); i++)
+        {
+            Descriptor descriptor;
+            descriptor_count += ProcessDescriptorRecord(records[i], false, "nor", descriptor) ? 1 : 0;
+        }
+    }
+    double record_ns = ElapsedNanoseconds(start) / (double(ROUNDS)*records.size());
+
+    long language_count = 0;
+    std::string language;
+    start = std::chrono::steady_clock::now();
+    for (int round=0; round<ROUNDS; round++)
+    {
+        for (size_t i=0; i<thesaurus_ids.size(); i++)
+        {
+            language_count += GetThesaurusLanguage(BAD_CAST(thesaurus_ids[i].c_str()), language) ? 1 : 0;
+        }
+    }
+    double term_ns = thesaurus_ids.empty() ? 0.0 : ElapsedNanoseconds(start) / (double(ROUNDS)*thesaurus_ids.size());
+
+    fprintf(stdout, "Records: %ld (%ld descriptors)\nConvert record: %.0f ns\n", (long)records.size(), descriptor_count/ROUNDS, record_ns);
+    fprintf(stdout, "ThesaurusIDs: %ld (%ld with a known language)\nThesaurus language: %.1f ns\n", (long)thesaurus_ids.size(), language_count/ROUNDS, term_ns);
+
+    for (size_t i=0; i<records.size(); i++)
+    {
+        xmlFreeNode(records[i]);
+    }
+    xmlCleanupParser();
+    return 0;
+}
@@ -0,0 +1,476 @@
+// Writes a synthetic nordesc-style DescriptorRecordSet to stdout, for
+// benchmarking the importer without the licensed MeSH files:
+//
+//   ./mesh_generator 100000 > /tmp/mesh_100k.xml
+//   ./mesh_generator 100000 --revision 1 > /tmp/mesh_100k_r1.xml
+//   ./mesh_generator 300000 --supplemental > /tmp/supp_300k.xml
+//
+// The same seed gives the same file. A revision renames about 5% of the
+// descriptors and drops about 0.5%, like the changes between two releases.
+// Trees, concepts and terms are shaped like the real files: the 16 topnode
+// categories, depth up to 11 levels, 1-3 tree numbers, "nor[eng]" names.
+// Supplemental records map to 1-3 of the first DESCRIPTOR_POOL descriptors.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define MAX_TREE_DEPTH (11)
+#define DEFAULT_SEED   (2019)
+#define DESCRIPTOR_POOL (29000) //About the size of a real release
+
+
+static const char* CATEGORIES = "ABCDEFGHIJKLMNVZ"; //Same as nordesc_topnodes.xml
+
+static const char* NOR_WORDS[] = {
+    "hjerte", "lunge", "nyre", "lever", "blod", "celle", "vev", "muskel", "nerve", "hjerne",
+    "infeksjon", "betennelse", "svulst", "sykdom", "syndrom", "behandling", "diagnostikk", "legemiddel",
+    "proteiner", "enzymer", "hormoner", "reseptorer", "antistoffer", "bakterier", "virus", "sopp",
+    "akutt", "kronisk", "medfødt", "ervervet", "primær", "sekundær", "kirurgisk", "klinisk", "for", "og", "med"
+};
+static const char* ENG_WORDS[] = {
+    "heart", "lung", "kidney", "liver", "blood", "cell", "tissue", "muscle", "nerve", "brain",
+    "infection", "inflammation", "neoplasm", "disease", "syndrome", "therapy", "diagnosis", "drug",
+    "proteins", "enzymes", "hormones", "receptors", "antibodies", "bacteria", "viruses", "fungi",
+    "acute", "chronic", "congenital", "acquired", "primary", "secondary", "surgical", "clinical", "of", "and", "with"
+};
+static const size_t WORD_COUNT = sizeof(NOR_WORDS)/sizeof(NOR_WORDS[0]);
+
+static const char* ENG_THESAURI[] = {"NLM (1966)", "NLM (2019)", "FDA SRS (2014)", "UNK (19XX)", "INN (19XX)", "USAN (1974)", "BAN (19XX)", "ORD (2012)"};
+static const char* QUALIFIERS[][2] = {
+    {"Q000009", "adverse effects"}, {"Q000097", "blood"}, {"Q000150", "complications"}, {"Q000175", "diagnosis"},
+    {"Q000188", "drug therapy"}, {"Q000453", "epidemiology"}, {"Q000473", "pathology"}, {"Q000503", "physiopathology"},
+    {"Q000601", "surgery"}, {"Q000628", "therapy"}, {"Q000737", "chemistry"}, {"Q000494", "pharmacology"}
+};
+static const size_t QUALIFIER_COUNT = sizeof(QUALIFIERS)/sizeof(QUALIFIERS[0]);
+
+
+class Random //xorshift64*, so files are the same on every platform
+{
+public:
+    explicit Random(uint64_t seed) : m_state(seed*0x9E3779B97F4A7C15ULL | 1) {}
+
+    uint64_t Next()
+    {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return m_state * 0x2545F4914F6CDD1DULL;
+    }
+    size_t Below(size_t limit) {return Next() % limit;}
+    bool Chance(int percent) {return Below(100) < static_cast<size_t>(percent);}
+
+private:
+    uint64_t m_state;
+};
+
+struct TreeNode
+{
+    std::string tree_number;
+    int depth;
+};
+
+class Generator
+{
+public:
+    Generator(long record_count, uint64_t seed, int revision)
+    : m_record_count(record_count), m_seed(seed), m_revision(revision), m_random(seed) {}
+
+    void Write(FILE* output);
+    void WriteSupplemental(FILE* output);
+
+private:
+    std::string NewTreeNumber();
+    void Words(Random& random, const char** words, int count, std::string& text);
+    void Sentence(Random& random, const char** words, int count, std::string& text);
+    void WriteRecord(FILE* output, long index);
+    void WriteSupplementalRecord(FILE* output, long index);
+
+private:
+    long m_record_count;
+    uint64_t m_seed;
+    int m_revision;
+    Random m_random;
+
+    std::vector<TreeNode> m_nodes;
+    std::unordered_map<std::string, int> m_child_counts;
+    std::string m_record;
+};
+
+std::string Generator::NewTreeNumber()
+{
+    //Uniform attachment to earlier nodes gives the long-tailed depth profile of the real trees
+    size_t top_nodes = strlen(CATEGORIES)*4;
+    if (m_nodes.size() < top_nodes)
+    {
+        char tree_number[8];
+        snprintf(tree_number, sizeof(tree_number), "%c%02d", CATEGORIES[m_nodes.size()/4], static_cast<int>(m_nodes.size()%4)+1);
+        m_nodes.push_back(TreeNode{tree_number, 1});
+        return m_nodes.back().tree_number;
+    }
+
+    const TreeNode* parent;
+    do
+    {
+        parent = &m_nodes[m_random.Below(m_nodes.size())];
+    } while (MAX_TREE_DEPTH <= parent->depth);
+
+    char child[8];
+    snprintf(child, sizeof(child), ".%03d", ++m_child_counts[parent->tree_number] % 1000);
+    TreeNode node{parent->tree_number + child, parent->depth+1};
+    m_nodes.push_back(node);
+    return node.tree_number;
+}
+
+void Generator::Words(Random& random, const char** words, int count, std::string& text)
+{
+    for (int i=0; i<count; i++)
+    {
+        if (0 < i)
+            text += ' ';
+        text += words[random.Below(WORD_COUNT)];
+    }
+}
+
+void Generator::Sentence(Random& random, const char** words, int count, std::string& text)
+{
+    Words(random, words, count, text);
+    text += ". ";
+}
+
+void Generator::Write(FILE* output)
+{
+    fprintf(output, "<?xml version=\"1.0\"?>\n"
+                    "<!DOCTYPE DescriptorRecordSet SYSTEM \"https://www.nlm.nih.gov/databases/dtd/nlmdescriptorrecordset_20190101.dtd\">\n"
+                    "<DescriptorRecordSet LanguageCode = \"nor\">\n");
+    for (long i=0; i<m_record_count; i++)
+    {
+        WriteRecord(output, i);
+    }
+    fprintf(output, "</DescriptorRecordSet>\n");
+}
+
+void Generator::WriteSupplemental(FILE* output)
+{
+    fprintf(output, "<?xml version=\"1.0\"?>\n"
+                    "<!DOCTYPE SupplementalRecordSet SYSTEM \"https://www.nlm.nih.gov/databases/dtd/nlmsupplementalrecordset_20190101.dtd\">\n"
+                    "<SupplementalRecordSet LanguageCode = \"eng\">\n");
+    for (long i=0; i<m_record_count; i++)
+    {
+        WriteSupplementalRecord(output, i);
+    }
+    fprintf(output, "</SupplementalRecordSet>\n");
+}
+
+void Generator::WriteSupplementalRecord(FILE* output, long index)
+{
+    Random random(m_seed ^ (static_cast<uint64_t>(index+1) * 0xBF58476D1CE4E5B9ULL));
+    char id[24];
+    snprintf(id, sizeof(id), "C%09ld", index+1);
+    std::string name;
+    Words(random, ENG_WORDS, 1 + random.Below(3), name);
+    name += ' ';
+    name += std::to_string(index+1);
+
+    std::string& r = m_record;
+    r.clear();
+    r += "<SupplementalRecord SCRClass = \"";
+    r += static_cast<char>('1' + (random.Chance(80) ? 0 : random.Below(4)));
+    r += "\">\n";
+    r += " <SupplementalRecordUI>"; r += id; r += "</SupplementalRecordUI>\n";
+    r += " <SupplementalRecordName>\n  <String>" + name + "</String>\n </SupplementalRecordName>\n";
+    r += " <DateCreated>\n  <Year>2005</Year>\n  <Month>03</Month>\n  <Day>14</Day>\n </DateCreated>\n";
+    if (random.Chance(60))
+    {
+        r += " <Note>";
+        Sentence(random, ENG_WORDS, 6 + random.Below(20), r);
+        r += "</Note>\n";
+    }
+    r += " <Frequency>" + std::to_string(1 + random.Below(200)) + "</Frequency>\n";
+
+    r += " <HeadingMappedToList>\n";
+    for (int heading=1+random.Below(3); 0<heading; heading--)
+    {
+        char descriptor[24];
+        snprintf(descriptor, sizeof(descriptor), "*D%06ld", 1 + static_cast<long>(random.Below(DESCRIPTOR_POOL)));
+        r += "  <HeadingMappedTo>\n   <DescriptorReferredTo>\n    <DescriptorUI>";
+        r += descriptor;
+        r += "</DescriptorUI>\n    <DescriptorName>\n     <String>";
+        Words(random, ENG_WORDS, 2, r);
+        r += "</String>\n    </DescriptorName>\n   </DescriptorReferredTo>\n";
+        if (random.Chance(15))
+        {
+            size_t qualifier = random.Below(QUALIFIER_COUNT);
+            r += "   <QualifierReferredTo>\n    <QualifierUI>";
+            r += QUALIFIERS[qualifier][0];
+            r += "</QualifierUI>\n    <QualifierName>\n     <String>";
+            r += QUALIFIERS[qualifier][1];
+            r += "</String>\n    </QualifierName>\n   </QualifierReferredTo>\n";
+        }
+        r += "  </HeadingMappedTo>\n";
+    }
+    r += " </HeadingMappedToList>\n";
+
+    if (random.Chance(20))
+    {
+        char descriptor[24];
+        snprintf(descriptor, sizeof(descriptor), "D%06ld", 1 + static_cast<long>(random.Below(DESCRIPTOR_POOL)));
+        r += " <PharmacologicalActionList>\n  <PharmacologicalAction>\n   <DescriptorReferredTo>\n    <DescriptorUI>";
+        r += descriptor;
+        r += "</DescriptorUI>\n    <DescriptorName>\n     <String>";
+        Words(random, ENG_WORDS, 2, r);
+        r += "</String>\n    </DescriptorName>\n   </DescriptorReferredTo>\n  </PharmacologicalAction>\n </PharmacologicalActionList>\n";
+    }
+    r += " <SourceList>\n  <Source>J Med Chem 2004;47(";
+    r += std::to_string(1 + random.Below(27));
+    r += "):";
+    r += std::to_string(1 + random.Below(9000));
+    r += "</Source>\n </SourceList>\n";
+
+    r += " <ConceptList>\n  <Concept PreferredConceptYN=\"Y\">\n";
+    char concept_id[32];
+    snprintf(concept_id, sizeof(concept_id), "M%09ld", index+1);
+    r += "   <ConceptUI>"; r += concept_id; r += "</ConceptUI>\n";
+    r += "   <ConceptName>\n    <String>" + name + "</String>\n   </ConceptName>\n";
+    r += "   <RegistryNumberList>\n    <RegistryNumber>";
+    r += random.Chance(50) ? std::to_string(10000 + random.Below(900000)) + "-" + std::to_string(10 + random.Below(90)) + "-" + std::to_string(random.Below(10)) : "0";
+    r += "</RegistryNumber>\n   </RegistryNumberList>\n";
+    r += "   <TermList>\n";
+    int terms = 1 + random.Below(4);
+    for (int term=0; term<terms; term++)
+    {
+        char term_id[40];
+        snprintf(term_id, sizeof(term_id), "T%09ld%d", index+1, term);
+        r += "    <Term ConceptPreferredTermYN=\"";
+        r += (0 == term) ? "Y" : "N";
+        r += "\" IsPermutedTermYN=\"N\" LexicalTag=\"NON\" RecordPreferredTermYN=\"";
+        r += (0 == term) ? "Y" : "N";
+        r += "\">\n     <TermUI>"; r += term_id; r += "</TermUI>\n     <String>";
+        if (0 == term)
+        {
+            r += name;
+        }
+        else
+        {
+            Words(random, ENG_WORDS, 1 + random.Below(4), r);
+        }
+        r += "</String>\n     <ThesaurusIDlist>\n      <ThesaurusID>";
+        r += ENG_THESAURI[random.Below(sizeof(ENG_THESAURI)/sizeof(ENG_THESAURI[0]))];
+        r += "</ThesaurusID>\n     </ThesaurusIDlist>\n    </Term>\n";
+    }
+    r += "   </TermList>\n  </Concept>\n </ConceptList>\n</SupplementalRecord>\n";
+
+    fwrite(r.data(), 1, r.length(), output);
+}
+
+void Generator::WriteRecord(FILE* output, long index)
+{
+    //Tree numbers come from the shared stream, so a revision keeps the hierarchy. Everything
+    //else comes from a per-record stream, so only the records a revision touches change
+    std::vector<std::string> tree_numbers(1, NewTreeNumber());
+    if (m_random.Chance(35)) tree_numbers.push_back(NewTreeNumber());
+    if (m_random.Chance(10)) tree_numbers.push_back(NewTreeNumber());
+
+    Random random(m_seed ^ (static_cast<uint64_t>(index+1) * 0xD1B54A32D192ED03ULL));
+    int change = 0;
+    for (int revision=1; revision<=m_revision; revision++)
+    {
+        Random revision_random(m_seed ^ (static_cast<uint64_t>(index+1)*31 + revision) * 0x94D049BB133111EBULL);
+        int roll = revision_random.Below(1000);
+        if (5 > roll)
+            return; //Deleted in this revision
+        if (55 > roll)
+            change = revision;
+    }
+
+    char id[24];
+    snprintf(id, sizeof(id), "D%06ld", index+1);
+
+    int name_words = 1 + random.Below(4);
+    std::string eng_name, nor_name;
+    Words(random, ENG_WORDS, name_words, eng_name);
+    if (random.Chance(8))
+    {
+        nor_name = "Not Translated";
+    }
+    else
+    {
+        Words(random, NOR_WORDS, name_words, nor_name);
+    }
+    if (0 < change)
+    {
+        nor_name += " (rev " + std::to_string(change) + ")";
+    }
+
+    std::string& r = m_record;
+    r.clear();
+    r += "<DescriptorRecord DescriptorClass = \"1\">\n";
+    r += " <DescriptorUI>"; r += id; r += "</DescriptorUI>\n";
+    r += " <DescriptorName>\n  <String>" + nor_name + "[" + eng_name + "]</String>\n </DescriptorName>\n";
+    r += " <DateCreated>\n  <Year>1999</Year>\n  <Month>01</Month>\n  <Day>01</Day>\n </DateCreated>\n";
+    r += " <DateRevised>\n  <Year>2018</Year>\n  <Month>06</Month>\n  <Day>12</Day>\n </DateRevised>\n";
+    r += " <ActiveMeSHYearList>\n  <Year>2018</Year>\n  <Year>2019</Year>\n </ActiveMeSHYearList>\n";
+
+    size_t qualifiers = random.Below(QUALIFIER_COUNT+1);
+    if (0 < qualifiers)
+    {
+        r += " <AllowableQualifiersList>\n";
+        for (size_t i=0; i<qualifiers; i++)
+        {
+            r += "  <AllowableQualifier>\n   <QualifierReferredTo>\n    <QualifierUI>";
+            r += QUALIFIERS[i][0];
+            r += "</QualifierUI>\n    <QualifierName>\n     <String>";
+            r += QUALIFIERS[i][1];
+            r += "</String>\n    </QualifierName>\n   </QualifierReferredTo>\n   <Abbreviation>XX</Abbreviation>\n  </AllowableQualifier>\n";
+        }
+        r += " </AllowableQualifiersList>\n";
+    }
+
+    if (random.Chance(40))
+    {
+        r += " <HistoryNote>";
+        Sentence(random, ENG_WORDS, 6 + random.Below(10), r);
+        r += "\n</HistoryNote>\n";
+    }
+
+    if (random.Chance(12) && 1 < index)
+    {
+        char related[24];
+        snprintf(related, sizeof(related), "D%06ld", 1 + static_cast<long>(random.Below(index)));
+        r += " <SeeRelatedList>\n  <SeeRelatedDescriptor>\n   <DescriptorReferredTo>\n    <DescriptorUI>";
+        r += related;
+        r += "</DescriptorUI>\n    <DescriptorName>\n     <String>";
+        Words(random, ENG_WORDS, 2, r);
+        r += "</String>\n    </DescriptorName>\n   </DescriptorReferredTo>\n  </SeeRelatedDescriptor>\n </SeeRelatedList>\n";
+    }
+
+    r += " <TreeNumberList>\n";
+    for (size_t i=0; i<tree_numbers.size(); i++)
+    {
+        r += "  <TreeNumber>" + tree_numbers[i] + "</TreeNumber>\n";
+    }
+    r += " </TreeNumberList>\n";
+
+    r += " <ConceptList>\n";
+    int concepts = 1 + (random.Chance(45) ? 1 + random.Below(3) : 0);
+    for (int concept=0; concept<concepts; concept++)
+    {
+        bool preferred_concept = (0 == concept);
+        char concept_id[32];
+        snprintf(concept_id, sizeof(concept_id), "M%07ld%d", index+1, concept);
+        r += preferred_concept ? "  <Concept PreferredConceptYN=\"Y\">\n" : "  <Concept PreferredConceptYN=\"N\">\n";
+        r += "   <ConceptUI>"; r += concept_id; r += "</ConceptUI>\n";
+        r += "   <ConceptName>\n    <String>" + (preferred_concept ? eng_name : std::string("variant ") + eng_name) + "</String>\n   </ConceptName>\n";
+        if (preferred_concept && random.Chance(80))
+        {
+            r += "   <ScopeNote>";
+            for (int i=1+random.Below(3); 0<i; i--)
+                Sentence(random, ENG_WORDS, 8 + random.Below(20), r);
+            r += "\n   </ScopeNote>\n";
+        }
+        if (preferred_concept && random.Chance(60))
+        {
+            r += "   <TranslatorsScopeNote>";
+            Sentence(random, NOR_WORDS, 8 + random.Below(20), r);
+            r += "</TranslatorsScopeNote>\n";
+        }
+
+        r += "   <TermList>\n";
+        int terms = 1 + random.Below(preferred_concept ? 6 : 3);
+        for (int term=0; term<terms; term++)
+        {
+            bool nor_term = preferred_concept && (0 == term);
+            bool preferred_term = (term <= 1);
+            char term_id[40];
+            snprintf(term_id, sizeof(term_id), "T%07ld%d%d", index+1, concept, term);
+            r += "    <Term ConceptPreferredTermYN=\"";
+            r += preferred_term ? "Y" : "N";
+            r += "\" IsPermutedTermYN=\"N\" LexicalTag=\"NON\" RecordPreferredTermYN=\"";
+            r += (preferred_concept && 1==term) ? "Y" : "N";
+            r += "\">\n     <TermUI>"; r += term_id; r += "</TermUI>\n     <String>";
+            if (nor_term)
+            {
+                r += nor_name;
+            }
+            else if (preferred_concept && 1==term)
+            {
+                r += eng_name;
+            }
+            else
+            {
+                Words(random, ENG_WORDS, 1 + random.Below(4), r);
+            }
+            r += "</String>\n     <DateCreated>\n      <Year>1999</Year>\n      <Month>01</Month>\n      <Day>01</Day>\n     </DateCreated>\n";
+            r += "     <ThesaurusIDlist>\n      <ThesaurusID>";
+            r += nor_term ? "nor (2019)" : ENG_THESAURI[random.Below(sizeof(ENG_THESAURI)/sizeof(ENG_THESAURI[0]))];
+            r += "</ThesaurusID>\n     </ThesaurusIDlist>\n    </Term>\n";
+        }
+        r += "   </TermList>\n  </Concept>\n";
+    }
+    r += " </ConceptList>\n</DescriptorRecord>\n";
+
+    fwrite(r.data(), 1, r.length(), output);
+}
+
+void Usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s <records> [--seed <number>] [--revision <number>] [--supplemental]\n", name);
+}
+
+int main(int argc, char** argv)
+{
+    if (2 > argc)
+    {
+        Usage(argv[0]);
+        return -1;
+    }
+
+    long records = atol(argv[1]);
+    uint64_t seed = DEFAULT_SEED;
+    int revision = 0;
+    bool supplemental = false;
+    for (int i=2; i<argc; i+=2)
+    {
+        if (0==strcmp("--seed", argv[i]) && i+1<argc)
+        {
+            seed = strtoull(argv[i+1], NULL, 10);
+        }
+        else if (0==strcmp("--revision", argv[i]) && i+1<argc)
+        {
+            revision = atoi(argv[i+1]);
+        }
+        else if (0==strcmp("--supplemental", argv[i]))
+        {
+            supplemental = true;
+            i--; //Takes no value
+        }
+        else
+        {
+            Usage(argv[0]);
+            return -1;
+        }
+    }
+    if (0 >= records)
+    {
+        Usage(argv[0]);
+        return -1;
+    }
+
+    static char buffer[1024*1024];
+    setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+    Generator generator(records, seed, revision);
+    if (supplemental)
+    {
+        generator.WriteSupplemental(stdout);
+    }
+    else
+    {
+        generator.Write(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+// Compares the libxml2 DOM-per-record parser with the memory-mapped parser on
+// the same MeSH file. Run each parser in its own process, so peak RSS is its own:
+//
+//   ./parser_bench libxml2 ~/Downloads/nordesc2019.xml
+//   ./parser_bench mmap ~/Downloads/nordesc2019.xml
+//   ./parser_bench mmap --threads 8 ~/Downloads/nordesc2019.xml
+//
+// Both keep every Descriptor in memory, like the importer does.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <libxml/xmlreader.h>
+
+#include <chrono>
+#include <thread>
+
+#include "descriptor_parser.h"
+#include "mapped_file.h"
+#include "mmap_parser.h"
+
+
+long ParseWithLibxml2(const char* filename, std::vector<Descriptor>& descriptors)
+{
+    long records = 0;
+    xmlTextReaderPtr reader = xmlReaderForFile(filename, NULL, XML_PARSE_NOBLANKS|XML_PARSE_NOCDATA|XML_PARSE_COMPACT);
+    if (!reader)
+        return -1;
+
+    if (1==xmlTextReaderNext(reader) && XML_READER_TYPE_DOCUMENT_TYPE==xmlTextReaderNodeType(reader) &&
+        1==xmlTextReaderNext(reader) && 1==xmlTextReaderRead(reader))
+    {
+        bool more = true;
+        xmlNodePtr descriptor_record_ptr;
+        while (more &&
+               NULL!=(descriptor_record_ptr=xmlTextReaderExpand(reader)) &&
+               XML_ELEMENT_NODE==descriptor_record_ptr->type && 0==xmlStrcmp(BAD_CAST("DescriptorRecord"), descriptor_record_ptr->name))
+        {
+            Descriptor descriptor;
+            if (ProcessDescriptorRecord(descriptor_record_ptr, false, "nor", descriptor))
+            {
+                descriptors.push_back(std::move(descriptor));
+            }
+            records++;
+            more = (1 == xmlTextReaderNext(reader));
+        }
+    }
+
+    xmlFreeTextReader(reader);
+    return records;
+}
+
+void ParseRange(const MappedFile* file, ByteRange range, std::vector<Descriptor>* descriptors, long* records)
+{
+    MappedDescriptorParser parser(range.begin, range.end, false, "nor");
+    const char* released_position = range.begin;
+    Descriptor descriptor;
+    while (parser.Next(descriptor))
+    {
+        descriptors->push_back(std::move(descriptor));
+        if (MAPPED_RELEASE_BYTES <= parser.GetPosition()-released_position)
+        {
+            file->Release(released_position, parser.GetRecordStart());
+            released_position = parser.GetRecordStart();
+        }
+    }
+    *records = parser.GetRecordCount();
+}
+
+long ParseMapped(const char* filename, int thread_count, std::vector<std::vector<Descriptor> >& range_descriptors)
+{
+    MappedFile file;
+    if (!file.Open(filename))
+        return -1;
+
+    const char* end = file.GetData() + file.GetSize();
+    std::string language_code;
+    const char* records_begin;
+    if (!MappedDescriptorParser::ReadDescriptorRecordSet(file.GetData(), end, language_code, records_begin))
+        return -1;
+
+    std::vector<ByteRange> ranges;
+    MappedDescriptorParser::SplitAtDescriptorRecords(records_begin, end, thread_count, ranges);
+
+    range_descriptors.resize(ranges.size());
+    std::vector<long> range_records(ranges.size(), 0);
+    std::vector<std::thread> threads;
+    for (size_t i=0; i<ranges.size(); i++)
+    {
+        threads.push_back(std::thread(ParseRange, &file, ranges[i], &range_descriptors[i], &range_records[i]));
+    }
+
+    long records = 0;
+    for (size_t i=0; i<ranges.size(); i++)
+    {
+        threads[i].join();
+        records += range_records[i];
+    }
+    return records;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc<3 || (0!=strcmp("libxml2", argv[1]) && 0!=strcmp("mmap", argv[1])))
+    {
+        fprintf(stderr, "Usage: %s <libxml2|mmap> [--threads <count>] <MeSH-file>\n", argv[0]);
+        return -1;
+    }
+
+    bool mapped = (0 == strcmp("mmap", argv[1]));
+    int thread_count = 1;
+    if (5==argc && 0==strcmp("--threads", argv[2]))
+    {
+        thread_count = std::max(1, atoi(argv[3]));
+    }
+    const char* filename = argv[argc-1];
+
+    struct stat filestat;
+    if (0 != stat(filename, &filestat))
+    {
+        fprintf(stderr, "File Not Found: %s\n", filename);
+        return -1;
+    }
+
+    LIBXML_TEST_VERSION
+
+    std::vector<std::vector<Descriptor> > descriptors(1); //One vector per range, so merging does not count against peak RSS
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    long records = mapped ? ParseMapped(filename, thread_count, descriptors) : ParseWithLibxml2(filename, descriptors[0]);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (0 > records)
+    {
+        fprintf(stderr, "Could not parse %s\n", filename);
+        return -1;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    size_t descriptor_count = 0;
+    for (size_t i=0; i<descriptors.size(); i++)
+    {
+        descriptor_count += descriptors[i].size();
+    }
+
+    double megabytes = filestat.st_size/(1024.0*1024.0);
+    fprintf(stdout, "%s (%d thread%s): %ld records, %ld descriptors, %.1f MB in %.3f s, %.1f MB/s, peak RSS %.1f MB\n",
+            argv[1], thread_count, 1==thread_count ? "" : "s", records, (long)descriptor_count,
+            megabytes, seconds, megabytes/seconds, usage.ru_maxrss/1024.0);
+
+    xmlCleanupParser();
+    return 0;
+}
@@ -0,0 +1,417 @@
+// Replays searches against the mesh index with the suggestion query MeSHWeb
+// sends (SuggestionFilterQuery in MeSHWeb/strings.xml) and with the 14-field
+// multi_match it sent before the consolidated search fields, and reports the
+// latency percentiles of both:
+//
+//   ./query_replay localhost:9200
+//   ./query_replay localhost:9200 --log searches.txt --passes 5 --prefixes
+//
+// A log has one search text per line. Without one, the names of the most
+// opened descriptors in the text_statistics index are searched for, and how
+// often the descriptor is among the hits is reported too. --prefixes also
+// replays every prefix of two characters or more, like the suggestion list
+// does while a search is typed. --terms compares with SuggestionTermQuery on
+// the mesh_terms index instead, which the suggestion list uses. The two
+// queries alternate, so both see the same cache state. The index must have
+// been imported with the names_all, terms_all and ids_all fields.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "elasticsearch/elasticsearch.h"
+
+#define SUGGESTION_COUNT  (20) //As in MeSHWeb/application.h
+#define STATISTICS_COUNT  (500) //Most opened descriptors searched for without a log
+#define MIN_PREFIX_LENGTH (2) //Shorter searches do not get suggestions
+#define DEFAULT_PASSES    (3)
+
+static const char* BASELINE_QUERY =
+    "{\"from\": {1}, \"size\": {2}, \"sort\": [{\"_score\": {\"order\": \"desc\"}}], \"query\": {\"bool\": {\"must\": {\"multi_match\": {\"query\": \"{3}\", \"fuzziness\": 0, \"operator\": \"AND\", \"type\": \"most_fields\", "
+    "\"fields\": [\"id^150\", \"other_ids^120\", \"nor_name^100\", \"nor_preferred_term_text^80\", \"nor_description^80\", \"eng_name^70\", \"eng_preferred_term_text^60\", \"eng_description^60\", "
+    "\"nor_other_term_texts^10\", \"eng_other_term_texts^8\", \"see_related^5\", \"tree_numbers^3\", \"parent_tree_numbers^2\", \"child_tree_numbers\"]} }, \"filter\": [{4}] } } } ";
+
+
+struct ReplaySearch
+{
+    std::string text;
+    std::string expected_id; //Empty for searches from a log
+};
+
+struct ReplayResult
+{
+    std::vector<double> wall_ms;
+    std::vector<double> took_ms;
+    long expected_found;
+    long expected_searches;
+    long failed;
+
+    ReplayResult() : expected_found(0), expected_searches(0), failed(0) {}
+};
+
+
+void ReplaceAll(std::string& text, const std::string& from, const std::string& to)
+{
+    size_t position = 0;
+    while (std::string::npos != (position = text.find(from, position)))
+    {
+        text.replace(position, from.length(), to);
+        position += to.length();
+    }
+}
+
+bool ReadMessage(const char* filename, const char* id, std::string& message)
+{
+    std::ifstream file(filename);
+    if (!file)
+        return false;
+
+    std::stringstream content;
+    content << file.rdbuf();
+    const std::string xml = content.str();
+
+    const std::string start_tag = std::string("<message id=\"") + id + "\">";
+    size_t start = xml.find(start_tag);
+    if (std::string::npos == start)
+        return false;
+
+    start += start_tag.length();
+    size_t end = xml.find("</message>", start);
+    if (std::string::npos == end)
+        return false;
+
+    message = xml.substr(start, end-start);
+    ReplaceAll(message, "&lt;", "<");
+    ReplaceAll(message, "&gt;", ">");
+    ReplaceAll(message, "&quot;", "\"");
+    ReplaceAll(message, "&amp;", "&");
+    return true;
+}
+
+std::string SuggestionQuery(const std::string& query_template, const std::string& text)
+{
+    std::string query = query_template;
+    ReplaceAll(query, "{1}", "0");
+    ReplaceAll(query, "{2}", std::to_string(SUGGESTION_COUNT+1));
+    ReplaceAll(query, "{3}", Json::Value::escapeJsonString(text));
+    ReplaceAll(query, "{4}", "");
+    return query;
+}
+
+const Json::Array HitsArray(const Json::Object& search_result)
+{
+    if (!search_result.member("hits"))
+        return Json::Array();
+
+    const Json::Object hits_object = search_result.getValue("hits").getObject();
+    if (!hits_object.member("hits"))
+        return Json::Array();
+
+    return hits_object.getValue("hits").getArray();
+}
+
+bool ReadLog(const char* filename, std::vector<ReplaySearch>& searches)
+{
+    std::ifstream file(filename);
+    if (!file)
+    {
+        fprintf(stderr, "Could not read %s\n", filename);
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && '\r'==line[line.length()-1])
+        {
+            line.erase(line.length()-1);
+        }
+        if (MIN_PREFIX_LENGTH > line.length())
+            continue;
+
+        ReplaySearch search;
+        search.text = line;
+        searches.push_back(search);
+    }
+    return true;
+}
+
+bool ReadStatistics(ElasticSearch& es, std::vector<ReplaySearch>& searches)
+{
+    std::stringstream statistics_query;
+    statistics_query << "{\"from\": 0, \"size\": " << STATISTICS_COUNT << ", \"_source\": false, \"sort\": {\"count\": {\"order\": \"desc\"}}, \"query\": {\"match_all\": {} } }";
+
+    Json::Object statistics_result;
+    if (0 >= es.search("text_statistics", statistics_query.str(), statistics_result))
+    {
+        fprintf(stderr, "Found no searches in the text_statistics index\n");
+        return false;
+    }
+
+    std::stringstream names_query;
+    names_query << "{\"from\": 0, \"size\": " << STATISTICS_COUNT << ", \"_source\": [\"nor_name\", \"eng_name\"], \"query\": {\"ids\": {\"values\": [";
+    const Json::Array statistics_hits = HitsArray(statistics_result);
+    Json::Array::const_iterator iterator = statistics_hits.begin();
+    for (; iterator!=statistics_hits.end(); ++iterator)
+    {
+        if (iterator!=statistics_hits.begin())
+        {
+            names_query << ",";
+        }
+        names_query << "\"" << Json::Value::escapeJsonString(iterator->getObject().getValue("_id").getString()) << "\"";
+    }
+    names_query << "]} } }";
+
+    Json::Object names_result;
+    if (0 >= es.search("mesh", names_query.str(), names_result))
+    {
+        fprintf(stderr, "Found none of the opened descriptors in the mesh index\n");
+        return false;
+    }
+
+    const Json::Array names_hits = HitsArray(names_result);
+    for (iterator=names_hits.begin(); iterator!=names_hits.end(); ++iterator)
+    {
+        const Json::Object hit_object = iterator->getObject();
+        const Json::Object source_object = hit_object.getValue("_source").getObject();
+
+        ReplaySearch search;
+        search.expected_id = hit_object.getValue("_id").getString();
+        if (source_object.member("nor_name"))
+        {
+            search.text = source_object.getValue("nor_name").getString();
+            searches.push_back(search);
+        }
+        if (source_object.member("eng_name"))
+        {
+            search.text = source_object.getValue("eng_name").getString();
+            searches.push_back(search);
+        }
+    }
+    return true;
+}
+
+void AddPrefixes(std::vector<ReplaySearch>& searches)
+{
+    std::vector<ReplaySearch> with_prefixes;
+    std::vector<ReplaySearch>::const_iterator iterator = searches.begin();
+    for (; iterator!=searches.end(); ++iterator)
+    {
+        const std::string& text = iterator->text;
+        for (size_t length=MIN_PREFIX_LENGTH; length<text.length(); length++)
+        {
+            if (0x80 == (static_cast<unsigned char>(text[length]) & 0xC0)) //Inside a UTF-8 character
+                continue;
+
+            ReplaySearch prefix = *iterator;
+            prefix.text = text.substr(0, length);
+            with_prefixes.push_back(prefix);
+        }
+        with_prefixes.push_back(*iterator);
+    }
+    searches.swap(with_prefixes);
+}
+
+void RunSearch(ElasticSearch& es, const char* index, const std::string& query_template, const ReplaySearch& search, bool measure, ReplayResult& result, std::string& top_id)
+{
+    top_id.clear();
+    Json::Object search_result;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    try
+    {
+        es.search(index, SuggestionQuery(query_template, search.text), search_result);
+    }
+    catch(...)
+    {
+        result.failed++;
+        return;
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    const Json::Array hits = HitsArray(search_result);
+    bool expected_found = false;
+    Json::Array::const_iterator iterator = hits.begin();
+    for (; iterator!=hits.end(); ++iterator)
+    {
+        const Json::Object hit_object = iterator->getObject();
+        const Json::Object source_object = hit_object.member("_source") ? hit_object.getValue("_source").getObject() : Json::Object();
+        //Term documents have ids of their own, the descriptor's is in the source
+        const std::string id = source_object.member("id") ? source_object.getValue("id").getString() : hit_object.getValue("_id").getString();
+        if (iterator==hits.begin())
+        {
+            top_id = id;
+        }
+        if (!search.expected_id.empty() && id==search.expected_id)
+        {
+            expected_found = true;
+        }
+    }
+
+    if (!measure)
+        return;
+
+    result.wall_ms.push_back(std::chrono::duration<double, std::milli>(end-start).count());
+    if (search_result.member("took"))
+    {
+        result.took_ms.push_back(search_result.getValue("took").getLong());
+    }
+    if (!search.expected_id.empty())
+    {
+        result.expected_searches++;
+        if (expected_found)
+        {
+            result.expected_found++;
+        }
+    }
+}
+
+double Percentile(std::vector<double>& values, double percentile)
+{
+    if (values.empty())
+        return 0.0;
+
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(percentile/100.0*(values.size()-1) + 0.5);
+    return values[index];
+}
+
+void PrintResult(const char* name, ReplayResult& result)
+{
+    double sum = 0.0;
+    std::vector<double>::const_iterator iterator = result.wall_ms.begin();
+    for (; iterator!=result.wall_ms.end(); ++iterator)
+    {
+        sum += *iterator;
+    }
+    double mean = result.wall_ms.empty() ? 0.0 : sum/result.wall_ms.size();
+
+    fprintf(stdout, "%-13s %8.2f %8.2f %8.2f %8.2f %8.0f %8.0f",
+            name, Percentile(result.wall_ms, 50), Percentile(result.wall_ms, 95), Percentile(result.wall_ms, 99), mean,
+            Percentile(result.took_ms, 50), Percentile(result.took_ms, 95));
+    if (0 < result.expected_searches)
+    {
+        fprintf(stdout, " %7.1f%%", 100.0*result.expected_found/result.expected_searches);
+    }
+    if (0 < result.failed)
+    {
+        fprintf(stdout, "  (%ld failed)", result.failed);
+    }
+    fprintf(stdout, "\n");
+}
+
+void Usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s <elasticsearch location> [--log <file>] [--passes <n>] [--prefixes] [--terms] [--strings <strings.xml>]\n", program);
+}
+
+int main(int argc, char* argv[])
+{
+    if (2 > argc)
+    {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char* log_filename = NULL;
+    const char* strings_filename = "../../MeSHWeb/strings.xml";
+    int passes = DEFAULT_PASSES;
+    bool prefixes = false;
+    const char* candidate_message = "SuggestionFilterQuery";
+    const char* candidate_index = "mesh";
+    for (int current_arg=2; current_arg<argc; current_arg++)
+    {
+        if (0==strcmp("--log", argv[current_arg]) && current_arg<(argc-1))
+        {
+            log_filename = argv[++current_arg];
+        }
+        else if (0==strcmp("--passes", argv[current_arg]) && current_arg<(argc-1))
+        {
+            passes = std::max(1, atoi(argv[++current_arg]));
+        }
+        else if (0==strcmp("--strings", argv[current_arg]) && current_arg<(argc-1))
+        {
+            strings_filename = argv[++current_arg];
+        }
+        else if (0==strcmp("--prefixes", argv[current_arg]))
+        {
+            prefixes = true;
+        }
+        else if (0==strcmp("--terms", argv[current_arg]))
+        {
+            candidate_message = "SuggestionTermQuery";
+            candidate_index = "mesh_terms";
+        }
+        else
+        {
+            Usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::string candidate_query;
+    if (!ReadMessage(strings_filename, candidate_message, candidate_query))
+    {
+        fprintf(stderr, "Found no %s in %s\n", candidate_message, strings_filename);
+        return EXIT_FAILURE;
+    }
+    const std::string baseline_query = BASELINE_QUERY;
+
+    ElasticSearch es(argv[1]);
+    std::vector<ReplaySearch> searches;
+    if (log_filename ? !ReadLog(log_filename, searches) : !ReadStatistics(es, searches))
+        return EXIT_FAILURE;
+
+    if (prefixes)
+    {
+        AddPrefixes(searches);
+    }
+    if (searches.empty())
+    {
+        fprintf(stderr, "No searches to replay\n");
+        return EXIT_FAILURE;
+    }
+    fprintf(stdout, "Replaying %lu searches, %d passes\n", searches.size(), passes);
+
+    //The first pass warms the caches and is not measured
+    ReplayResult baseline;
+    ReplayResult candidate;
+    std::string baseline_top_id;
+    std::string candidate_top_id;
+    long same_top = 0;
+    for (int pass=0; pass<=passes; pass++)
+    {
+        bool measure = (0 < pass);
+        same_top = 0;
+        for (size_t i=0; i<searches.size(); i++)
+        {
+            if (0 == (i+pass)%2)
+            {
+                RunSearch(es, "mesh", baseline_query, searches[i], measure, baseline, baseline_top_id);
+                RunSearch(es, candidate_index, candidate_query, searches[i], measure, candidate, candidate_top_id);
+            }
+            else
+            {
+                RunSearch(es, candidate_index, candidate_query, searches[i], measure, candidate, candidate_top_id);
+                RunSearch(es, "mesh", baseline_query, searches[i], measure, baseline, baseline_top_id);
+            }
+            if (baseline_top_id == candidate_top_id)
+            {
+                same_top++;
+            }
+        }
+    }
+
+    fprintf(stdout, "%-13s %8s %8s %8s %8s %8s %8s%s\n", "query", "p50 ms", "p95 ms", "p99 ms", "mean ms", "took p50", "took p95",
+            (0 < baseline.expected_searches) ? "    found" : "");
+    PrintResult("14 fields", baseline);
+    PrintResult(("mesh" == std::string(candidate_index)) ? "consolidated" : "terms", candidate);
+    fprintf(stdout, "Same top hit for %.1f%% of the searches\n", 100.0*same_top/searches.size());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,51 @@
+// Runs a command and reports its wall time and peak RSS, taken from wait4()
+// so nothing else in the process tree is counted:
+//
+//   ./run_measured ../MeSHImport localhost:9299 --clean /tmp/mesh_100k.xml
+//
+// Prints "seconds=<wall> peak_rss_kb=<rss> exit=<status>" to stderr.
+
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+
+
+int main(int argc, char** argv)
+{
+    if (2 > argc)
+    {
+        fprintf(stderr, "Usage: %s <command> [arguments]\n", argv[0]);
+        return -1;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pid_t child = fork();
+    if (0 == child)
+    {
+        execvp(argv[1], argv+1);
+        perror(argv[1]);
+        _exit(127);
+    }
+    else if (0 > child)
+    {
+        perror("fork");
+        return -1;
+    }
+
+    int status = 0;
+    struct rusage usage;
+    if (child != wait4(child, &status, 0, &usage))
+    {
+        perror("wait4");
+        return -1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+
+    int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128+WTERMSIG(status);
+    fprintf(stderr, "seconds=%.3f peak_rss_kb=%ld exit=%d\n", seconds, usage.ru_maxrss, exit_code);
+    return exit_code;
+}
@@ -0,0 +1,136 @@
+#ifndef _BOUNDED_QUEUE_H_
+#define _BOUNDED_QUEUE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+
+// Bounded multi-producer/multi-consumer lock-free queue (Dmitry Vyukov's ring
+// buffer design). Push/Pop block with a backoff when the queue is full/empty,
+// which is what gives the import pipeline its backpressure.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+
+        m_mask = size - 1;
+        m_cells.reset(new Cell[size]);
+        for (size_t i=0; i<size; i++)
+        {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_enqueue_position.store(0, std::memory_order_relaxed);
+        m_dequeue_position.store(0, std::memory_order_relaxed);
+    }
+
+public:
+    bool TryPush(T& value)
+    {
+        size_t position = m_enqueue_position.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = m_cells[position & m_mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+            if (0 == difference)
+            {
+                if (m_enqueue_position.compare_exchange_weak(position, position+1, std::memory_order_relaxed))
+                {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position+1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (0 > difference)
+            {
+                return false; //Full
+            }
+            else
+            {
+                position = m_enqueue_position.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool TryPop(T& value)
+    {
+        size_t position = m_dequeue_position.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = m_cells[position & m_mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)(position+1);
+            if (0 == difference)
+            {
+                if (m_dequeue_position.compare_exchange_weak(position, position+1, std::memory_order_relaxed))
+                {
+                    value = std::move(cell.value);
+                    cell.sequence.store(position+m_mask+1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (0 > difference)
+            {
+                return false; //Empty
+            }
+            else
+            {
+                position = m_dequeue_position.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Push(T value)
+    {
+        for (int attempt=0; !TryPush(value); attempt++)
+        {
+            Backoff(attempt);
+        }
+    }
+
+    void Pop(T& value)
+    {
+        for (int attempt=0; !TryPop(value); attempt++)
+        {
+            Backoff(attempt);
+        }
+    }
+
+private:
+    static void Backoff(int attempt)
+    {
+        if (attempt < 64)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(attempt<1024 ? 50 : 1000));
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+    char m_padding1[64]; //Keep the two positions on separate cache lines
+    std::atomic<size_t> m_enqueue_position;
+    char m_padding2[64];
+    std::atomic<size_t> m_dequeue_position;
+};
+
+#endif // _BOUNDED_QUEUE_H_
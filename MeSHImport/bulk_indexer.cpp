@@ -0,0 +1,467 @@
+#include "bulk_indexer.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+
+BulkIndexer::BulkIndexer(const std::string& es_location, const std::string& index, size_t max_batch_documents, size_t max_batch_bytes,
+                         int sender_count, size_t queue_size, ImportMetrics* metrics)
+: m_es_location(es_location),
+  m_bulk_url(index + "/_bulk?filter_path=errors,items.*._id,items.*.status,items.*.error.type,items.*.error.reason"),
+  m_max_batch_documents(max_batch_documents),
+  m_max_batch_bytes(max_batch_bytes),
+  m_metrics(metrics),
+  m_max_retries(DEFAULT_BULK_RETRIES),
+  m_latency_target_seconds(DEFAULT_BULK_LATENCY_MS/1000.0),
+  m_max_in_flight_bytes(DEFAULT_IN_FLIGHT_BYTES),
+  m_current_batch(new Batch),
+  m_batch_documents(max_batch_documents),
+  m_batch_bytes(max_batch_bytes),
+  m_queue(queue_size),
+  m_pending_batches(0),
+  m_in_flight_bytes(0),
+  m_indexed_count(0),
+  m_failed_count(0),
+  m_retried_count(0),
+  m_shard_count(0)
+{
+    for (int i=0; i<sender_count; i++)
+    {
+        m_sender_threads.push_back(std::thread(&BulkIndexer::SenderThread, this));
+    }
+}
+
+BulkIndexer::~BulkIndexer()
+{
+    Flush();
+
+    for (size_t i=0; i<m_sender_threads.size(); i++)
+    {
+        m_queue.Push(nullptr);
+    }
+    for (size_t i=0; i<m_sender_threads.size(); i++)
+    {
+        m_sender_threads[i].join();
+    }
+    delete m_current_batch;
+}
+
+void BulkIndexer::Index(const std::string& id, const std::string& document)
+{
+    AddAction(id, "index", &document);
+}
+
+void BulkIndexer::Update(const std::string& id, const std::string& update)
+{
+    AddAction(id, "update", &update);
+}
+
+void BulkIndexer::Delete(const std::string& id)
+{
+    AddAction(id, "delete", nullptr);
+}
+
+void BulkIndexer::AddAction(const std::string& id, const std::string& action, const std::string* document)
+{
+    const std::string escaped_id = Json::Value::escapeJsonString(id);
+
+    Batch* full_batch = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_batch_mutex);
+        m_current_batch->offsets.push_back(m_current_batch->payload.length());
+        m_current_batch->payload.append("{\"").append(action).append("\":{\"_id\":\"").append(escaped_id).append("\"}}\n");
+        if (document)
+        {
+            m_current_batch->payload.append(*document).append("\n");
+        }
+        m_current_batch->ids.push_back(id);
+
+        if (m_current_batch->ids.size() >= m_batch_documents || m_current_batch->payload.length() >= m_batch_bytes)
+        {
+            full_batch = m_current_batch;
+            m_current_batch = new Batch;
+        }
+    }
+
+    if (full_batch)
+    {
+        QueueBatch(full_batch); //Blocks while the queue or the in-flight bytes are full, which is our backpressure
+    }
+}
+
+bool BulkIndexer::Replay(const std::string& payload)
+{
+    //Shards are written by WriteBatch, so every action line is {"<action>":{"_id":"<id>"}}, and all but delete actions have a document line
+    static const char ID_KEY[] = "\":{\"_id\":\"";
+    static const char DELETE_ACTION[] = "{\"delete\"";
+    Batch* batch = new Batch;
+    batch->payload = payload;
+    size_t position = 0;
+    while (position < payload.length())
+    {
+        size_t line_end = payload.find('\n', position);
+        size_t id_start = payload.find(ID_KEY, position);
+        if (std::string::npos==line_end || std::string::npos==id_start || line_end<id_start)
+            break;
+
+        id_start += sizeof(ID_KEY)-1;
+        size_t id_end = payload.find('"', id_start);
+        if (std::string::npos==id_end || line_end<id_end)
+            break;
+
+        batch->offsets.push_back(position);
+        batch->ids.push_back(payload.substr(id_start, id_end-id_start));
+        bool has_document = (0 != payload.compare(position, sizeof(DELETE_ACTION)-1, DELETE_ACTION));
+        position = line_end+1;
+        if (has_document)
+        {
+            line_end = payload.find('\n', position);
+            if (std::string::npos == line_end)
+                break;
+            position = line_end+1;
+        }
+    }
+
+    if (position!=payload.length() || batch->ids.empty())
+    {
+        delete batch;
+        return false;
+    }
+    QueueBatch(batch);
+    return true;
+}
+
+void BulkIndexer::Flush()
+{
+    Batch* last_batch;
+    {
+        std::lock_guard<std::mutex> lock(m_batch_mutex);
+        last_batch = m_current_batch;
+        m_current_batch = new Batch;
+    }
+
+    if (last_batch->ids.empty())
+    {
+        delete last_batch;
+    }
+    else
+    {
+        QueueBatch(last_batch);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_all_sent.wait(lock, [this] {return 0 == m_pending_batches;});
+}
+
+long BulkIndexer::GetIndexedCount() const
+{
+    return m_indexed_count;
+}
+
+long BulkIndexer::GetFailedCount() const
+{
+    return m_failed_count;
+}
+
+long BulkIndexer::GetRetriedCount() const
+{
+    return m_retried_count;
+}
+
+long BulkIndexer::GetShardCount() const
+{
+    return m_shard_count;
+}
+
+size_t BulkIndexer::GetBatchDocuments() const
+{
+    std::lock_guard<std::mutex> lock(m_batch_mutex);
+    return m_batch_documents;
+}
+
+void BulkIndexer::QueueBatch(Batch* batch)
+{
+    {
+        //A batch larger than the cap is let through alone, or it would never be sent
+        std::unique_lock<std::mutex> lock(m_mutex);
+        size_t bytes = batch->payload.length();
+        m_in_flight_space.wait(lock, [this, bytes] {return 0==m_in_flight_bytes || m_in_flight_bytes+bytes<=m_max_in_flight_bytes;});
+        m_in_flight_bytes += bytes;
+        m_pending_batches++;
+    }
+    m_queue.Push(batch);
+}
+
+void BulkIndexer::SenderThread()
+{
+    HTTP http(m_es_location, true);
+    Batch* batch;
+    while (true)
+    {
+        m_queue.Pop(batch);
+        if (!batch)
+            break;
+
+        size_t bytes = batch->payload.length();
+        if (m_output_directory.empty())
+        {
+            SendBatch(http, *batch);
+        }
+        else
+        {
+            WriteBatch(*batch);
+        }
+        delete batch;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_in_flight_bytes -= bytes;
+        m_in_flight_space.notify_all();
+        if (0 == --m_pending_batches)
+        {
+            m_all_sent.notify_all();
+        }
+    }
+}
+
+void BulkIndexer::SendBatch(HTTP& http, Batch& batch)
+{
+    for (int attempt=0; ; attempt++)
+    {
+        Json::Object result;
+        double seconds;
+        unsigned int status = PostBatch(http, batch, result, seconds);
+        bool may_retry = (attempt < m_max_retries);
+
+        if (200 == status)
+        {
+            Batch retry_batch;
+            ProcessBulkResponse(batch, result, may_retry ? &retry_batch : NULL);
+            AdaptBatchSize(!retry_batch.ids.empty() || m_latency_target_seconds<seconds);
+            if (retry_batch.ids.empty())
+                return;
+
+            batch = std::move(retry_batch); //Only the rejected items are sent again
+        }
+        else if (may_retry && IsRetryableStatus(status))
+        {
+            AdaptBatchSize(true);
+        }
+        else
+        {
+            std::string reason = status ? "bulk request failed with HTTP status " + std::to_string(status) : "bulk request failed";
+            if (0 < attempt)
+            {
+                reason += " after " + std::to_string(attempt) + " retries";
+            }
+            std::vector<std::string>::const_iterator id_iterator = batch.ids.begin();
+            for (; id_iterator!=batch.ids.end(); ++id_iterator)
+            {
+                ReportFailure(*id_iterator, reason);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_retried_count += batch.ids.size();
+        }
+        if (m_metrics)
+        {
+            m_metrics->AddRetry("bulk");
+        }
+        Backoff(attempt);
+    }
+}
+
+void BulkIndexer::WriteBatch(const Batch& batch)
+{
+    long shard;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        shard = ++m_shard_count;
+    }
+
+    //Numbered in the order they were built. Renamed when complete, so a loader never sees half a shard
+    char shard_name[32];
+    snprintf(shard_name, sizeof(shard_name), "%08ld.ndjson", shard);
+    const std::string filename = m_output_directory + "/" + shard_name;
+    const std::string temporary_filename = filename + ".tmp";
+
+    ImportMetrics::Clock::time_point start = ImportMetrics::Clock::now();
+    FILE* file = fopen(temporary_filename.c_str(), "w");
+    bool ok = (NULL != file);
+    if (file)
+    {
+        ok = (batch.payload.length() == fwrite(batch.payload.data(), 1, batch.payload.length(), file));
+        ok = (0 == fclose(file)) && ok;
+    }
+    ok = ok && 0==rename(temporary_filename.c_str(), filename.c_str());
+    if (m_metrics)
+    {
+        m_metrics->AddRequest("shard", ImportMetrics::SecondsSince(start), batch.payload.length(), ok);
+    }
+
+    if (!ok)
+    {
+        const std::string reason = "could not write " + filename + ": " + strerror(errno);
+        remove(temporary_filename.c_str());
+        std::vector<std::string>::const_iterator id_iterator = batch.ids.begin();
+        for (; id_iterator!=batch.ids.end(); ++id_iterator)
+        {
+            ReportFailure(*id_iterator, reason);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_indexed_count += batch.ids.size();
+    }
+    Acknowledge(batch, std::vector<bool>(batch.ids.size(), true));
+}
+
+unsigned int BulkIndexer::PostBatch(HTTP& http, const Batch& batch, Json::Object& result, double& seconds)
+{
+    unsigned int status;
+    ImportMetrics::Clock::time_point start = ImportMetrics::Clock::now();
+    try
+    {
+        status = http.post(m_bulk_url.c_str(), batch.payload.c_str(), &result);
+    }
+    catch(...)
+    {
+        status = 0; //Could not connect, or the connection was lost
+    }
+    seconds = ImportMetrics::SecondsSince(start);
+
+    if (m_metrics)
+    {
+        m_metrics->AddRequest("bulk", seconds, batch.payload.length(), 200==status);
+    }
+    return status;
+}
+
+void BulkIndexer::ProcessBulkResponse(const Batch& batch, const Json::Object& result, Batch* retry_batch)
+{
+    //Items come back in request order, so their position identifies the action to send again
+    long failed_in_batch = 0;
+    std::vector<bool> indexed(batch.ids.size(), true);
+    if (result.member("errors") && result.getValue("errors").getBoolean() && result.member("items"))
+    {
+        const Json::Array items_array = result.getValue("items").getArray();
+        Json::Array::const_iterator item_iterator = items_array.begin();
+        for (size_t item=0; item_iterator!=items_array.end(); ++item_iterator, item++)
+        {
+            const Json::Object item_object = (*item_iterator).getObject();
+            const char* action = item_object.member("index") ? "index" : (item_object.member("update") ? "update" : "delete");
+            if (!item_object.member(action))
+                continue;
+
+            const Json::Object action_object = item_object.getValue(action).getObject();
+            if (!action_object.member("error"))
+                continue;
+
+            const Json::Object error_object = action_object.getValue("error").getObject();
+            const std::string type = error_object.getValue("type").getString();
+            bool rejected = ("es_rejected_execution_exception"==type ||
+                             (action_object.member("status") && 429==action_object.getValue("status").getInt()));
+            if (rejected && retry_batch && item<batch.ids.size())
+            {
+                retry_batch->Add(batch, item);
+                indexed[item] = false; //Not yet
+                continue;
+            }
+
+            const std::string id = (item < batch.ids.size()) ? batch.ids[item] : action_object.getValue("_id").getString();
+            ReportFailure(id, type + ": " + error_object.getValue("reason").getString());
+            failed_in_batch++;
+            if (item < indexed.size())
+            {
+                indexed[item] = false;
+            }
+        }
+    }
+
+    long retried_in_batch = retry_batch ? retry_batch->ids.size() : 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_indexed_count += batch.ids.size() - failed_in_batch - retried_in_batch;
+        if (m_metrics)
+        {
+            m_metrics->SampleProgress("index", m_indexed_count);
+        }
+    }
+    Acknowledge(batch, indexed);
+}
+
+void BulkIndexer::AdaptBatchSize(bool overloaded)
+{
+    std::lock_guard<std::mutex> lock(m_batch_mutex);
+    if (overloaded) //Multiplicative decrease
+    {
+        m_batch_documents = std::max(std::min(static_cast<size_t>(MIN_BULK_DOCUMENTS), m_max_batch_documents), m_batch_documents/2);
+        m_batch_bytes = std::max(std::min(static_cast<size_t>(MIN_BULK_BYTES), m_max_batch_bytes), m_batch_bytes/2);
+    }
+    else //Additive increase, back up to the configured size
+    {
+        m_batch_documents = std::min(m_max_batch_documents, m_batch_documents + std::max(static_cast<size_t>(1), m_max_batch_documents/10));
+        m_batch_bytes = std::min(m_max_batch_bytes, m_batch_bytes + std::max(static_cast<size_t>(1), m_max_batch_bytes/10));
+    }
+}
+
+void BulkIndexer::ReportFailure(const std::string& id, const std::string& reason)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        fprintf(stderr, "\nFailed to index %s: %s\n", id.c_str(), reason.c_str());
+        m_failed_count++;
+        m_failed_ids.push_back(id);
+    }
+    if (m_acknowledge)
+    {
+        m_acknowledge(id, false);
+    }
+}
+
+void BulkIndexer::Acknowledge(const Batch& batch, const std::vector<bool>& indexed)
+{
+    //Outside m_mutex, the callback may take its own locks
+    if (!m_acknowledge)
+        return;
+
+    for (size_t item=0; item<batch.ids.size(); item++)
+    {
+        if (indexed[item])
+        {
+            m_acknowledge(batch.ids[item], true);
+        }
+    }
+}
+
+bool BulkIndexer::IsRetryableStatus(unsigned int status)
+{
+    //0 is a connection failure. 429 is Elasticsearch rejecting work, the others are proxies and restarting nodes
+    return 0==status || 429==status || 502==status || 503==status || 504==status;
+}
+
+void BulkIndexer::Backoff(int attempt)
+{
+    //Exponential with jitter, so senders that failed together do not retry together
+    static thread_local std::mt19937 generator(std::random_device{}());
+    long ceiling = std::min(static_cast<long>(MAX_RETRY_BACKOFF_MS), static_cast<long>(RETRY_BACKOFF_MS) << std::min(attempt, 16));
+    std::uniform_int_distribution<long> distribution(ceiling/2, ceiling);
+    std::this_thread::sleep_for(std::chrono::milliseconds(distribution(generator)));
+}
+
+void BulkIndexer::Batch::Add(const Batch& batch, size_t item)
+{
+    size_t end = (item+1 < batch.offsets.size()) ? batch.offsets[item+1] : batch.payload.length();
+    offsets.push_back(payload.length());
+    payload.append(batch.payload, batch.offsets[item], end-batch.offsets[item]);
+    ids.push_back(batch.ids[item]);
+}
@@ -0,0 +1,135 @@
+#ifndef _BULK_INDEXER_H_
+#define _BULK_INDEXER_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "http/http.h"
+
+#include "bounded_queue.h"
+#include "import_metrics.h"
+
+#define DEFAULT_BULK_DOCUMENTS       (1000)
+#define DEFAULT_BULK_BYTES           (5*1024*1024)
+#define DEFAULT_BULK_SENDERS         (2)
+#define DEFAULT_QUEUE_SIZE           (64)
+#define DEFAULT_BULK_RETRIES         (5)
+#define DEFAULT_BULK_LATENCY_MS      (2000) //Batches that take longer shrink the next ones
+#define DEFAULT_IN_FLIGHT_BYTES      (64*1024*1024)
+
+#define MIN_BULK_DOCUMENTS           (10)
+#define MIN_BULK_BYTES               (64*1024)
+#define RETRY_BACKOFF_MS             (100)
+#define MAX_RETRY_BACKOFF_MS         (10000)
+
+
+// Collects index, update and delete actions into _bulk NDJSON batches for one
+// index, and sends them from a pool of sender threads while the callers keep
+// producing documents. Index(), Update() and Delete() may be called from
+// several threads.
+//
+// Batch sizes adapt to the cluster (AIMD): they are halved when Elasticsearch
+// rejects work (429, es_rejected_execution_exception) or answers slower than
+// the latency target, and grow back by a tenth of the configured maximum per
+// quick answer. Rejected and unreachable requests, and rejected items, are
+// retried with jittered exponential backoff. Callers block while the queued
+// and unacknowledged batches hold more than the in-flight byte cap.
+//
+// With an output directory, batches are written there as numbered NDJSON
+// shards instead, each one the exact body of a _bulk request. Replay() sends
+// such a shard later as one request, with the same retries.
+//
+// An acknowledge callback hears about every document once it is indexed, or
+// has failed for good. It is called from the sender threads.
+class BulkIndexer
+{
+public:
+    typedef std::function<void(const std::string& id, bool indexed)> AcknowledgeCallback;
+
+public:
+    BulkIndexer(const std::string& es_location, const std::string& index, size_t max_batch_documents, size_t max_batch_bytes,
+                int sender_count=DEFAULT_BULK_SENDERS, size_t queue_size=DEFAULT_QUEUE_SIZE, ImportMetrics* metrics=NULL);
+    ~BulkIndexer();
+
+public:
+    // Call before the first Index() or Delete()
+    void SetRetries(int max_retries) {m_max_retries = max_retries;}
+    void SetLatencyTarget(long milliseconds) {m_latency_target_seconds = milliseconds/1000.0;}
+    void SetMaxInFlightBytes(size_t bytes) {m_max_in_flight_bytes = bytes;}
+    void SetOutputDirectory(const std::string& directory) {m_output_directory = directory;}
+    void SetAcknowledgeCallback(const AcknowledgeCallback& callback) {m_acknowledge = callback;}
+
+    void Index(const std::string& id, const std::string& document);
+    void Update(const std::string& id, const std::string& update); //{"doc": <partial document>}
+    void Delete(const std::string& id);
+    bool Replay(const std::string& payload); //False if it is not a _bulk body. Does not wait, like Index()
+    void Flush(); //Sends the pending batch and waits until everything queued is acknowledged or has failed for good
+
+    long GetIndexedCount() const;
+    long GetFailedCount() const;
+    long GetRetriedCount() const;
+    long GetShardCount() const;
+    size_t GetBatchDocuments() const; //The current, adapted batch size
+    const std::vector<std::string>& GetFailedIds() const {return m_failed_ids;} //Only stable after Flush()
+
+private:
+    struct Batch
+    {
+        std::string payload;
+        std::vector<std::string> ids;
+        std::vector<size_t> offsets; //Where each action starts in payload, so rejected ones can be sent again
+
+        void Add(const Batch& batch, size_t item);
+    };
+
+    void AddAction(const std::string& id, const std::string& action, const std::string* document);
+    void QueueBatch(Batch* batch);
+    void SenderThread();
+    void SendBatch(HTTP& http, Batch& batch);
+    void WriteBatch(const Batch& batch);
+    unsigned int PostBatch(HTTP& http, const Batch& batch, Json::Object& result, double& seconds);
+    void ProcessBulkResponse(const Batch& batch, const Json::Object& result, Batch* retry_batch);
+    void AdaptBatchSize(bool overloaded);
+    void ReportFailure(const std::string& id, const std::string& reason);
+    void Acknowledge(const Batch& batch, const std::vector<bool>& indexed);
+
+    static bool IsRetryableStatus(unsigned int status);
+    static void Backoff(int attempt);
+
+private:
+    std::string m_es_location;
+    std::string m_bulk_url;
+    size_t m_max_batch_documents;
+    size_t m_max_batch_bytes;
+    ImportMetrics* m_metrics; //Optional, gets the latency and size of every request
+    int m_max_retries;
+    double m_latency_target_seconds;
+    size_t m_max_in_flight_bytes;
+    std::string m_output_directory; //Empty when sending to Elasticsearch
+    AcknowledgeCallback m_acknowledge; //Optional
+
+    mutable std::mutex m_batch_mutex;
+    Batch* m_current_batch;
+    size_t m_batch_documents; //Adapted limits, guarded by m_batch_mutex
+    size_t m_batch_bytes;
+
+    BoundedQueue<Batch*> m_queue; //nullptr tells a sender thread to stop
+    std::vector<std::thread> m_sender_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_all_sent;
+    std::condition_variable m_in_flight_space;
+    long m_pending_batches;
+    size_t m_in_flight_bytes;
+    long m_indexed_count;
+    long m_failed_count;
+    long m_retried_count;
+    long m_shard_count;
+    std::vector<std::string> m_failed_ids;
+};
+
+#endif // _BULK_INDEXER_H_
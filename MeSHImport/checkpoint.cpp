@@ -0,0 +1,188 @@
+#include "checkpoint.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+Checkpoint::Checkpoint()
+: m_saved(std::chrono::steady_clock::now())
+{
+}
+
+bool Checkpoint::Load(const char* filename)
+{
+    m_files.clear();
+    m_pending.clear();
+    m_sent.clear();
+
+    FILE* file = fopen(filename, "r");
+    if (!file)
+        return false;
+
+    bool ok = true;
+    char line[4096];
+    while (ok && fgets(line, sizeof(line), file))
+    {
+        size_t length = strlen(line);
+        if (0<length && '\n'==line[length-1])
+        {
+            line[--length] = '\0';
+        }
+
+        char value[256];
+        char language_code[16];
+        int filename_start = 0;
+        FileProgress progress;
+        if (1 == sscanf(line, "index %255s", value))
+        {
+            m_index_name = value;
+        }
+        else if (5==sscanf(line, "file %ld %ld %ld %15s %255s %n", &progress.records, &progress.offset, &progress.size, language_code, value, &filename_start) &&
+                 0<filename_start && '\0'!=line[filename_start])
+        {
+            progress.language_code = language_code;
+            progress.last_id = (0 == strcmp("-", value)) ? "" : value;
+            progress.filename = line+filename_start;
+            m_files.push_back(progress);
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+
+    ok = ok && feof(file) && !m_index_name.empty();
+    fclose(file);
+    m_pending.resize(m_files.size());
+    return ok;
+}
+
+bool Checkpoint::Save(const char* filename)
+{
+    std::vector<FileProgress> files;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        files = m_files;
+        m_saved = std::chrono::steady_clock::now();
+    }
+
+    //Written next to the old checkpoint and renamed, so a run killed while saving still leaves the previous one
+    std::string temporary_filename = std::string(filename) + ".tmp";
+    FILE* file = fopen(temporary_filename.c_str(), "w");
+    if (!file)
+        return false;
+
+    fprintf(file, "index %s\n", m_index_name.c_str());
+    std::vector<FileProgress>::const_iterator file_iterator = files.begin();
+    for (; file_iterator!=files.end(); ++file_iterator)
+    {
+        fprintf(file, "file %ld %ld %ld %s %s %s\n", file_iterator->records, file_iterator->offset, file_iterator->size,
+                file_iterator->language_code.empty() ? "-" : file_iterator->language_code.c_str(),
+                file_iterator->last_id.empty() ? "-" : file_iterator->last_id.c_str(), file_iterator->filename.c_str());
+    }
+
+    bool ok = (0 == fclose(file));
+    return ok && 0==rename(temporary_filename.c_str(), filename);
+}
+
+bool Checkpoint::SaveIfDue(const char* filename)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (std::chrono::steady_clock::now()-m_saved < std::chrono::seconds(CHECKPOINT_INTERVAL_SECONDS))
+            return true;
+        m_saved = std::chrono::steady_clock::now(); //Other readers need not try while this one saves
+    }
+    return Save(filename);
+}
+
+size_t Checkpoint::AddFile(const std::string& filename, long size)
+{
+    FileProgress progress;
+    progress.filename = filename;
+    progress.size = size;
+    m_files.push_back(progress);
+    m_pending.resize(m_files.size());
+    return m_files.size()-1;
+}
+
+void Checkpoint::SetLanguageCode(size_t file, const std::string& language_code)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_files[file].language_code = language_code;
+}
+
+void Checkpoint::Add(size_t file, long sequence, const std::string& id, long offset)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_files[file].stalled)
+        return;
+
+    Record record = {id, offset};
+    m_pending[file].records[sequence] = record;
+    m_sent.insert(std::make_pair(id, std::make_pair(file, sequence)));
+}
+
+void Checkpoint::Skip(size_t file, long sequence, long offset)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_files[file].stalled)
+        return;
+
+    Record record = {"", offset};
+    m_pending[file].records[sequence] = record;
+    Done(file, sequence);
+}
+
+void Checkpoint::Acknowledge(const std::string& id, bool indexed)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unordered_multimap<std::string, std::pair<size_t, long> >::iterator sent_iterator = m_sent.find(id);
+    if (m_sent.end() == sent_iterator) //Sent before the checkpoint knew about it, or a delete
+        return;
+
+    size_t file = sent_iterator->second.first;
+    long sequence = sent_iterator->second.second;
+    m_sent.erase(sent_iterator);
+
+    if (indexed)
+    {
+        Done(file, sequence);
+    }
+    else if (!m_files[file].stalled) //The next run has to start before this record
+    {
+        m_files[file].stalled = true;
+        m_pending[file].records.clear();
+        m_pending[file].done.clear();
+    }
+}
+
+void Checkpoint::Done(size_t file, long sequence)
+{
+    FileProgress& progress = m_files[file];
+    Pending& pending = m_pending[file];
+    if (progress.stalled)
+        return;
+
+    if (sequence != progress.records)
+    {
+        pending.done.insert(sequence);
+        return;
+    }
+
+    while (true)
+    {
+        std::unordered_map<long, Record>::iterator record_iterator = pending.records.find(progress.records);
+        if (!record_iterator->second.id.empty()) //Records without an id can not be found again, so they do not move the offset
+        {
+            progress.last_id = record_iterator->second.id;
+            progress.offset = record_iterator->second.offset;
+        }
+        pending.records.erase(record_iterator);
+        progress.records++;
+
+        if (pending.done.empty() || *pending.done.begin()!=progress.records)
+            break;
+        pending.done.erase(pending.done.begin());
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define CHECKPOINT_INTERVAL_SECONDS (5)
+#define RESYNC_MARGIN_BYTES         (64*1024) //Resume reads this far before the saved offset, past the reader's lookahead
+
+
+// Progress of a streamed import, saved now and then so an interrupted run can
+// continue after the records Elasticsearch has acknowledged instead of
+// starting over. Records are acknowledged out of order by the sender threads,
+// so for each file only the unbroken run of acknowledged records from its
+// start counts. A record that fails for good ends that run.
+//
+// Stored as an "index <name>" line and one line per input file:
+// "file <records> <offset> <size> <language> <last id> <filename>"
+class Checkpoint
+{
+public:
+    struct FileProgress
+    {
+        FileProgress() : records(0), offset(0), size(0), stalled(false) {}
+
+        long records; //Acknowledged from the start of the file, the next run starts after them
+        long offset; //Where the reader was when it reached the last of them, in uncompressed bytes
+        long size; //Of the file as stored, to refuse resuming with a different file. 0 if not known
+        std::string language_code;
+        std::string last_id; //Resuming skips records until it has seen this one
+        std::string filename;
+        bool stalled; //A record failed, so records does not grow any more
+    };
+
+public:
+    Checkpoint();
+
+public:
+    bool Load(const char* filename);
+    bool Save(const char* filename);
+    bool SaveIfDue(const char* filename); //At most every CHECKPOINT_INTERVAL_SECONDS, true if not due
+
+    void SetIndexName(const std::string& index_name) {m_index_name = index_name;}
+    const std::string& GetIndexName() const {return m_index_name;}
+    size_t AddFile(const std::string& filename, long size); //Returns the file's number, for a new import
+    FileProgress& GetFile(size_t file) {return m_files[file];}
+    size_t GetFileCount() const {return m_files.size();}
+    void SetLanguageCode(size_t file, const std::string& language_code);
+
+    // May be called from several threads. sequence counts records from the start of the file
+    void Add(size_t file, long sequence, const std::string& id, long offset); //Before the record is sent
+    void Skip(size_t file, long sequence, long offset); //The record is not sent, like one without an id
+    void Acknowledge(const std::string& id, bool indexed);
+
+private:
+    struct Record
+    {
+        std::string id;
+        long offset;
+    };
+
+    struct Pending
+    {
+        std::unordered_map<long, Record> records; //Sent or skipped, but not yet part of the acknowledged run
+        std::set<long> done; //Acknowledged out of order
+    };
+
+    void Done(size_t file, long sequence);
+
+private:
+    std::mutex m_mutex;
+    std::string m_index_name;
+    std::vector<FileProgress> m_files;
+    std::vector<Pending> m_pending; //Parallel to m_files
+    std::unordered_multimap<std::string, std::pair<size_t, long> > m_sent; //id -> file and sequence, until acknowledged
+    std::chrono::steady_clock::time_point m_saved;
+};
+
+#endif // _CHECKPOINT_H_
@@ -0,0 +1,353 @@
+#include "descriptor.h"
+
+#include <algorithm>
+
+#include "mesh_tree_path.h"
+
+
+static void WriteNames(JsonWriter& json, const std::vector<DescriptorName>& names)
+{
+    json.BeginArray();
+    std::vector<DescriptorName>::const_iterator name_iterator = names.begin();
+    for (; name_iterator!=names.end(); ++name_iterator)
+    {
+        json.BeginObject();
+        json.StringMember("id", name_iterator->id);
+        json.StringMember("nor_name", name_iterator->nor_name);
+        json.StringMember("eng_name", name_iterator->eng_name);
+        json.EndObject();
+    }
+    json.EndArray();
+}
+
+static void WriteChildSummaries(JsonWriter& json, const std::vector<DescriptorChild>& children)
+{
+    json.BeginArray();
+    std::vector<DescriptorChild>::const_iterator child_iterator = children.begin();
+    for (; child_iterator!=children.end(); ++child_iterator)
+    {
+        json.BeginObject();
+        json.StringMember("parent_tree_number", child_iterator->parent_tree_number);
+        json.StringMember("tree_number", child_iterator->tree_number);
+        json.StringMember("id", child_iterator->id);
+        json.StringMember("nor_name", child_iterator->nor_name);
+        json.StringMember("eng_name", child_iterator->eng_name);
+        json.Key("child_count");
+        json.Number(child_iterator->child_count);
+        json.Key("descendant_count");
+        json.Number(child_iterator->descendant_count);
+        json.EndObject();
+    }
+    json.EndArray();
+}
+
+static void WriteAncestors(JsonWriter& json, const std::vector<DescriptorAncestor>& ancestors)
+{
+    json.BeginArray();
+    std::vector<DescriptorAncestor>::const_iterator ancestor_iterator = ancestors.begin();
+    for (; ancestor_iterator!=ancestors.end(); ++ancestor_iterator)
+    {
+        json.BeginObject();
+        json.StringMember("tree_number", ancestor_iterator->tree_number);
+        json.StringMember("id", ancestor_iterator->id);
+        json.StringMember("nor_name", ancestor_iterator->nor_name);
+        json.StringMember("eng_name", ancestor_iterator->eng_name);
+        json.EndObject();
+    }
+    json.EndArray();
+}
+
+static void WriteTreePaths(JsonWriter& json, const std::vector<std::string>& tree_numbers, bool write_empty=false)
+//tree_paths and tree_depths are parallel, a malformed tree number is left out of both.
+//Paths are cheap to compute, so each array encodes them again instead of keeping them
+{
+    int64_t path;
+    int depth;
+    std::vector<std::string>::const_iterator tree_number_iterator = tree_numbers.begin();
+    while (tree_number_iterator!=tree_numbers.end() && !MeshTreePath(tree_number_iterator->c_str(), path, depth))
+    {
+        ++tree_number_iterator;
+    }
+    if (tree_number_iterator==tree_numbers.end() && !write_empty)
+        return;
+
+    const std::vector<std::string>::const_iterator first_iterator = tree_number_iterator;
+    json.Key("tree_paths");
+    json.BeginArray();
+    for (tree_number_iterator=first_iterator; tree_number_iterator!=tree_numbers.end(); ++tree_number_iterator)
+    {
+        if (MeshTreePath(tree_number_iterator->c_str(), path, depth))
+        {
+            json.Number(path);
+        }
+    }
+    json.EndArray();
+
+    json.Key("tree_depths");
+    json.BeginArray();
+    for (tree_number_iterator=first_iterator; tree_number_iterator!=tree_numbers.end(); ++tree_number_iterator)
+    {
+        if (MeshTreePath(tree_number_iterator->c_str(), path, depth))
+        {
+            json.Number(depth);
+        }
+    }
+    json.EndArray();
+
+    json.Key("tree_categories"); //Each letter once
+    json.BeginArray();
+    for (tree_number_iterator=first_iterator; tree_number_iterator!=tree_numbers.end(); ++tree_number_iterator)
+    {
+        std::vector<std::string>::const_iterator earlier_iterator = first_iterator;
+        while (earlier_iterator!=tree_number_iterator && (*earlier_iterator)[0]!=(*tree_number_iterator)[0])
+        {
+            ++earlier_iterator;
+        }
+        if (earlier_iterator==tree_number_iterator && MeshTreePath(tree_number_iterator->c_str(), path, depth))
+        {
+            json.String(tree_number_iterator->c_str(), 1);
+        }
+    }
+    json.EndArray();
+}
+
+void DescriptorToJson(const Descriptor& descriptor, JsonWriter& json)
+{
+    json.BeginObject();
+    json.StringMember("id", descriptor.id);
+    json.StringMember("nor_name", descriptor.nor_name);
+    json.StringMember("eng_name", descriptor.eng_name);
+    json.StringArrayMember("see_related", descriptor.see_related);
+    if (!descriptor.see_related_names.empty())
+    {
+        json.Key("see_related_names");
+        WriteNames(json, descriptor.see_related_names);
+    }
+    json.StringArrayMember("tree_numbers", descriptor.tree_numbers);
+    WriteTreePaths(json, descriptor.tree_numbers);
+    json.StringArrayMember("parent_tree_numbers", descriptor.parent_tree_numbers);
+    json.StringArrayMember("child_tree_numbers", descriptor.child_tree_numbers);
+    if (!descriptor.child_summaries.empty())
+    {
+        json.Key("child_summaries");
+        WriteChildSummaries(json, descriptor.child_summaries);
+    }
+    if (!descriptor.ancestors.empty())
+    {
+        json.Key("ancestors");
+        WriteAncestors(json, descriptor.ancestors);
+    }
+    if (descriptor.top_node)
+    {
+        json.Key("top_node");
+        json.String("yes", 3);
+    }
+    json.StringMember("eng_description", descriptor.eng_description);
+    json.StringMember("nor_description", descriptor.nor_description);
+    json.StringArrayMember("other_ids", descriptor.other_ids);
+
+    std::map<std::string, std::vector<std::string> >::const_iterator term_iterator = descriptor.term_texts.begin();
+    for (; term_iterator!=descriptor.term_texts.end(); ++term_iterator)
+    {
+        json.StringArrayMember(term_iterator->first, term_iterator->second);
+    }
+
+    std::map<std::string, std::string>::const_iterator translation_iterator = descriptor.translated_names.begin();
+    for (; translation_iterator!=descriptor.translated_names.end(); ++translation_iterator)
+    {
+        if (!translation_iterator->second.empty())
+        {
+            json.Key(translation_iterator->first, "_name");
+            json.String(translation_iterator->second);
+        }
+    }
+    translation_iterator = descriptor.translated_descriptions.begin();
+    for (; translation_iterator!=descriptor.translated_descriptions.end(); ++translation_iterator)
+    {
+        if (!translation_iterator->second.empty())
+        {
+            json.Key(translation_iterator->first, "_description");
+            json.String(translation_iterator->second);
+        }
+    }
+
+    if (descriptor.translated_names.empty())
+    {
+        json.StringMember("language_file", descriptor.language_file);
+    }
+    else //The base language first, then the translations
+    {
+        json.Key("language_file");
+        json.BeginArray();
+        json.String(descriptor.language_file);
+        for (translation_iterator=descriptor.translated_names.begin(); translation_iterator!=descriptor.translated_names.end(); ++translation_iterator)
+        {
+            json.String(translation_iterator->first);
+        }
+        json.EndArray();
+    }
+    json.EndObject();
+}
+
+static void AppendTerm(std::vector<DescriptorTerm>& terms, const std::string& text, const std::string& language, bool preferred)
+{
+    if (text.empty())
+        return;
+
+    std::vector<DescriptorTerm>::iterator term_iterator = terms.begin();
+    for (; term_iterator!=terms.end(); ++term_iterator)
+    {
+        if (*term_iterator->text==text && term_iterator->language==language)
+        {
+            term_iterator->preferred = term_iterator->preferred || preferred;
+            return;
+        }
+    }
+
+    DescriptorTerm term;
+    term.text = &text;
+    term.language = language;
+    term.preferred = preferred;
+    terms.push_back(term);
+}
+
+void CollectDescriptorTerms(const Descriptor& descriptor, std::vector<DescriptorTerm>& terms)
+{
+    terms.clear();
+    AppendTerm(terms, descriptor.nor_name, descriptor.language_file.empty() ? "nor" : descriptor.language_file, true); //The language of the file, as for its terms
+    AppendTerm(terms, descriptor.eng_name, "eng", true);
+    std::map<std::string, std::string>::const_iterator translation_iterator = descriptor.translated_names.begin();
+    for (; translation_iterator!=descriptor.translated_names.end(); ++translation_iterator)
+    {
+        AppendTerm(terms, translation_iterator->second, translation_iterator->first, true);
+    }
+
+    //Keyed by <language>_preferred_term_text or <language>_other_term_texts, see AddTermText
+    std::map<std::string, std::vector<std::string> >::const_iterator term_iterator = descriptor.term_texts.begin();
+    for (; term_iterator!=descriptor.term_texts.end(); ++term_iterator)
+    {
+        size_t separator = term_iterator->first.find('_');
+        const std::string language = term_iterator->first.substr(0, separator);
+        bool preferred = (std::string::npos != term_iterator->first.find("_preferred_", separator));
+        std::vector<std::string>::const_iterator text_iterator = term_iterator->second.begin();
+        for (; text_iterator!=term_iterator->second.end(); ++text_iterator)
+        {
+            AppendTerm(terms, *text_iterator, language, preferred);
+        }
+    }
+}
+
+void DescriptorTermToJson(const Descriptor& descriptor, const DescriptorTerm& term, long rank, JsonWriter& json)
+{
+    json.BeginObject();
+    json.StringMember("id", descriptor.id);
+    json.Key("term");
+    json.String(*term.text);
+    json.Key("language");
+    json.String(term.language);
+    if (term.preferred)
+    {
+        json.Key("preferred");
+        json.String("yes", 3);
+    }
+    json.Key("rank");
+    json.Number(rank);
+    json.StringMember("nor_name", descriptor.nor_name);
+    json.StringMember("eng_name", descriptor.eng_name);
+    json.StringArrayMember("other_ids", descriptor.other_ids);
+    json.StringArrayMember("tree_numbers", descriptor.tree_numbers);
+    WriteTreePaths(json, descriptor.tree_numbers);
+    json.EndObject();
+}
+
+void DescriptorHierarchyToJson(const Descriptor& descriptor, JsonWriter& json)
+{
+    json.BeginObject();
+    json.Key("parent_tree_numbers");
+    json.StringArray(descriptor.parent_tree_numbers);
+    json.Key("child_tree_numbers");
+    json.StringArray(descriptor.child_tree_numbers);
+    json.Key("child_summaries");
+    WriteChildSummaries(json, descriptor.child_summaries);
+    json.Key("ancestors");
+    WriteAncestors(json, descriptor.ancestors);
+    json.Key("see_related_names");
+    WriteNames(json, descriptor.see_related_names);
+    json.Key("top_node");
+    if (descriptor.top_node)
+    {
+        json.String("yes", 3);
+    }
+    else
+    {
+        json.Null();
+    }
+    WriteTreePaths(json, descriptor.tree_numbers, true);
+    json.EndObject();
+}
+
+void DescriptorTreeNumbersToJson(const Descriptor& descriptor, JsonWriter& json)
+{
+    json.BeginObject();
+    json.Key("tree_numbers");
+    json.StringArray(descriptor.tree_numbers);
+    WriteTreePaths(json, descriptor.tree_numbers, true);
+    json.EndObject();
+}
+
+bool TreePathsMatch(const std::vector<std::string>& tree_numbers, const std::vector<int64_t>& tree_paths, const std::vector<int>& tree_depths)
+{
+    size_t count = 0;
+    int64_t path;
+    int depth;
+    std::vector<std::string>::const_iterator tree_number_iterator = tree_numbers.begin();
+    for (; tree_number_iterator!=tree_numbers.end(); ++tree_number_iterator)
+    {
+        if (!MeshTreePath(tree_number_iterator->c_str(), path, depth))
+            continue; //Left out, like WriteTreePaths does
+
+        if (count>=tree_paths.size() || count>=tree_depths.size() || path!=tree_paths[count] || depth!=tree_depths[count])
+            return false;
+        count++;
+    }
+    return count==tree_paths.size() && count==tree_depths.size();
+}
+
+static void AppendMissing(std::vector<std::string>& values, const std::vector<std::string>& other_values)
+{
+    std::vector<std::string>::const_iterator value_iterator = other_values.begin();
+    for (; value_iterator!=other_values.end(); ++value_iterator)
+    {
+        if (values.end() == std::find(values.begin(), values.end(), *value_iterator))
+        {
+            values.push_back(*value_iterator);
+        }
+    }
+}
+
+void MergeTranslation(Descriptor& descriptor, Descriptor& translation)
+{
+    const std::string& language = translation.language_file;
+    if (language == descriptor.language_file)
+        return; //Nothing to add, and nor_ would clash with itself
+
+    if ("eng" != language) //An English file has nothing eng_name and eng_description do not already hold
+    {
+        descriptor.translated_names[language] = std::move(translation.nor_name);
+        if (!translation.nor_description.empty())
+        {
+            descriptor.translated_descriptions[language] = std::move(translation.nor_description);
+        }
+    }
+    if (descriptor.eng_description.empty())
+    {
+        descriptor.eng_description = std::move(translation.eng_description);
+    }
+
+    AppendMissing(descriptor.other_ids, translation.other_ids);
+    std::map<std::string, std::vector<std::string> >::const_iterator term_iterator = translation.term_texts.begin();
+    for (; term_iterator!=translation.term_texts.end(); ++term_iterator)
+    {
+        AppendMissing(descriptor.term_texts[term_iterator->first], term_iterator->second);
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef _DESCRIPTOR_H_
+#define _DESCRIPTOR_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "json_writer.h"
+
+
+// One step up the hierarchy from a descriptor, with enough to draw it
+struct DescriptorAncestor
+{
+    std::string tree_number;
+    std::string id;
+    std::string nor_name;
+    std::string eng_name;
+};
+
+// Another descriptor a descriptor links to, with the names to show for the link
+struct DescriptorName
+{
+    std::string id;
+    std::string nor_name;
+    std::string eng_name;
+};
+
+// A direct child of one of a descriptor's tree numbers, with what the hierarchy view shows of it
+struct DescriptorChild
+{
+    std::string parent_tree_number; //Which of the descriptor's tree numbers it is under
+    std::string tree_number;
+    std::string id;
+    std::string nor_name;
+    std::string eng_name;
+    long child_count;
+    long descendant_count;
+};
+
+// The parts of a DescriptorRecord we index, kept in memory until the whole
+// vocabulary is read and the hierarchy can be resolved.
+struct Descriptor
+{
+    Descriptor() : top_node(false) {}
+
+    std::string id;
+    std::string language_file; //LanguageCode of the file the nor_ fields come from
+    std::string nor_name;
+    std::string eng_name;
+    std::string nor_description;
+    std::string eng_description;
+    std::vector<std::string> other_ids;
+    std::vector<std::string> see_related;
+    std::vector<DescriptorName> see_related_names; //Parallel to see_related. Filled when the whole vocabulary is read
+    std::vector<std::string> tree_numbers;
+    std::vector<std::string> parent_tree_numbers;
+    std::vector<std::string> child_tree_numbers;
+    std::vector<DescriptorChild> child_summaries; //Parallel to child_tree_numbers
+    std::vector<DescriptorAncestor> ancestors; //Top-down for each tree number, each ancestor once. Filled when the hierarchy is known
+    std::vector<int64_t> tree_paths; //Only read back from the index by --rebuild-hierarchy. Written ones are encoded from tree_numbers
+    std::vector<int> tree_depths;
+    bool top_node;
+    std::map<std::string, std::vector<std::string> > term_texts; //Keyed by field name, e.g. "nor_preferred_term_text"
+    std::map<std::string, std::string> translated_names; //From the other language files, keyed by LanguageCode
+    std::map<std::string, std::string> translated_descriptions;
+};
+
+// A text a descriptor can be found by, for the mesh_terms suggestion index
+struct DescriptorTerm
+{
+    const std::string* text; //Points into the descriptor
+    std::string language; //"nor", "eng" or the LanguageCode of a translation
+    bool preferred; //A name or preferred term
+};
+
+void DescriptorToJson(const Descriptor& descriptor, JsonWriter& json);
+
+// The names and terms of a descriptor, each text once per language, and
+// preferred if it is a name or preferred term anywhere
+void CollectDescriptorTerms(const Descriptor& descriptor, std::vector<DescriptorTerm>& terms);
+
+// A mesh_terms document, with the names the suggestion list shows and the tree
+// numbers subtree filters need. rank is the static rank of the term, above 0
+void DescriptorTermToJson(const Descriptor& descriptor, const DescriptorTerm& term, long rank, JsonWriter& json);
+
+// The fields that follow from tree numbers and names of other descriptors, as
+// the doc of a partial update. Empty ones are written too, and a top_node that
+// no longer applies as null, so the update clears them
+void DescriptorHierarchyToJson(const Descriptor& descriptor, JsonWriter& json);
+
+// tree_numbers and the tree_paths, tree_depths and tree_categories encoded from
+// them, as the doc of a partial update of mesh_terms documents. Empty ones are
+// written too
+void DescriptorTreeNumbersToJson(const Descriptor& descriptor, JsonWriter& json);
+
+// Whether tree_paths and tree_depths are what the tree numbers encode to
+bool TreePathsMatch(const std::vector<std::string>& tree_numbers, const std::vector<int64_t>& tree_paths, const std::vector<int>& tree_depths);
+
+// Adds what a record from another language file knows about the same descriptor.
+// The translation's name and description become <LanguageCode>_name and
+// <LanguageCode>_description, terms and ids are added unless already there
+void MergeTranslation(Descriptor& descriptor, Descriptor& translation);
+
+#endif // _DESCRIPTOR_H_
@@ -0,0 +1,464 @@
+#include "descriptor_parser.h"
+
+#include <string.h>
+
+#include "tree_index.h"
+
+
+MeshElement GetMeshElement(const char* name, size_t length)
+{
+    //Length and the first one or two characters leave at most one candidate
+    const char* candidate;
+    MeshElement element;
+    switch (length)
+    {
+        case 4:  if ('T'==name[0]) {candidate = "Term"; element = MESH_ELEMENT_TERM;}
+                 else {candidate = "Note"; element = MESH_ELEMENT_NOTE;}
+                 break;
+        case 6:  if ('T'==name[0]) {candidate = "TermUI"; element = MESH_ELEMENT_TERM_UI;}
+                 else if ('t'==name[1]) {candidate = "String"; element = MESH_ELEMENT_STRING;}
+                 else {candidate = "Source"; element = MESH_ELEMENT_SOURCE;}
+                 break;
+        case 7:  candidate = "Concept"; element = MESH_ELEMENT_CONCEPT; break;
+        case 8:  candidate = "TermList"; element = MESH_ELEMENT_TERM_LIST; break;
+        case 9:  if ('C'==name[0]) {candidate = "ConceptUI"; element = MESH_ELEMENT_CONCEPT_UI;}
+                 else if ('S'==name[0]) {candidate = "ScopeNote"; element = MESH_ELEMENT_SCOPE_NOTE;}
+                 else {candidate = "Frequency"; element = MESH_ELEMENT_FREQUENCY;}
+                 break;
+        case 10: if ('T'==name[0]) {candidate = "TreeNumber"; element = MESH_ELEMENT_TREE_NUMBER;}
+                 else {candidate = "SourceList"; element = MESH_ELEMENT_SOURCE_LIST;}
+                 break;
+        case 11: if ('C'==name[0]) {candidate = "ConceptList"; element = MESH_ELEMENT_CONCEPT_LIST;}
+                 else {candidate = "QualifierUI"; element = MESH_ELEMENT_QUALIFIER_UI;}
+                 break;
+        case 12: candidate = "DescriptorUI"; element = MESH_ELEMENT_DESCRIPTOR_UI; break;
+        case 14: if ('D'==name[0]) {candidate = "DescriptorName"; element = MESH_ELEMENT_DESCRIPTOR_NAME;}
+                 else if ('S'==name[0]) {candidate = "SeeRelatedList"; element = MESH_ELEMENT_SEE_RELATED_LIST;}
+                 else if ('R'==name[0]) {candidate = "RegistryNumber"; element = MESH_ELEMENT_REGISTRY_NUMBER;}
+                 else {candidate = "TreeNumberList"; element = MESH_ELEMENT_TREE_NUMBER_LIST;}
+                 break;
+        case 15: if ('T'==name[0]) {candidate = "ThesaurusIDlist"; element = MESH_ELEMENT_THESAURUS_ID_LIST;}
+                 else {candidate = "HeadingMappedTo"; element = MESH_ELEMENT_HEADING_MAPPED_TO;}
+                 break;
+        case 18: candidate = "RegistryNumberList"; element = MESH_ELEMENT_REGISTRY_NUMBER_LIST; break;
+        case 19: if ('H'==name[0]) {candidate = "HeadingMappedToList"; element = MESH_ELEMENT_HEADING_MAPPED_TO_LIST;}
+                 else {candidate = "QualifierReferredTo"; element = MESH_ELEMENT_QUALIFIER_REFERRED_TO;}
+                 break;
+        case 20: if ('D'==name[0]) {candidate = "DescriptorReferredTo"; element = MESH_ELEMENT_DESCRIPTOR_REFERRED_TO;}
+                 else if ('T'==name[0]) {candidate = "TranslatorsScopeNote"; element = MESH_ELEMENT_TRANSLATORS_SCOPE_NOTE;}
+                 else if ('e'==name[1]) {candidate = "SeeRelatedDescriptor"; element = MESH_ELEMENT_SEE_RELATED_DESCRIPTOR;}
+                 else {candidate = "SupplementalRecordUI"; element = MESH_ELEMENT_SUPPLEMENTAL_RECORD_UI;}
+                 break;
+        case 21: candidate = "PharmacologicalAction"; element = MESH_ELEMENT_PHARMACOLOGICAL_ACTION; break;
+        case 22: candidate = "SupplementalRecordName"; element = MESH_ELEMENT_SUPPLEMENTAL_RECORD_NAME; break;
+        case 25: candidate = "PharmacologicalActionList"; element = MESH_ELEMENT_PHARMACOLOGICAL_ACTION_LIST; break;
+        default: return MESH_ELEMENT_OTHER;
+    }
+    return 0==memcmp(candidate, name, length) ? element : MESH_ELEMENT_OTHER;
+}
+
+MeshElement GetMeshElement(const xmlChar* name)
+{
+    return GetMeshElement(CONST_CHAR(name), xmlStrlen(name));
+}
+
+// ThesaurusID prefixes and their languages. THESAURUS_SLOTS below is built from
+// this list by the compiler, and the static_assert fails if a new prefix collides
+struct ThesaurusLanguage
+{
+    const char* thesaurus;
+    size_t length;
+    const char* language;
+};
+#define THESAURUS(thesaurus, language) {thesaurus, sizeof(thesaurus)-1, language}
+
+static constexpr ThesaurusLanguage THESAURUS_LANGUAGES[] = {
+    THESAURUS("AHCPR", "eng"), THESAURUS("AU", "eng"), THESAURUS("BAN", "eng"), THESAURUS("BIOETHICS", "eng"),
+    THESAURUS("CA", "eng"), THESAURUS("FDA SRS", "eng"), THESAURUS("FDA", "eng"), THESAURUS("GHR", "eng"), THESAURUS("IE", "eng"),
+    THESAURUS("INN", "eng"), THESAURUS("IOM", "eng"), THESAURUS("JAN", "eng"), THESAURUS("LCSH", "eng"),
+    THESAURUS("NLM", "eng"), THESAURUS("OMIM", "eng"), THESAURUS("ORD", "eng"), THESAURUS("POPLINE", "eng"),
+    THESAURUS("UK", "eng"), THESAURUS("UMLS", "eng"), THESAURUS("UNK", "eng"), THESAURUS("USAN", "eng"),
+    THESAURUS("USP", "eng"), THESAURUS("US", "eng"),
+    THESAURUS("nor", "nor"),
+    THESAURUS("DE", "ger"),
+    THESAURUS("ES", "spa"), THESAURUS("MX", "spa"),
+    THESAURUS("FR", "fre"),
+    THESAURUS("NL", "dut")
+};
+static constexpr size_t THESAURUS_COUNT = sizeof(THESAURUS_LANGUAGES)/sizeof(THESAURUS_LANGUAGES[0]);
+#define THESAURUS_SLOT_COUNT (64)
+
+static constexpr unsigned ThesaurusHash(const char* thesaurus, size_t length) //length>=2
+{
+    return (length*2 + static_cast<unsigned char>(thesaurus[0])*13 + static_cast<unsigned char>(thesaurus[1])*31) % THESAURUS_SLOT_COUNT;
+}
+
+static constexpr unsigned ThesaurusHash(size_t i)
+{
+    return ThesaurusHash(THESAURUS_LANGUAGES[i].thesaurus, THESAURUS_LANGUAGES[i].length);
+}
+
+static constexpr int FindThesaurusForSlot(unsigned slot, size_t i=0)
+{
+    return THESAURUS_COUNT==i ? -1 : (slot==ThesaurusHash(i) ? static_cast<int>(i) : FindThesaurusForSlot(slot, i+1));
+}
+
+static constexpr bool HasUniqueThesaurusHashes(size_t i=0, size_t j=1)
+{
+    return THESAURUS_COUNT<=i ? true :
+           THESAURUS_COUNT<=j ? HasUniqueThesaurusHashes(i+1, i+2) :
+           (ThesaurusHash(i)!=ThesaurusHash(j) && HasUniqueThesaurusHashes(i, j+1));
+}
+static_assert(HasUniqueThesaurusHashes(), "ThesaurusHash has collisions, pick new multipliers");
+
+#define THESAURUS_SLOTS_4(slot) FindThesaurusForSlot(slot), FindThesaurusForSlot(slot+1), FindThesaurusForSlot(slot+2), FindThesaurusForSlot(slot+3)
+#define THESAURUS_SLOTS_16(slot) THESAURUS_SLOTS_4(slot), THESAURUS_SLOTS_4(slot+4), THESAURUS_SLOTS_4(slot+8), THESAURUS_SLOTS_4(slot+12)
+static constexpr signed char THESAURUS_SLOTS[THESAURUS_SLOT_COUNT] = {
+    THESAURUS_SLOTS_16(0), THESAURUS_SLOTS_16(16), THESAURUS_SLOTS_16(32), THESAURUS_SLOTS_16(48)
+};
+
+bool GetThesaurusLanguage(const char* thesaurus_id, size_t length, std::string& language)
+{
+    //"NLM (1966)" and "FDA SRS (2014)" have the year in parentheses. Without them, the prefix ends at the first space, so "FDA SRS" is "FDA"
+    const char* end_ptr = static_cast<const char*>(memchr(thesaurus_id, '(', length));
+    if (!end_ptr) end_ptr = static_cast<const char*>(memchr(thesaurus_id, ' ', length));
+    while (end_ptr>thesaurus_id && ' '==*(end_ptr-1))
+        end_ptr--;
+
+    size_t prefix_length = (end_ptr ? end_ptr-thesaurus_id : length);
+    if (2 <= prefix_length)
+    {
+        int index = THESAURUS_SLOTS[ThesaurusHash(thesaurus_id, prefix_length)];
+        if (0<=index && prefix_length==THESAURUS_LANGUAGES[index].length &&
+            0==memcmp(THESAURUS_LANGUAGES[index].thesaurus, thesaurus_id, prefix_length))
+        {
+            language = THESAURUS_LANGUAGES[index].language;
+            return true;
+        }
+    }
+
+    language = "unknown";
+    return false;
+}
+
+bool GetThesaurusLanguage(const xmlChar* thesaurus_id, std::string& language)
+{
+    return GetThesaurusLanguage(CONST_CHAR(thesaurus_id), xmlStrlen(thesaurus_id), language);
+}
+
+const xmlChar* GetAttribute(const char* name, xmlNodePtr node_ptr)
+{
+    xmlAttrPtr attribute_ptr = node_ptr ? node_ptr->properties : NULL;
+    while (attribute_ptr)
+    {
+        if (0 == xmlStrcmp(BAD_CAST(name), attribute_ptr->name))
+        {
+            xmlNodePtr text_node_ptr = attribute_ptr->children;
+            if (XML_TEXT_NODE==text_node_ptr->type)
+            {
+                return text_node_ptr->content;
+            }
+        }
+        
+        attribute_ptr = attribute_ptr->next;
+    }
+    return NULL;
+}
+
+const xmlChar* GetText(xmlNodePtr text_ptr)
+{
+    xmlNodePtr text_node_ptr = text_ptr->children;
+    if (text_node_ptr && XML_TEXT_NODE==text_node_ptr->type)
+    {
+        return text_node_ptr->content;
+    }
+    return NULL;
+}
+
+const xmlChar* AddText(std::string& value, xmlNodePtr text_ptr)
+{
+    const xmlChar* text_str = GetText(text_ptr);
+    if (text_str)
+    {
+        value = CONST_CHAR(text_str);
+    }
+    return text_str;
+}
+
+void SetDescriptorName(Descriptor& descriptor, const xmlChar* name)
+{
+	const xmlChar* left_bracket = xmlStrchr(name, '[');
+	const xmlChar* right_bracket = left_bracket ? xmlStrchr(left_bracket, ']') : NULL;
+	if (left_bracket && right_bracket)
+	{
+		xmlChar* nor_value = xmlStrndup(name, left_bracket - name);
+		xmlChar* eng_value = xmlStrndup(left_bracket+1, right_bracket-(left_bracket+1));
+		if (0==xmlStrcasecmp(BAD_CAST("Not Translated"), nor_value))
+		{
+            descriptor.nor_name = CONST_CHAR(eng_value);
+		}
+		else
+        {
+            descriptor.nor_name = CONST_CHAR(nor_value);
+        }
+
+        descriptor.eng_name = CONST_CHAR(eng_value);
+        xmlFree(nor_value);
+        xmlFree(eng_value);
+	}
+	else
+	{
+		descriptor.nor_name = CONST_CHAR(name);
+		descriptor.eng_name = CONST_CHAR(name);
+	}
+}
+
+bool AddName(Descriptor& descriptor, xmlNodePtr descriptor_name_ptr)
+{
+	xmlNodePtr string_ptr = descriptor_name_ptr->children;
+	if (XML_ELEMENT_NODE==string_ptr->type && MESH_ELEMENT_STRING==GetMeshElement(string_ptr->name) && NULL!=string_ptr->children)
+	{
+		xmlNodePtr text_ptr = string_ptr->children;
+		if (XML_TEXT_NODE==text_ptr->type && NULL!=text_ptr->content)
+		{
+			SetDescriptorName(descriptor, text_ptr->content);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool GetLanguage(xmlNodePtr thesaurus_id_list_ptr, std::string& language)
+{
+    xmlNodePtr thesaurus_id_node_ptr = thesaurus_id_list_ptr->children;
+    if (XML_ELEMENT_NODE==thesaurus_id_node_ptr->type)
+    {
+        const xmlChar* thesaurus_id = GetText(thesaurus_id_node_ptr);
+        return GetThesaurusLanguage(thesaurus_id, language);
+    }
+    return false;
+}
+
+void ReadSeeRelatedList(Descriptor& descriptor, xmlNodePtr see_related_list_ptr)
+//<!ELEMENT SeeRelatedList (SeeRelatedDescriptor)+>
+{
+    xmlNodePtr see_related_descriptor_ptr = see_related_list_ptr->children;
+    while (NULL!=see_related_descriptor_ptr)
+    {
+        if (XML_ELEMENT_NODE==see_related_descriptor_ptr->type && MESH_ELEMENT_SEE_RELATED_DESCRIPTOR==GetMeshElement(see_related_descriptor_ptr->name) && NULL!=see_related_descriptor_ptr->children)
+        {
+            xmlNodePtr descriptor_referred_to_ptr = see_related_descriptor_ptr->children;
+			if (XML_ELEMENT_NODE==descriptor_referred_to_ptr->type && MESH_ELEMENT_DESCRIPTOR_REFERRED_TO==GetMeshElement(descriptor_referred_to_ptr->name) && NULL!=descriptor_referred_to_ptr->children)
+			{
+				xmlNodePtr child = descriptor_referred_to_ptr->children;
+				while (NULL!=child)
+				{
+					if (XML_ELEMENT_NODE == child->type && MESH_ELEMENT_DESCRIPTOR_UI==GetMeshElement(child->name))
+					{
+						xmlNodePtr descriptorUI_ptr = child->children;
+						if (XML_TEXT_NODE==descriptorUI_ptr->type && NULL!=descriptorUI_ptr->content)
+						{
+							descriptor.see_related.push_back(CONST_CHAR(descriptorUI_ptr->content));
+						}
+					}
+					child = child->next;
+				}
+			}
+		}
+		see_related_descriptor_ptr = see_related_descriptor_ptr->next;
+	}
+}
+
+void AddTreeNumber(Descriptor& descriptor, bool topnodes_forced, const std::string& tree_number)
+{
+    std::string parent_tree_number;
+    TreeIndex::GetParentTreeNumber(tree_number, topnodes_forced, parent_tree_number);
+    if (parent_tree_number.empty())
+    {
+        descriptor.top_node = true;
+    }
+    else
+    {
+        descriptor.parent_tree_numbers.push_back(parent_tree_number);
+    }
+    descriptor.tree_numbers.push_back(tree_number);
+}
+
+void ReadTreeNumberList(Descriptor& descriptor, bool topnodes_forced, xmlNodePtr tree_number_list_ptr)
+//<!ELEMENT TreeNumberList (TreeNumber)+>
+{
+    xmlNodePtr tree_number_ptr = tree_number_list_ptr->children;
+    while (NULL!=tree_number_ptr)
+    {
+        if (XML_ELEMENT_NODE==tree_number_ptr->type && MESH_ELEMENT_TREE_NUMBER==GetMeshElement(tree_number_ptr->name) && NULL!=tree_number_ptr->children)
+        {
+            xmlNodePtr text_ptr = tree_number_ptr->children;
+            if (XML_TEXT_NODE==text_ptr->type && NULL!=text_ptr->content)
+            {
+                AddTreeNumber(descriptor, topnodes_forced, CONST_CHAR(text_ptr->content));
+            }
+        }
+        
+        tree_number_ptr=tree_number_ptr->next;
+    }
+}
+
+bool AddTermText(Descriptor& descriptor, const std::string& language, bool preferred, const xmlChar* term_text)
+{
+    if (language.empty() || !term_text) {
+        return false;
+    }
+    
+    std::string key = language + std::string(preferred ? "_preferred_term_text" : "_other_term_texts");
+    descriptor.term_texts[key].push_back(CONST_CHAR(term_text));
+    return true;
+}
+
+bool AddOtherIds(Descriptor& descriptor, const xmlChar* id_text)
+{
+    if (!id_text) {
+        return false;
+    }
+    
+    descriptor.other_ids.push_back(CONST_CHAR(id_text));
+    return true;
+}
+
+void AddTerm(Descriptor& descriptor, bool preferred, std::string language, const xmlChar* term_text)
+{
+    //nor_name holds the translated name, in the language of the file
+    if (descriptor.nor_name == CONST_CHAR(term_text))
+    {
+        language = descriptor.language_file;
+    }
+    AddTermText(descriptor, language, preferred, term_text);
+
+    if (language==descriptor.language_file && "eng"!=language && descriptor.eng_name==CONST_CHAR(term_text))
+    {
+        AddTermText(descriptor, "eng", preferred, term_text);
+    }
+}
+
+void ReadTermList(Descriptor& descriptor, bool preferred_concept, xmlNodePtr term_list_ptr)
+//<!ELEMENT TermList (Term+)>
+{
+    xmlNodePtr term_ptr = term_list_ptr->children;
+    while (NULL!=term_ptr)
+    {
+        if (XML_ELEMENT_NODE==term_ptr->type && MESH_ELEMENT_TERM==GetMeshElement(term_ptr->name) && NULL!=term_ptr->children)
+        {
+            std::string language = "eng";
+            const xmlChar* term_text = NULL;
+            bool preferred_term = (0 == xmlStrcmp(BAD_CAST("Y"), GetAttribute("ConceptPreferredTermYN", term_ptr)));
+            
+            xmlNodePtr child = term_ptr->children;
+            while (NULL!=child)
+            {
+                if (XML_ELEMENT_NODE == child->type)
+                {
+                    switch (GetMeshElement(child->name))
+                    {
+                        case MESH_ELEMENT_STRING:            term_text = GetText(child); break;
+                        case MESH_ELEMENT_TERM_UI:           AddOtherIds(descriptor, GetText(child)); break;
+                        case MESH_ELEMENT_THESAURUS_ID_LIST: GetLanguage(child, language); break;
+                        default: break;
+                    }
+                }
+                child = child->next;
+            }
+
+            if (term_text)
+            {
+                AddTerm(descriptor, preferred_concept && preferred_term, language, term_text);
+            }
+        }
+        term_ptr=term_ptr->next;
+    }
+}
+
+void ReadConceptList(Descriptor& descriptor, xmlNodePtr concept_list_ptr)
+//<!ELEMENT ConceptList (Concept+)  >
+{
+    xmlNodePtr concept_ptr = concept_list_ptr->children;
+    while (NULL!=concept_ptr)
+    {
+        if (XML_ELEMENT_NODE==concept_ptr->type && MESH_ELEMENT_CONCEPT==GetMeshElement(concept_ptr->name) && NULL!=concept_ptr->children)
+        {
+            bool preferred_concept = (0 == xmlStrcmp(BAD_CAST("Y"), GetAttribute("PreferredConceptYN", concept_ptr)));
+
+            xmlNodePtr child = concept_ptr->children;
+            while (NULL!=child)
+            {
+                if (XML_ELEMENT_NODE == child->type)
+                {
+                    switch (GetMeshElement(child->name))
+                    {
+                        case MESH_ELEMENT_SCOPE_NOTE:
+                            if (preferred_concept) AddText(descriptor.eng_description, child);
+                            break;
+                        case MESH_ELEMENT_TRANSLATORS_SCOPE_NOTE:
+                            if (preferred_concept) AddText(descriptor.nor_description, child);
+                            break;
+                        case MESH_ELEMENT_TERM_LIST:
+                            ReadTermList(descriptor, preferred_concept, child);
+                            break;
+                        case MESH_ELEMENT_CONCEPT_UI:
+                            AddOtherIds(descriptor, GetText(child));
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                child = child->next;
+            }
+        }
+        concept_ptr=concept_ptr->next;
+    }
+}
+
+bool ProcessDescriptorRecord(xmlNodePtr descriptor_record_ptr, bool topnodes_forced, const std::string& language_code, Descriptor& descriptor)
+//<!ELEMENT DescriptorRecord (%DescriptorReference;,
+//                            DateCreated,
+//                            DateRevised?,
+//                            DateEstablished?,
+//                            ActiveMeSHYearList,
+//                            AllowableQualifiersList?,
+//                            Annotation?,
+//                            HistoryNote?,
+//                            OnlineNote?,
+//                            PublicMeSHNote?,
+//                            PreviousIndexingList?,
+//                            EntryCombinationList?,
+//                            SeeRelatedList?,
+//                            ConsiderAlso?,
+//                            PharmacologicalActionList?,
+//                            RunningHead?,
+//                            TreeNumberList?,
+//                            RecordOriginatorsList,
+//                            ConceptList) >
+//<!ATTLIST DescriptorRecord DescriptorClass (1 | 2 | 3 | 4)  "1">
+//<!ENTITY  % DescriptorReference "(DescriptorUI, DescriptorName)">
+{
+	descriptor.language_file = language_code;
+	const xmlChar* id = NULL;
+	xmlNodePtr child = descriptor_record_ptr->children;
+	while (NULL!=child)
+	{
+		if (XML_ELEMENT_NODE == child->type)
+		{
+			switch (GetMeshElement(child->name))
+			{
+				case MESH_ELEMENT_DESCRIPTOR_UI:     id = AddText(descriptor.id, child); break;
+				case MESH_ELEMENT_DESCRIPTOR_NAME:   AddName(descriptor, child); break;
+				case MESH_ELEMENT_SEE_RELATED_LIST:  ReadSeeRelatedList(descriptor, child); break;
+				case MESH_ELEMENT_TREE_NUMBER_LIST:  ReadTreeNumberList(descriptor, topnodes_forced, child); break;
+				case MESH_ELEMENT_CONCEPT_LIST:      ReadConceptList(descriptor, child); break;
+				default: break;
+			}
+		}
+		
+		child = child->next;
+	}
+
+    return NULL!=id;
+}
@@ -0,0 +1,68 @@
+#ifndef _DESCRIPTOR_PARSER_H_
+#define _DESCRIPTOR_PARSER_H_
+
+#include <libxml/xmlreader.h>
+
+#include "descriptor.h"
+
+#define CONST_CHAR(x) (reinterpret_cast<const char*>(x))
+
+
+// Elements the parsers look at. Everything else is MESH_ELEMENT_OTHER
+enum MeshElement
+{
+    MESH_ELEMENT_OTHER,
+    MESH_ELEMENT_CONCEPT,
+    MESH_ELEMENT_CONCEPT_LIST,
+    MESH_ELEMENT_CONCEPT_UI,
+    MESH_ELEMENT_DESCRIPTOR_NAME,
+    MESH_ELEMENT_DESCRIPTOR_REFERRED_TO,
+    MESH_ELEMENT_DESCRIPTOR_UI,
+    MESH_ELEMENT_FREQUENCY,
+    MESH_ELEMENT_HEADING_MAPPED_TO,
+    MESH_ELEMENT_HEADING_MAPPED_TO_LIST,
+    MESH_ELEMENT_NOTE,
+    MESH_ELEMENT_PHARMACOLOGICAL_ACTION,
+    MESH_ELEMENT_PHARMACOLOGICAL_ACTION_LIST,
+    MESH_ELEMENT_QUALIFIER_REFERRED_TO,
+    MESH_ELEMENT_QUALIFIER_UI,
+    MESH_ELEMENT_REGISTRY_NUMBER,
+    MESH_ELEMENT_REGISTRY_NUMBER_LIST,
+    MESH_ELEMENT_SCOPE_NOTE,
+    MESH_ELEMENT_SEE_RELATED_DESCRIPTOR,
+    MESH_ELEMENT_SEE_RELATED_LIST,
+    MESH_ELEMENT_SOURCE,
+    MESH_ELEMENT_SOURCE_LIST,
+    MESH_ELEMENT_STRING,
+    MESH_ELEMENT_SUPPLEMENTAL_RECORD_NAME,
+    MESH_ELEMENT_SUPPLEMENTAL_RECORD_UI,
+    MESH_ELEMENT_TERM,
+    MESH_ELEMENT_TERM_LIST,
+    MESH_ELEMENT_TERM_UI,
+    MESH_ELEMENT_THESAURUS_ID_LIST,
+    MESH_ELEMENT_TRANSLATORS_SCOPE_NOTE,
+    MESH_ELEMENT_TREE_NUMBER,
+    MESH_ELEMENT_TREE_NUMBER_LIST
+};
+
+// Building blocks shared with the memory-mapped parser, so both parsers
+// interpret names, tree numbers and terms the same way. The supplemental
+// record parser uses the element, thesaurus and text lookups
+MeshElement GetMeshElement(const char* name, size_t length); //One comparison, whatever the name
+MeshElement GetMeshElement(const xmlChar* name);
+bool GetThesaurusLanguage(const char* thesaurus_id, size_t length, std::string& language);
+bool GetThesaurusLanguage(const xmlChar* thesaurus_id, std::string& language);
+bool GetLanguage(xmlNodePtr thesaurus_id_list_ptr, std::string& language); //Of the first ThesaurusID
+const xmlChar* GetAttribute(const char* name, xmlNodePtr node_ptr);
+const xmlChar* GetText(xmlNodePtr text_ptr); //NULL for empty elements
+const xmlChar* AddText(std::string& value, xmlNodePtr text_ptr);
+void SetDescriptorName(Descriptor& descriptor, const xmlChar* name); //"nor name[eng name]"
+void AddTreeNumber(Descriptor& descriptor, bool topnodes_forced, const std::string& tree_number);
+void AddTerm(Descriptor& descriptor, bool preferred, std::string language, const xmlChar* term_text);
+
+// Converts an expanded DescriptorRecord subtree from a file with the given
+// LanguageCode. Only reads the subtree and the arguments, so several records
+// can be converted in parallel.
+bool ProcessDescriptorRecord(xmlNodePtr descriptor_record_ptr, bool topnodes_forced, const std::string& language_code, Descriptor& descriptor);
+
+#endif // _DESCRIPTOR_PARSER_H_
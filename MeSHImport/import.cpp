@@ -1,27 +1,105 @@
+#include <dirent.h>
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <libxml/xmlreader.h>
 #include <boost/concept_check.hpp>
 
-#include "elasticsearch/elasticsearch.h"
-
-#define CONST_CHAR(x) (reinterpret_cast<const char*>(x))
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
 
+#include "elasticsearch/elasticsearch.h"
 
-xmlTextReaderPtr g_reader;
-long g_filesize;
-ElasticSearch* g_es;
+#include "bounded_queue.h"
+#include "bulk_indexer.h"
+#include "checkpoint.h"
+#include "descriptor.h"
+#include "descriptor_parser.h"
+#include "import_metrics.h"
+#include "input_stream.h"
+#include "manifest.h"
+#include "mapped_file.h"
+#include "mesh_snapshot.h"
+#include "mmap_parser.h"
+#include "release_diff.h"
+#include "snapshot_writer.h"
+#include "supplemental_parser.h"
+#include "tree_index.h"
+#include "versioned_index.h"
+
+#define DESCRIPTOR_INDEX_NAME   "mesh"
+#define SUPPLEMENTAL_INDEX_NAME "mesh_scr"
+#define TERM_INDEX_NAME         "mesh_terms" //One small document per term, for MeSHWeb's suggestions
+#define EXPORT_INDEX_FILENAME "index" //Written last by --emit-ndjson, names the alias the shards belong to
+#define SHARD_SUFFIX          ".ndjson"
+#define TERM_EXPORT_DIRECTORY "terms" //Subdirectory of an export with the mesh_terms shards
+#define TERM_DELETE_IDS       (1000) //Descriptors per _delete_by_query when a delta import replaces their terms
+#define REBUILD_SCROLL_SIZE   (5000) //Hits per page and slice for --rebuild-hierarchy, which only reads names and tree numbers
+
+
+long g_total_filesize = 0; //Of all input files, 0 if one is not known, like for stdin
+std::atomic<long> g_read_records(0); //Over all input files, for the status line
+std::atomic<long> g_read_bytes(0);
+ElasticSearch* g_es = NULL; //Not created for --emit-ndjson, which never contacts Elasticsearch
+BulkIndexer* g_bulk_indexer;
+VersionedIndex* g_versioned_index = NULL; //Set for --clean
+VersionedIndex* g_term_index = NULL; //Set when the term index is built anew, which is all but delta imports
+BulkIndexer* g_term_indexer = NULL;
+bool g_update_terms = false; //A delta import replaces the terms of changed descriptors in the live term index
+std::vector<char> g_changed_descriptors; //Parallel to g_descriptors when g_update_terms is set
+std::string g_index_name = DESCRIPTOR_INDEX_NAME;
+int g_replicas = DEFAULT_REPLICAS;
+int g_keep_versions = DEFAULT_KEEP_VERSIONS;
 
 bool g_should_clean_database = false;
 bool g_should_read_topnodes_file = false;
-bool g_is_reading_topnodes_file = false;
-
-xmlChar* g_language_code = NULL;
+bool g_use_mapped_parser = false;
+bool g_import_supplemental = false; //SupplementalRecordSet files into their own index
+bool g_rebuild_hierarchy = false; //Reads the index instead of MeSH files
+const char* g_record_name = "descriptors"; //For the status output
 
 long g_total_descriptor_count = 0;
 long g_translated_descriptor_count = 0;
 
+int g_worker_count = 1;
+int g_sender_count = DEFAULT_BULK_SENDERS;
+long g_queue_size = DEFAULT_QUEUE_SIZE;
+long g_bulk_documents = DEFAULT_BULK_DOCUMENTS;
+long g_bulk_bytes = DEFAULT_BULK_BYTES;
+int g_bulk_retries = DEFAULT_BULK_RETRIES;
+long g_bulk_latency = DEFAULT_BULK_LATENCY_MS;
+long g_in_flight_bytes = DEFAULT_IN_FLIGHT_BYTES;
+
+std::vector<Descriptor> g_descriptors;
+std::unordered_map<std::string, size_t> g_descriptor_positions; //id -> index in g_descriptors
+TreeIndex g_tree_index;
+
+const char* g_manifest_filename = NULL; //Set for delta imports
+const char* g_snapshot_filename = NULL;
+const char* g_metrics_filename = NULL;
+const char* g_prometheus_filename = NULL;
+const char* g_failed_ids_filename = NULL;
+const char* g_export_directory = NULL; //--emit-ndjson
+const char* g_load_directory = NULL; //--load-ndjson
+const char* g_checkpoint_filename = NULL; //Set for supplemental imports that can be resumed
+const char* g_changelog_filename = NULL; //--diff
+bool g_resume = false;
+ImportMetrics g_metrics;
+Manifest g_previous_manifest;
+Checkpoint g_checkpoint;
+std::vector<uint64_t> g_document_hashes; //Parallel to g_descriptors
+
+
+void printFileStatistics(const char* filename, const std::string& language_code, long records)
+{
+    fprintf(stdout, "\nRead %ld %s from %s (%s)", records, g_record_name, filename, language_code.c_str());
+    fflush(stdout);
+}
 
 void printStatistics(long total, long translated)
 {
@@ -29,118 +107,208 @@ void printStatistics(long total, long translated)
     fflush(stdout);
 }
 
-void printDescriptorStatus(long descriptors)
+void printMergeStatistics(long merged)
 {
-	float progress = (float)xmlTextReaderByteConsumed(g_reader)/g_filesize*100.0;
-	fprintf(stdout, "Processed descriptors: %ld (%0.1f%%)\r", descriptors, progress);
-	fflush(stdout);
+    fprintf(stdout, "Merged descriptors: %ld\n\n", merged);
+    fflush(stdout);
 }
 
-void printUpdateHierarchyStatus(int current, int total)
+void printIndexingStatistics(long indexed, long failed, long retried)
 {
-    float progress = (float)current/total*100.0;
-    fprintf(stdout, "Updating hierarchy: %d  (%0.1f%%)\r", current, progress);
+    fprintf(stdout, "Indexed documents: %ld\nFailed documents: %ld\nRetried documents: %ld\n\n", indexed, failed, retried);
     fflush(stdout);
 }
 
-void printUpdateChildNumbers(int count, int updated_count)
+void printTermStatistics(long indexed, long failed)
 {
-    fprintf(stdout, "Updating child numbers: %d / %d\r", count, updated_count);
+    fprintf(stdout, "Indexed terms: %ld\nFailed terms: %ld\n\n", indexed, failed);
     fflush(stdout);
 }
 
-long ESSearch(const std::string& index, const std::string& query, Json::Object& search_result)
+void printDeltaStatistics(long unchanged, long deleted)
 {
-    try
+    fprintf(stdout, "Unchanged documents: %ld\nDeleted documents: %ld\n\n", unchanged, deleted);
+    fflush(stdout);
+}
+
+void printDescriptorStatus(long descriptors, long bytes_consumed)
+{
+    g_metrics.SampleProgress("parse", descriptors);
+    if (0 == g_total_filesize)
     {
-        return g_es->search(index, query, search_result);
+        fprintf(stdout, "Processed %s: %ld (%ld bytes read)\r", g_record_name, descriptors, bytes_consumed);
     }
-    catch(...)
+    else
     {
-        return 0L;
+        float progress = (float)bytes_consumed/g_total_filesize*100.0;
+        fprintf(stdout, "Processed %s: %ld (%0.1f%%)\r", g_record_name, descriptors, progress);
     }
+	fflush(stdout);
 }
 
-void CleanDatabase()
+void AddReadProgress(long records, long bytes)
 {
-    std::stringstream mapping;
+    //Files are read concurrently, so the status line counts all of them
+    printDescriptorStatus(g_read_records += records, g_read_bytes += bytes);
+}
+
+void printUpdateHierarchyStatus(int current, int total)
+{
+    float progress = (float)current/total*100.0;
+    fprintf(stdout, "Updating hierarchy: %d  (%0.1f%%)\r", current, progress);
+    fflush(stdout);
+}
+
+void printLoadStatus(long current, long total)
+{
+    float progress = (float)current/total*100.0;
+    fprintf(stdout, "Loading shards: %ld (%0.1f%%)\r", current, progress);
+    fflush(stdout);
+}
+
+void printIndexingStatus(long current, long total)
+{
+    g_metrics.SampleProgress("build", current);
+    float progress = (float)current/total*100.0;
+    fprintf(stdout, "Indexing descriptors: %ld (%0.1f%%)\r", current, progress);
+    fflush(stdout);
+}
+
+void AppendAnalysisSettings(std::stringstream& mapping)
+//The nor_ and eng_ analyzers, shared by the descriptor and supplemental record indices, and the ones for the
+//consolidated search fields: word prefixes for names, whole words for the other terms and lowercase ids
+{
+    mapping << "  \"analysis\": {"
+            << "   \"analyzer\": {"
+            << "    \"nor_analyzer\": {"
+            << "     \"type\": \"custom\","
+            << "     \"tokenizer\": \"ngram_tokenizer\","
+            << "     \"filter\": [\"lowercase\",\"norwegian_stop\",\"norwegian_stemmer\"]"
+            << "    },"
+            << "    \"eng_analyzer\": {"
+            << "     \"type\": \"custom\","
+            << "     \"tokenizer\": \"ngram_tokenizer\","
+            << "     \"filter\": [\"ext_asciifolding\",\"english_possessive_stemmer\",\"lowercase\",\"english_stop\",\"english_stemmer\"]"
+            << "    },"
+            << "    \"prefix_analyzer\": {"
+            << "     \"type\": \"custom\","
+            << "     \"tokenizer\": \"edge_ngram_tokenizer\","
+            << "     \"filter\": [\"lowercase\",\"ext_asciifolding\"]"
+            << "    },"
+            << "    \"prefix_search_analyzer\": {" //Whole words, cut to the longest prefix prefix_analyzer indexes
+            << "     \"type\": \"custom\","
+            << "     \"tokenizer\": \"standard\","
+            << "     \"filter\": [\"lowercase\",\"ext_asciifolding\",\"prefix_truncate\"]"
+            << "    },"
+            << "    \"word_analyzer\": {"
+            << "     \"type\": \"custom\","
+            << "     \"tokenizer\": \"standard\","
+            << "     \"filter\": [\"lowercase\",\"ext_asciifolding\"]"
+            << "    }"
+            << "   },"
+            << "   \"normalizer\": {"
+            << "    \"id_normalizer\": {"
+            << "     \"type\": \"custom\","
+            << "     \"filter\": [\"lowercase\"]"
+            << "    }"
+            << "   },"
+            << "   \"tokenizer\": {"
+            << "    \"ngram_tokenizer\": {"
+            << "     \"type\": \"ngram\","
+            << "     \"min_gram\": 3,"
+            << "     \"max_gram\": 3,"
+            << "     \"token_chars\": [\"letter\",\"digit\"]"
+            << "    },"
+            << "    \"edge_ngram_tokenizer\": {"
+            << "     \"type\": \"edge_ngram\","
+            << "     \"min_gram\": 2,"
+            << "     \"max_gram\": 20," //As prefix_truncate
+            << "     \"token_chars\": [\"letter\",\"digit\"]"
+            << "    }"
+            << "   },"
+            << "   \"filter\": {"
+            << "    \"prefix_truncate\": {"
+            << "     \"type\": \"truncate\","
+            << "     \"length\": 20"
+            << "    },"
+            << "    \"ext_asciifolding\": {"
+            << "     \"type\": \"asciifolding\","
+            << "     \"preserve_original\": true"
+            << "    },"
+            << "    \"english_stop\": {"
+            << "     \"type\":       \"stop\","
+            << "     \"stopwords\":  \"_english_\""
+            << "    },"
+            << "    \"english_stemmer\": {"
+            << "     \"type\":       \"stemmer\","
+            << "     \"language\":   \"english\""
+            << "    },"
+            << "    \"english_possessive_stemmer\": {"
+            << "     \"type\":       \"stemmer\","
+            << "     \"language\":   \"possessive_english\""
+            << "    },"
+            << "    \"norwegian_stop\": {"
+            << "     \"type\":       \"stop\","
+            << "     \"stopwords\":  \"_norwegian_\""
+            << "    },"
+            << "    \"norwegian_stemmer\": {"
+            << "     \"type\":       \"stemmer\","
+            << "     \"language\":   \"norwegian\""
+            << "    }"
+            << "   }"
+            << "  }";
+}
 
-    g_es->deleteIndex("mesh");
+bool CleanDatabase()
+{
+    std::stringstream mapping;
 
   mapping << "{"
           << " \"settings\": {"
-          << "  \"analysis\": {"
-          << "   \"analyzer\": {"
-          << "    \"nor_analyzer\": {"
-          << "     \"type\": \"custom\","
-          << "     \"tokenizer\": \"ngram_tokenizer\","
-          << "     \"filter\": [\"lowercase\",\"norwegian_stop\",\"norwegian_stemmer\"]"
-          << "    },"
-          << "    \"eng_analyzer\": {"
-          << "     \"type\": \"custom\","
-          << "     \"tokenizer\": \"ngram_tokenizer\","
-          << "     \"filter\": [\"ext_asciifolding\",\"english_possessive_stemmer\",\"lowercase\",\"english_stop\",\"english_stemmer\"]"
-          << "    }"
-          << "   },"
-          << "   \"tokenizer\": {"
-          << "    \"ngram_tokenizer\": {"
-          << "     \"type\": \"ngram\","
-          << "     \"min_gram\": 3,"
-          << "     \"max_gram\": 3,"
-          << "     \"token_chars\": [\"letter\",\"digit\"]"
-          << "    }"
-          << "   },"
-          << "   \"filter\": {"
-          << "    \"ext_asciifolding\": {"
-          << "     \"type\": \"asciifolding\","
-          << "     \"preserve_original\": true"
-          << "    },"
-          << "    \"english_stop\": {"
-          << "     \"type\":       \"stop\","
-          << "     \"stopwords\":  \"_english_\""
-          << "    },"
-          << "    \"english_stemmer\": {"
-          << "     \"type\":       \"stemmer\","
-          << "     \"language\":   \"english\""
-          << "    },"
-          << "    \"english_possessive_stemmer\": {"
-          << "     \"type\":       \"stemmer\","
-          << "     \"language\":   \"possessive_english\""
-          << "    },"
-          << "    \"norwegian_stop\": {"
-          << "     \"type\":       \"stop\","
-          << "     \"stopwords\":  \"_norwegian_\""
-          << "    },"
-          << "    \"norwegian_stemmer\": {"
-          << "     \"type\":       \"stemmer\","
-          << "     \"language\":   \"norwegian\""
-          << "    }"
-          << "   }"
-          << "  }"
-          << " },"
-          << " \"mappings\": {"
-          << "  \"properties\": {"
-          << "   \"id\": {\"type\": \"keyword\"},"
-          << "   \"other_ids\": {\"type\": \"keyword\"},"
-          << "   \"language_file\": {\"type\": \"keyword\"},"
-          << "   \"top_node\": {\"type\": \"keyword\"},"
-          << "   \"eng_name\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\"},"
-          << "   \"eng_description\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\"},"
-          << "   \"eng_preferred_term_text\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\"},"
-          << "   \"eng_other_term_texts\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\"},"
-          << "   \"nor_name\": {\"type\": \"text\", \"analyzer\": \"nor_analyzer\"},"
-          << "   \"nor_description\": {\"type\": \"text\", \"analyzer\": \"nor_analyzer\"},"
-          << "   \"nor_preferred_term_text\": {\"type\": \"text\", \"analyzer\": \"nor_analyzer\"},"
-          << "   \"nor_other_term_texts\": {\"type\": \"text\", \"analyzer\": \"nor_analyzer\"},"
-          << "   \"see_related\": {\"type\": \"keyword\"},"
-          << "   \"tree_numbers\": {\"type\": \"keyword\"},"
-          << "   \"parent_tree_numbers\": {\"type\": \"keyword\"},"
-          << "   \"child_tree_numbers\": {\"type\": \"keyword\"}"
-          << "  }"
-          << " }"
-          << "}";
-
-    g_es->createIndex("mesh", mapping.str().c_str());
+          << "  \"index\": {" //Tuned for the import. VersionedIndex::Publish restores refresh and replicas
+          << "   \"number_of_replicas\": 0,"
+          << "   \"refresh_interval\": \"-1\","
+          << "   \"sort.field\": \"tree_numbers\","
+          << "   \"sort.order\": \"asc\","
+          << "   \"sort.mode\": \"min\""
+          << "  },";
+    AppendAnalysisSettings(mapping);
+    mapping << " },"
+            << " \"mappings\": {"
+            << "  \"properties\": {"
+            << "   \"id\": {\"type\": \"keyword\", \"copy_to\": \"ids_all\"},"
+            << "   \"other_ids\": {\"type\": \"keyword\", \"copy_to\": \"ids_all\"},"
+            << "   \"language_file\": {\"type\": \"keyword\"},"
+            << "   \"top_node\": {\"type\": \"keyword\"},"
+            << "   \"eng_name\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\", \"copy_to\": \"names_all\"},"
+            << "   \"eng_description\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\", \"copy_to\": \"terms_all\"},"
+            << "   \"eng_preferred_term_text\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\", \"copy_to\": \"names_all\"},"
+            << "   \"eng_other_term_texts\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\", \"copy_to\": \"terms_all\"},"
+            << "   \"nor_name\": {\"type\": \"text\", \"analyzer\": \"nor_analyzer\", \"copy_to\": \"names_all\"},"
+            << "   \"nor_description\": {\"type\": \"text\", \"analyzer\": \"nor_analyzer\", \"copy_to\": \"terms_all\"},"
+            << "   \"nor_preferred_term_text\": {\"type\": \"text\", \"analyzer\": \"nor_analyzer\", \"copy_to\": \"names_all\"},"
+            << "   \"nor_other_term_texts\": {\"type\": \"text\", \"analyzer\": \"nor_analyzer\", \"copy_to\": \"terms_all\"},"
+            << "   \"ids_all\": {\"type\": \"keyword\", \"normalizer\": \"id_normalizer\"}," //The consolidated fields the suggestion query searches
+            << "   \"names_all\": {\"type\": \"text\", \"analyzer\": \"prefix_analyzer\", \"search_analyzer\": \"prefix_search_analyzer\"},"
+            << "   \"terms_all\": {\"type\": \"text\", \"analyzer\": \"word_analyzer\"},"
+            << "   \"see_related\": {\"type\": \"keyword\"},"
+            << "   \"see_related_names\": {\"type\": \"object\", \"enabled\": false}," //Only for titling links, kept in _source
+            << "   \"tree_numbers\": {\"type\": \"keyword\", \"copy_to\": \"ids_all\"},"
+            << "   \"tree_paths\": {\"type\": \"long\"}," //mesh_tree_path.h, for subtree range filters and tree order
+            << "   \"tree_depths\": {\"type\": \"byte\"},"
+            << "   \"tree_categories\": {\"type\": \"keyword\"},"
+            << "   \"parent_tree_numbers\": {\"type\": \"keyword\"},"
+            << "   \"child_tree_numbers\": {\"type\": \"keyword\"},"
+            << "   \"child_summaries\": {\"type\": \"object\", \"enabled\": false}," //Only for drawing the hierarchy, kept in _source
+            << "   \"ancestors\": {\"type\": \"object\", \"enabled\": false}"
+            << "  }"
+            << " }"
+            << "}";
+
+    //Build next to the live index. Searches keep using it until the alias is swapped
+    if (!g_versioned_index->Create(mapping.str()))
+        return false;
+    g_index_name = g_versioned_index->GetName();
 
     g_es->deleteIndex("day_statistics");
 	mapping << "{"
@@ -163,643 +331,2184 @@ void CleanDatabase()
             << " }"
             << "}";
     g_es->createIndex("text_statistics", mapping.str().c_str());
+    return true;
+}
+
+bool CleanSupplementalDatabase()
+{
+    std::stringstream mapping;
+
+    mapping << "{"
+            << " \"settings\": {"
+            << "  \"index\": {" //Tuned for the import. VersionedIndex::Publish restores refresh and replicas
+            << "   \"number_of_replicas\": 0,"
+            << "   \"refresh_interval\": \"-1\""
+            << "  },";
+    AppendAnalysisSettings(mapping);
+    mapping << " },"
+            << " \"mappings\": {"
+            << "  \"properties\": {"
+            << "   \"id\": {\"type\": \"keyword\"},"
+            << "   \"other_ids\": {\"type\": \"keyword\"},"
+            << "   \"language_file\": {\"type\": \"keyword\"},"
+            << "   \"scr_class\": {\"type\": \"keyword\"},"
+            << "   \"frequency\": {\"type\": \"integer\"},"
+            << "   \"eng_name\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\"},"
+            << "   \"eng_description\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\"},"
+            << "   \"eng_preferred_term_text\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\"},"
+            << "   \"eng_other_term_texts\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\"},"
+            << "   \"heading_mapped_to\": {\"type\": \"keyword\"},"
+            << "   \"heading_mapped_to_names\": {\"type\": \"text\", \"analyzer\": \"eng_analyzer\"},"
+            << "   \"heading_mapped_to_qualifiers\": {\"type\": \"keyword\"},"
+            << "   \"pharmacological_actions\": {\"type\": \"keyword\"},"
+            << "   \"registry_numbers\": {\"type\": \"keyword\"},"
+            << "   \"sources\": {\"type\": \"keyword\"}"
+            << "  }"
+            << " }"
+            << "}";
+
+    if (!g_versioned_index->Create(mapping.str()))
+        return false;
+    g_index_name = g_versioned_index->GetName();
+    return true;
+}
+
+bool CleanTermDatabase()
+{
+    std::stringstream mapping;
+
+    mapping << "{"
+            << " \"settings\": {"
+            << "  \"index\": {" //Tuned for the import. VersionedIndex::Publish restores refresh and replicas
+            << "   \"number_of_replicas\": 0,"
+            << "   \"refresh_interval\": \"-1\""
+            << "  },";
+    AppendAnalysisSettings(mapping);
+    mapping << " },"
+            << " \"mappings\": {"
+            << "  \"properties\": {"
+            << "   \"id\": {\"type\": \"keyword\", \"copy_to\": \"ids_all\"}," //Of the descriptor, suggestions collapse on it
+            << "   \"term\": {\"type\": \"text\", \"analyzer\": \"prefix_analyzer\", \"search_analyzer\": \"prefix_search_analyzer\"},"
+            << "   \"language\": {\"type\": \"keyword\"},"
+            << "   \"preferred\": {\"type\": \"keyword\"},"
+            << "   \"rank\": {\"type\": \"rank_feature\"},"
+            << "   \"nor_name\": {\"type\": \"keyword\", \"index\": false, \"doc_values\": false}," //Only for showing the suggestion
+            << "   \"eng_name\": {\"type\": \"keyword\", \"index\": false, \"doc_values\": false},"
+            << "   \"other_ids\": {\"type\": \"keyword\", \"copy_to\": \"ids_all\"},"
+            << "   \"ids_all\": {\"type\": \"keyword\", \"normalizer\": \"id_normalizer\"},"
+            << "   \"tree_numbers\": {\"type\": \"keyword\", \"copy_to\": \"ids_all\"}," //The same subtree filters as in the mesh index work here
+            << "   \"tree_paths\": {\"type\": \"long\"},"
+            << "   \"tree_depths\": {\"type\": \"byte\"},"
+            << "   \"tree_categories\": {\"type\": \"keyword\"}"
+            << "  }"
+            << " }"
+            << "}";
+
+    return g_term_index->Create(mapping.str());
 }
 
-bool GetThesaurusLanguage(const xmlChar* thesaurus_id, std::string& language)
+// One input file. Files are read concurrently, each into its own context,
+// and merged by DescriptorUI when all of them are read
+struct ImportFile
+{
+    ImportFile() : filename(NULL), topnodes_forced(false), worker_count(1), reader(NULL), resume_position(0), input_offset(0),
+                   checkpoint_file(0), has_record_set(false), read_failed(false), record_count(0), release_runs(NULL) {}
+
+    const char* filename;
+    bool topnodes_forced;
+    int worker_count;
+
+    InputStream input;
+    xmlTextReaderPtr reader;
+    std::string resume_input; //When resuming, a made-up start of the file and the input from the first record on. Read before input
+    size_t resume_position;
+    long input_offset; //Added to what the reader consumed, for the offset in the whole file
+    size_t checkpoint_file;
+    std::string resume_id; //Records up to this one are already indexed
+
+    std::string language_code;
+    bool has_record_set;
+    bool read_failed; //Missing, not a descriptor file, or a compressed or piped input that ended early or was corrupt
+    long record_count;
+    std::vector<Descriptor> descriptors; //In file order. Supplemental records are indexed right away instead
+    ReleaseRuns* release_runs; //Set for --diff, which sorts descriptors into runs on disk instead of keeping them
+};
+
+struct DescriptorRecordWork
+{
+    long sequence;
+    xmlNodePtr descriptor_record_ptr; //Private copy of the expanded record, freed by the converter. NULL means stop
+};
+
+struct SupplementalRecordWork
 {
-    const xmlChar* end_ptr = xmlStrchr(thesaurus_id, '(');
-    if (!end_ptr) end_ptr = xmlStrchr(thesaurus_id, ' ');
-    while (end_ptr>thesaurus_id && ' '==*(end_ptr-1))
-        end_ptr--;
+    long sequence;
+    long offset; //Where the reader was when it reached the record, for the checkpoint
+    xmlNodePtr supplemental_record_ptr; //Private copy, freed by the converter. NULL means stop
+};
+
+typedef std::vector<std::pair<long, Descriptor> > ConvertedDescriptors;
 
-    int end_index = (end_ptr ? end_ptr-thesaurus_id : xmlStrlen(thesaurus_id));
-    
-    if (0 == xmlStrncmp(BAD_CAST("AHCPR"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("AU"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("BAN"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("BIOETHICS"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("CA"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("FDA SRS"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("GHR"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("IE"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("INN"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("IOM"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("JAN"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("LCSH"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("NLM"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("OMIM"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("ORD"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("POPLINE"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("UK"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("UMLS"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("UNK"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("USAN"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("USP"), thesaurus_id, end_index) ||
-        0 == xmlStrncmp(BAD_CAST("US"), thesaurus_id, end_index))
+void ConverterThread(BoundedQueue<DescriptorRecordWork>* queue, const ImportFile* file, ConvertedDescriptors* converted)
+{
+    DescriptorRecordWork work;
+    double convert_seconds = 0.0;
+    while (true)
     {
-        language = "eng";
-        return true;
+        queue->Pop(work);
+        if (!work.descriptor_record_ptr)
+            break;
+
+        ImportMetrics::Clock::time_point start = ImportMetrics::Clock::now(); //Time spent waiting for the reader is not converting
+        Descriptor descriptor;
+        if (ProcessDescriptorRecord(work.descriptor_record_ptr, file->topnodes_forced, file->language_code, descriptor))
+        {
+            if (file->release_runs)
+            {
+                file->release_runs->Add(descriptor); //A failed spill is seen when the runs are finished
+            }
+            else
+            {
+                converted->push_back(std::make_pair(work.sequence, std::move(descriptor)));
+            }
+        }
+        xmlFreeNode(work.descriptor_record_ptr);
+        convert_seconds += ImportMetrics::SecondsSince(start);
     }
-    else if (0 == xmlStrncmp(BAD_CAST("nor"), thesaurus_id, end_index))
+    g_metrics.AddWorkerTime("convert", convert_seconds);
+}
+
+void SupplementalConverterThread(BoundedQueue<SupplementalRecordWork>* queue, const ImportFile* file)
+{
+    SupplementalRecordWork work;
+    JsonWriter json; //Reused, so serializing a record does not allocate once the buffer has grown
+    double convert_seconds = 0.0;
+    double serialize_seconds = 0.0;
+    while (true)
     {
-        language = "nor";
-        return true;
+        queue->Pop(work);
+        if (!work.supplemental_record_ptr)
+            break;
+
+        ImportMetrics::Clock::time_point start = ImportMetrics::Clock::now();
+        SupplementalRecord record;
+        bool converted = ProcessSupplementalRecord(work.supplemental_record_ptr, file->language_code, record);
+        xmlFreeNode(work.supplemental_record_ptr);
+        convert_seconds += ImportMetrics::SecondsSince(start);
+        if (!converted)
+        {
+            if (g_checkpoint_filename)
+            {
+                g_checkpoint.Skip(file->checkpoint_file, work.sequence, work.offset);
+            }
+            continue;
+        }
+
+        start = ImportMetrics::Clock::now();
+        json.Clear();
+        SupplementalRecordToJson(record, json);
+        const std::string& document = json.GetDocument();
+        serialize_seconds += ImportMetrics::SecondsSince(start);
+
+        if (g_checkpoint_filename)
+        {
+            g_checkpoint.Add(file->checkpoint_file, work.sequence, record.id, work.offset); //Before it can be acknowledged
+        }
+        g_bulk_indexer->Index(record.id, document); //Blocks while too much is in flight, which holds the reader back too
     }
-    else if (0 == xmlStrncmp(BAD_CAST("DE"), thesaurus_id, end_index))
+    g_metrics.AddWorkerTime("convert", convert_seconds);
+    g_metrics.AddWorkerTime("serialize", serialize_seconds);
+}
+
+void AddDescriptor(Descriptor& descriptor, bool topnodes_forced)
+{
+    if (!descriptor.eng_name.empty())
     {
-        language = "ger";
-        return true;
+        g_translated_descriptor_count++;
     }
-    else if (0 == xmlStrncmp(BAD_CAST("ES"), thesaurus_id, end_index) ||
-             0 == xmlStrncmp(BAD_CAST("MX"), thesaurus_id, end_index))
+
+    std::string parent_tree_number;
+    std::vector<std::string>::const_iterator tree_number_iterator = descriptor.tree_numbers.begin();
+    for (; tree_number_iterator!=descriptor.tree_numbers.end(); ++tree_number_iterator)
     {
-        language = "spa";
-        return true;
+        TreeIndex::GetParentTreeNumber(*tree_number_iterator, topnodes_forced, parent_tree_number);
+        g_tree_index.Add(*tree_number_iterator, parent_tree_number, g_descriptors.size());
     }
-    else if (0 == xmlStrncmp(BAD_CAST("FR"), thesaurus_id, end_index))
+    g_descriptor_positions[descriptor.id] = g_descriptors.size();
+    g_descriptors.push_back(std::move(descriptor));
+}
+
+void OrderConvertedDescriptors(std::vector<ConvertedDescriptors>& converted, std::vector<Descriptor>& descriptors)
+{
+    //Workers finish records in any order. Keep file order, so imports stay reproducible
+    std::vector<std::pair<long, Descriptor*> > ordered;
+    std::vector<ConvertedDescriptors>::iterator worker_iterator = converted.begin();
+    for (; worker_iterator!=converted.end(); ++worker_iterator)
     {
-        language = "fre";
-        return true;
+        ConvertedDescriptors::iterator converted_iterator = worker_iterator->begin();
+        for (; converted_iterator!=worker_iterator->end(); ++converted_iterator)
+        {
+            ordered.push_back(std::make_pair(converted_iterator->first, &converted_iterator->second));
+        }
     }
-    else if (0 == xmlStrncmp(BAD_CAST("NL"), thesaurus_id, end_index))
+    std::sort(ordered.begin(), ordered.end());
+
+    descriptors.reserve(ordered.size());
+    std::vector<std::pair<long, Descriptor*> >::iterator ordered_iterator = ordered.begin();
+    for (; ordered_iterator!=ordered.end(); ++ordered_iterator)
     {
-        language = "dut";
-        return true;
+        descriptors.push_back(std::move(*ordered_iterator->second));
     }
-    else
+}
+
+void AddLanguageFiles(std::vector<ImportFile>& files)
+//The first file has the base records. The others add their translations by DescriptorUI, so each descriptor is indexed once
+{
+    const std::string& base_language = files.front().language_code;
+    std::unordered_map<std::string, size_t> positions;
+    std::vector<ImportFile>::iterator file_iterator = files.begin();
+    for (; file_iterator!=files.end(); ++file_iterator)
     {
-        language = "unknown";
+        g_descriptors.reserve(g_descriptors.size() + file_iterator->descriptors.size());
+        std::vector<Descriptor>::iterator descriptor_iterator = file_iterator->descriptors.begin();
+        for (; descriptor_iterator!=file_iterator->descriptors.end(); ++descriptor_iterator)
+        {
+            std::unordered_map<std::string, size_t>::const_iterator position = positions.find(descriptor_iterator->id);
+            if (positions.end() != position)
+            {
+                MergeTranslation(g_descriptors[position->second], *descriptor_iterator);
+                continue;
+            }
+
+            positions[descriptor_iterator->id] = g_descriptors.size();
+            if (descriptor_iterator->language_file == base_language)
+            {
+                AddDescriptor(*descriptor_iterator, file_iterator->topnodes_forced);
+            }
+            else //Only in a translation. The base language falls back to English, like "Not Translated" does
+            {
+                Descriptor descriptor = *descriptor_iterator;
+                descriptor.language_file = base_language;
+                descriptor.nor_name = descriptor.eng_name;
+                descriptor.nor_description.clear();
+                MergeTranslation(descriptor, *descriptor_iterator);
+                AddDescriptor(descriptor, file_iterator->topnodes_forced);
+            }
+        }
+        std::vector<Descriptor>().swap(file_iterator->descriptors);
     }
-    return false;
 }
 
-const xmlChar* GetAttribute(const char* name, xmlNodePtr node_ptr)
+void PopulateChildTreeNumbers(Descriptor& descriptor)
+//With a summary of each child, so expanding a node in the hierarchy is one small request
 {
-    xmlAttrPtr attribute_ptr = node_ptr ? node_ptr->properties : NULL;
-    while (attribute_ptr)
+    std::vector<std::string>::const_iterator tree_number_iterator = descriptor.tree_numbers.begin();
+    for (; tree_number_iterator!=descriptor.tree_numbers.end(); ++tree_number_iterator)
     {
-        if (0 == xmlStrcmp(BAD_CAST(name), attribute_ptr->name))
+        const std::vector<std::string>& children = g_tree_index.GetChildren(*tree_number_iterator);
+        descriptor.child_tree_numbers.insert(descriptor.child_tree_numbers.end(), children.begin(), children.end());
+
+        std::vector<std::string>::const_iterator child_iterator = children.begin();
+        for (; child_iterator!=children.end(); ++child_iterator)
         {
-            xmlNodePtr text_node_ptr = attribute_ptr->children;
-            if (XML_TEXT_NODE==text_node_ptr->type)
+            size_t child_index;
+            DescriptorChild child;
+            child.parent_tree_number = *tree_number_iterator;
+            child.tree_number = *child_iterator;
+            if (g_tree_index.FindDescriptor(*child_iterator, child_index))
             {
-                return text_node_ptr->content;
+                const Descriptor& child_descriptor = g_descriptors[child_index]; //Other serializer threads do not touch the names
+                child.id = child_descriptor.id;
+                child.nor_name = child_descriptor.nor_name;
+                child.eng_name = child_descriptor.eng_name;
             }
+            child.child_count = g_tree_index.GetChildren(*child_iterator).size();
+            child.descendant_count = g_tree_index.GetDescendantCount(*child_iterator);
+            descriptor.child_summaries.push_back(child);
         }
-        
-        attribute_ptr = attribute_ptr->next;
     }
-    return NULL;
 }
 
-const xmlChar* GetText(xmlNodePtr text_ptr)
+void PopulateAncestors(Descriptor& descriptor)
+//So a result page can draw the hierarchy above a descriptor without looking up every step
 {
-    xmlNodePtr text_node_ptr = text_ptr->children;
-    if (XML_TEXT_NODE==text_node_ptr->type)
+    std::vector<std::string> chain;
+    std::string parent_tree_number;
+    std::vector<std::string>::const_iterator tree_number_iterator = descriptor.tree_numbers.begin();
+    for (; tree_number_iterator!=descriptor.tree_numbers.end(); ++tree_number_iterator)
     {
-        return text_node_ptr->content;
+        chain.clear();
+        std::string tree_number = *tree_number_iterator;
+        while (true)
+        {
+            TreeIndex::GetParentTreeNumber(tree_number, g_should_read_topnodes_file, parent_tree_number);
+            if (parent_tree_number.empty() || parent_tree_number==tree_number) //A forced topnode is its own parent
+                break;
+            chain.push_back(parent_tree_number);
+            tree_number = parent_tree_number;
+        }
+
+        std::vector<std::string>::reverse_iterator chain_iterator = chain.rbegin();
+        for (; chain_iterator!=chain.rend(); ++chain_iterator)
+        {
+            size_t ancestor_index;
+            if (!g_tree_index.FindDescriptor(*chain_iterator, ancestor_index))
+                continue; //Not in the vocabulary, like a topnode without --topnodes
+
+            std::vector<DescriptorAncestor>::const_iterator ancestor_iterator = descriptor.ancestors.begin();
+            for (; ancestor_iterator!=descriptor.ancestors.end() && ancestor_iterator->tree_number!=*chain_iterator; ++ancestor_iterator);
+            if (ancestor_iterator != descriptor.ancestors.end()) //Shared with an earlier tree number
+                continue;
+
+            const Descriptor& ancestor = g_descriptors[ancestor_index]; //Other serializer threads do not touch the names
+            DescriptorAncestor step = {*chain_iterator, ancestor.id, ancestor.nor_name, ancestor.eng_name};
+            descriptor.ancestors.push_back(step);
+        }
     }
-    return NULL;
 }
 
-const xmlChar* AddText(Json::Object& json, const std::string& key, xmlNodePtr text_ptr)
+void PopulateSeeRelatedNames(Descriptor& descriptor)
+//So a result page can title its see related links without looking up each of them
 {
-    const xmlChar* text_str = GetText(text_ptr);
-    if (text_str)
+    std::vector<std::string>::const_iterator see_related_iterator = descriptor.see_related.begin();
+    for (; see_related_iterator!=descriptor.see_related.end(); ++see_related_iterator)
     {
-        json.addMemberByKey(key, CONST_CHAR(text_str));
+        DescriptorName related = {*see_related_iterator, "", ""};
+        std::unordered_map<std::string, size_t>::const_iterator position = g_descriptor_positions.find(*see_related_iterator);
+        if (g_descriptor_positions.end() != position) //Not found, the link is titled by its id
+        {
+            const Descriptor& related_descriptor = g_descriptors[position->second]; //Other serializer threads do not touch the names
+            related.nor_name = related_descriptor.nor_name;
+            related.eng_name = related_descriptor.eng_name;
+        }
+        descriptor.see_related_names.push_back(related);
     }
-    return text_str;
 }
 
-bool AddName(Json::Object& json, xmlNodePtr descriptor_name_ptr)
+long TermRank(const Descriptor& descriptor, bool preferred)
+//Broad descriptors first: one more for each doubling of the largest subtree under the descriptor, twice as much for names and preferred terms
 {
-	xmlNodePtr string_ptr = descriptor_name_ptr->children;
-	if (XML_ELEMENT_NODE==string_ptr->type && 0==xmlStrcmp(BAD_CAST("String"), string_ptr->name) && NULL!=string_ptr->children)
-	{
-		xmlNodePtr text_ptr = string_ptr->children;
-		if (XML_TEXT_NODE==text_ptr->type && NULL!=text_ptr->content)
-		{
-			const xmlChar* left_bracket = xmlStrchr(text_ptr->content, '[');
-			const xmlChar* right_bracket = left_bracket ? xmlStrchr(left_bracket, ']') : NULL;
-			if (left_bracket && right_bracket)
-			{
-				xmlChar* nor_value = xmlStrndup(text_ptr->content, left_bracket - text_ptr->content);
-				xmlChar* eng_value = xmlStrndup(left_bracket+1, right_bracket-(left_bracket+1));
-				if (0==xmlStrcasecmp(BAD_CAST("Not Translated"), nor_value))
-				{
-                    json.addMemberByKey("nor_name", CONST_CHAR(eng_value));
-				}
-				else
-                {
-                    json.addMemberByKey("nor_name", CONST_CHAR(nor_value));
-                }
+    long descendant_count = 0;
+    std::vector<std::string>::const_iterator tree_number_iterator = descriptor.tree_numbers.begin();
+    for (; tree_number_iterator!=descriptor.tree_numbers.end(); ++tree_number_iterator)
+    {
+        descendant_count = std::max(descendant_count, g_tree_index.GetDescendantCount(*tree_number_iterator));
+    }
 
-                json.addMemberByKey("eng_name", CONST_CHAR(eng_value));
-                xmlFree(nor_value);
-                xmlFree(eng_value);
-			}
-			else
-			{
-				json.addMemberByKey("nor_name", CONST_CHAR(text_ptr->content));
-				json.addMemberByKey("eng_name", CONST_CHAR(text_ptr->content));
-			}
-			return true;
-		}
-	}
-	return false;
+    long rank = 1;
+    for (; 0<descendant_count; descendant_count>>=1)
+    {
+        rank++;
+    }
+    return preferred ? 2*rank : rank;
 }
 
-bool GetLanguage(xmlNodePtr thesaurus_id_list_ptr, std::string& language)
+void IndexTerms(const Descriptor& descriptor, std::vector<DescriptorTerm>& terms, JsonWriter& json)
+//Term ids are only unique per build. A delta import deletes a descriptor's old terms first, as it may have fewer now
 {
-    xmlNodePtr thesaurus_id_node_ptr = thesaurus_id_list_ptr->children;
-    if (XML_ELEMENT_NODE==thesaurus_id_node_ptr->type)
+    CollectDescriptorTerms(descriptor, terms);
+    for (size_t i=0; i<terms.size(); i++)
     {
-        const xmlChar* thesaurus_id = GetText(thesaurus_id_node_ptr);
-        return GetThesaurusLanguage(thesaurus_id, language);
+        json.Clear();
+        DescriptorTermToJson(descriptor, terms[i], TermRank(descriptor, terms[i].preferred), json);
+        g_term_indexer->Index(descriptor.id + "_" + std::to_string(i), json.GetDocument());
     }
-    return false;
 }
 
-void ReadSeeRelatedList(Json::Object& json, xmlNodePtr see_related_list_ptr)
-//<!ELEMENT SeeRelatedList (SeeRelatedDescriptor)+>
+void SerializerThread(std::atomic<size_t>* next_descriptor, std::atomic<long>* count, std::atomic<long>* unchanged_count)
 {
-    Json::Array see_related_array;
-    xmlNodePtr see_related_descriptor_ptr = see_related_list_ptr->children;
-    while (NULL!=see_related_descriptor_ptr)
+    long total = g_descriptors.size();
+    JsonWriter json; //Reused, so serializing a descriptor does not allocate once the buffer has grown
+    JsonWriter term_json;
+    std::vector<DescriptorTerm> terms;
+    double serialize_seconds = 0.0;
+    size_t index;
+    while ((index = (*next_descriptor)++) < g_descriptors.size())
     {
-        if (XML_ELEMENT_NODE==see_related_descriptor_ptr->type && 0==xmlStrcmp(BAD_CAST("SeeRelatedDescriptor"), see_related_descriptor_ptr->name) && NULL!=see_related_descriptor_ptr->children)
+        ImportMetrics::Clock::time_point start = ImportMetrics::Clock::now();
+        Descriptor& descriptor = g_descriptors[index];
+        PopulateChildTreeNumbers(descriptor);
+        PopulateAncestors(descriptor);
+        PopulateSeeRelatedNames(descriptor);
+
+        json.Clear();
+        DescriptorToJson(descriptor, json);
+        const std::string& document = json.GetDocument();
+
+        bool changed = true;
+        if (g_manifest_filename)
         {
-            xmlNodePtr descriptor_referred_to_ptr = see_related_descriptor_ptr->children;
-			if (XML_ELEMENT_NODE==descriptor_referred_to_ptr->type && 0==xmlStrcmp(BAD_CAST("DescriptorReferredTo"), descriptor_referred_to_ptr->name) && NULL!=descriptor_referred_to_ptr->children)
-			{
-				xmlNodePtr child = descriptor_referred_to_ptr->children;
-				while (NULL!=child)
-				{
-					if (XML_ELEMENT_NODE == child->type && 0==xmlStrcmp(BAD_CAST("DescriptorUI"), child->name))
-					{
-						xmlNodePtr descriptorUI_ptr = child->children;
-						if (XML_TEXT_NODE==descriptorUI_ptr->type && NULL!=descriptorUI_ptr->content)
-						{
-							Json::Value descriptor_ui;
-							descriptor_ui.setString(CONST_CHAR(descriptorUI_ptr->content));
-							see_related_array.addElement(descriptor_ui);
-						}
-					}
-					child = child->next;
-				}
-			}
-		}
-		see_related_descriptor_ptr = see_related_descriptor_ptr->next;
-	}
+            //Parents, child summaries and ancestor and related names are part of the document, so neighbours of a moved descriptor,
+            //ancestors of one that is added or removed and descendants and relatives of a renamed one change too
+            uint64_t previous_hash;
+            g_document_hashes[index] = Manifest::Hash(document);
+            changed = !g_previous_manifest.Find(descriptor.id, previous_hash) || previous_hash!=g_document_hashes[index];
+        }
+        serialize_seconds += ImportMetrics::SecondsSince(start); //Index() may block on a full queue, which is Elasticsearch's time
 
-	if (!see_related_array.empty())
-	{
-		json.addMemberByKey("see_related", see_related_array);
-	}
+        if (changed)
+        {
+            g_bulk_indexer->Index(descriptor.id, document);
+        }
+        else
+        {
+            (*unchanged_count)++;
+        }
+        if (g_update_terms)
+        {
+            g_changed_descriptors[index] = changed; //Replaced when all deletes are known, see UpdateTerms
+        }
+        else if (g_term_indexer)
+        {
+            IndexTerms(descriptor, terms, term_json);
+        }
+
+        long current = ++(*count);
+        if (0==(current%100) || current==total)
+        {
+            printIndexingStatus(current, total);
+        }
+    }
+    g_metrics.AddWorkerTime("serialize", serialize_seconds);
 }
 
-void ReadTreeNumberList(Json::Object& json, xmlNodePtr tree_number_list_ptr)
-//<!ELEMENT TreeNumberList (TreeNumber)+>
+long DeleteRemovedDescriptors(Manifest& manifest, std::vector<std::string>& deleted_ids)
 {
-    Json::Array parent_tree_number_array;
-    Json::Array tree_number_array;
-    xmlNodePtr tree_number_ptr = tree_number_list_ptr->children;
-    bool top_node = false;
-    while (NULL!=tree_number_ptr)
+    for (size_t i=0; i<g_descriptors.size(); i++)
+    {
+        manifest.Set(g_descriptors[i].id, g_document_hashes[i]);
+    }
+
+    long deleted_count = 0;
+    uint64_t hash;
+    Manifest::Entries::const_iterator entry_iterator = g_previous_manifest.GetEntries().begin();
+    for (; entry_iterator!=g_previous_manifest.GetEntries().end(); ++entry_iterator)
     {
-        if (XML_ELEMENT_NODE==tree_number_ptr->type && 0==xmlStrcmp(BAD_CAST("TreeNumber"), tree_number_ptr->name) && NULL!=tree_number_ptr->children)
+        if (!manifest.Find(entry_iterator->first, hash))
         {
-            xmlNodePtr text_ptr = tree_number_ptr->children;
-            if (XML_TEXT_NODE==text_ptr->type && NULL!=text_ptr->content)
-            {
-                Json::Value tree_number;
-                tree_number.setString(CONST_CHAR(text_ptr->content));
-                tree_number_array.addElement(tree_number);
-                
-                const xmlChar* tmp = xmlStrchr(text_ptr->content, '.');
-                if (tmp)
-                {
-                    const xmlChar* end_parent;
-                    do {
-                        end_parent = tmp;
-                        tmp = xmlStrchr(tmp+1, '.');
-                    } while (tmp);
-                    
-                    Json::Value parent_tree_number;
-                    parent_tree_number.setString(std::string(CONST_CHAR(text_ptr->content), end_parent - text_ptr->content));
-                    parent_tree_number_array.addElement(parent_tree_number);
-                }
-                else
-                {
-                    if (g_should_read_topnodes_file && !g_is_reading_topnodes_file)
-                    {
-                        Json::Value parent_tree_number;
-                        parent_tree_number.setString(std::string(CONST_CHAR(text_ptr->content), 1));
-                        parent_tree_number_array.addElement(parent_tree_number);
-                    }
-                    else
-                    {
-                        top_node = true;
-                    }
-                }
-            }
+            g_bulk_indexer->Delete(entry_iterator->first);
+            deleted_ids.push_back(entry_iterator->first);
+            deleted_count++;
         }
-        
-        tree_number_ptr=tree_number_ptr->next;
     }
+    return deleted_count;
+}
 
-    if (!tree_number_array.empty())
+void SaveManifest(Manifest& manifest)
+{
+    //Leave failed documents out so the next run sends them again, and keep failed deletes so they are retried
+    uint64_t hash;
+    const std::vector<std::string>& failed_ids = g_bulk_indexer->GetFailedIds();
+    std::vector<std::string>::const_iterator id_iterator = failed_ids.begin();
+    for (; id_iterator!=failed_ids.end(); ++id_iterator)
     {
-        json.addMemberByKey("tree_numbers", tree_number_array);
+        if (manifest.Find(*id_iterator, hash))
+        {
+            manifest.Remove(*id_iterator);
+        }
+        else if (g_previous_manifest.Find(*id_iterator, hash))
+        {
+            manifest.Set(*id_iterator, hash);
+        }
     }
 
-    if (!parent_tree_number_array.empty())
+    //Descriptors with terms that failed are sent again by the next delta import, which replaces all their terms
+    if (g_update_terms)
     {
-        json.addMemberByKey("parent_tree_numbers", parent_tree_number_array);
+        const std::vector<std::string>& failed_term_ids = g_term_indexer->GetFailedIds();
+        for (id_iterator=failed_term_ids.begin(); id_iterator!=failed_term_ids.end(); ++id_iterator)
+        {
+            const std::string id = id_iterator->substr(0, id_iterator->rfind('_')); //<descriptor id>_<term>, see IndexTerms
+            if (manifest.Find(id, hash))
+            {
+                manifest.Remove(id);
+            }
+        }
     }
-    
-    if (top_node)
+
+    if (!manifest.Save(g_manifest_filename))
     {
-        json.addMemberByKey("top_node", CONST_CHAR("yes"));
+        fprintf(stderr, "Could not write manifest %s\n", g_manifest_filename);
     }
 }
 
-bool AddTermText(Json::Object& concept_json, const std::string& language, bool preferred, const xmlChar* term_text)
+void CreateBulkIndexer(const char* es_location)
 {
-    if (language.empty() || !term_text) {
-        return false;
+    g_bulk_indexer = new BulkIndexer(es_location, g_index_name, g_bulk_documents, g_bulk_bytes, g_sender_count, g_queue_size, &g_metrics);
+    g_bulk_indexer->SetRetries(g_bulk_retries);
+    g_bulk_indexer->SetLatencyTarget(g_bulk_latency);
+    g_bulk_indexer->SetMaxInFlightBytes(g_in_flight_bytes);
+    if (g_export_directory)
+    {
+        g_bulk_indexer->SetOutputDirectory(g_export_directory);
     }
-    
-    Json::Value term;
-    term.setString(Json::Value::escapeJsonString(CONST_CHAR(term_text)));
+}
 
-    std::string key = language + std::string(preferred ? "_preferred_term_text" : "_other_term_texts");
-    concept_json.appendArrayElement(key, term);
-    return true;
+std::string TermExportDirectory(const char* directory)
+{
+    return std::string(directory) + "/" TERM_EXPORT_DIRECTORY;
 }
 
-bool AddOtherIds(Json::Object& json, const xmlChar* id_text)
+bool TermIndexExists(const char* es_location)
 {
-    if (!id_text) {
+    HTTP http(es_location, false);
+    try
+    {
+        return 200 == http.head(TERM_INDEX_NAME, NULL, NULL);
+    }
+    catch(...)
+    {
         return false;
     }
-    
-    Json::Value id;
-    id.setString(Json::Value::escapeJsonString(CONST_CHAR(id_text)));
-
-    json.appendArrayElement("other_ids", id);
-    return true;
 }
 
-void ReadTermList(Json::Object& concept_json, bool preferred_concept, xmlNodePtr term_list_ptr)
-//<!ELEMENT TermList (Term+)>
+void CreateTermIndexer(const char* es_location, bool allow_update=true)
+//Exports write the terms to shards of their own, so --load-ndjson can send them to a term index. A delta import into
+//the live descriptor index updates the live term index, unless there is none yet
 {
-    std::string nor_name = "";
-    std::string eng_name = "";
-    if (concept_json.member("nor_name"))
+    std::string index_name = TERM_INDEX_NAME;
+    g_update_terms = allow_update && !g_export_directory && g_manifest_filename && !g_versioned_index && TermIndexExists(es_location);
+    if (g_update_terms)
     {
-        nor_name = concept_json["nor_name"].getString();
+        g_changed_descriptors.assign(g_descriptors.size(), 0);
     }
-    if (concept_json.member("eng_name"))
+    else if (!g_export_directory)
     {
-        eng_name = concept_json["eng_name"].getString();
+        g_term_index = new VersionedIndex(es_location, TERM_INDEX_NAME);
+        if (!CleanTermDatabase())
+        {
+            fprintf(stderr, "Could not create a new %s index, suggestions keep using the old one\n", TERM_INDEX_NAME);
+            delete g_term_index;
+            g_term_index = NULL;
+            return;
+        }
+        index_name = g_term_index->GetName();
     }
 
-    xmlNodePtr term_ptr = term_list_ptr->children;
-    while (NULL!=term_ptr)
+    //Not measured, the metrics describe the descriptor requests
+    g_term_indexer = new BulkIndexer(es_location, index_name, g_bulk_documents, g_bulk_bytes, g_sender_count, g_queue_size);
+    g_term_indexer->SetRetries(g_bulk_retries);
+    g_term_indexer->SetLatencyTarget(g_bulk_latency);
+    g_term_indexer->SetMaxInFlightBytes(g_in_flight_bytes);
+    if (g_export_directory)
     {
-        if (XML_ELEMENT_NODE==term_ptr->type && 0==xmlStrcmp(BAD_CAST("Term"), term_ptr->name) && NULL!=term_ptr->children)
-        {
-            std::string language = "eng";
-            const xmlChar* term_text = NULL;
-            bool preferred_term = (0 == xmlStrcmp(BAD_CAST("Y"), GetAttribute("ConceptPreferredTermYN", term_ptr)));
-            
-            xmlNodePtr child = term_ptr->children;
-            while (NULL!=child)
-            {
-                if (XML_ELEMENT_NODE == child->type)
-                {
-                    if (0==xmlStrcmp(BAD_CAST("String"), child->name))
-                    {
-                        term_text = GetText(child);
-                    }
-                    else if (0==xmlStrcmp(BAD_CAST("TermUI"), child->name))
-                    {
-                        AddOtherIds(concept_json, GetText(child));
-                    }
-                    else if (0==xmlStrcmp(BAD_CAST("ThesaurusIDlist"), child->name))
-                    {
-                        GetLanguage(child, language);
-                    }
-                }
-                child = child->next;
-            }
-
-            if (term_text)
-            {
-                if (nor_name == CONST_CHAR(term_text))
-                {
-                    language = "nor";
-                }
-                AddTermText(concept_json, language, preferred_concept && preferred_term, term_text);
-
-                if (language=="nor" && eng_name==CONST_CHAR(term_text))
-                {
-                    AddTermText(concept_json, "eng", preferred_concept && preferred_term, term_text);
-                }
+        g_term_indexer->SetOutputDirectory(TermExportDirectory(g_export_directory));
+    }
+}
 
-            }
+bool DeleteTerms(const char* es_location, const std::vector<std::string>& ids)
+{
+    HTTP http(es_location, true);
+    JsonWriter json;
+    for (size_t start=0; start<ids.size(); start+=TERM_DELETE_IDS)
+    {
+        json.Clear();
+        json.BeginObject();
+        json.Key("query");
+        json.BeginObject();
+        json.Key("terms");
+        json.BeginObject();
+        json.Key("id");
+        json.BeginArray();
+        for (size_t i=start; i<ids.size() && i<start+TERM_DELETE_IDS; i++)
+        {
+            json.String(ids[i]);
+        }
+        json.EndArray();
+        json.EndObject();
+        json.EndObject();
+        json.EndObject();
+
+        Json::Object result;
+        unsigned int status;
+        try
+        {
+            status = http.post(TERM_INDEX_NAME "/_delete_by_query?conflicts=proceed&refresh=true", json.GetDocument().c_str(), &result);
+        }
+        catch(...)
+        {
+            status = 0;
+        }
+        if (200!=status || (result.member("failures") && !result.getValue("failures").getArray().empty()))
+        {
+            fprintf(stderr, "\nDeleting terms from %s failed with HTTP status %u\n", TERM_INDEX_NAME, status);
+            return false;
         }
-        term_ptr=term_ptr->next;
     }
+    return true;
 }
 
-void ReadConceptList(Json::Object& json, xmlNodePtr concept_list_ptr)
-//<!ELEMENT ConceptList (Concept+)  >
+void UpdateTerms(const char* es_location, const std::vector<std::string>& deleted_ids)
+//The old terms of changed and removed descriptors are deleted before the new ones are added, so none of them is lost
 {
-    xmlNodePtr concept_ptr = concept_list_ptr->children;
-    while (NULL!=concept_ptr)
+    std::vector<std::string> ids = deleted_ids;
+    for (size_t i=0; i<g_descriptors.size(); i++)
     {
-        if (XML_ELEMENT_NODE==concept_ptr->type && 0==xmlStrcmp(BAD_CAST("Concept"), concept_ptr->name) && NULL!=concept_ptr->children)
+        if (g_changed_descriptors[i])
         {
-            bool preferred_concept = (0 == xmlStrcmp(BAD_CAST("Y"), GetAttribute("PreferredConceptYN", concept_ptr)));
-
-            xmlNodePtr child = concept_ptr->children;
-            while (NULL!=child)
-            {
-                if (XML_ELEMENT_NODE == child->type)
-                {
-                    if (preferred_concept)
-                    {
-                        if (0==xmlStrcmp(BAD_CAST("ScopeNote"), child->name))
-                        {
-                            AddText(json, "eng_description", child);
-                        }
-                        else if (0==xmlStrcmp(BAD_CAST("TranslatorsScopeNote"), child->name))
-                        {
-                            AddText(json, "nor_description", child);
-                        }
-                    }
-                    
-                    if (0==xmlStrcmp(BAD_CAST("TermList"), child->name))
-                    {
-                        ReadTermList(json, preferred_concept, child);
-                    }
-                    else if (0==xmlStrcmp(BAD_CAST("ConceptUI"), child->name))
-                    {
-                        AddOtherIds(json, GetText(child));
-                    }
-                }
-                child = child->next;
-            }
+            ids.push_back(g_descriptors[i].id);
         }
-        concept_ptr=concept_ptr->next;
-    }
-}
-
-bool ProcessDescriptorRecord(xmlNodePtr descriptor_record_ptr)
-//<!ELEMENT DescriptorRecord (%DescriptorReference;,
-//                            DateCreated,
-//                            DateRevised?,
-//                            DateEstablished?,
-//                            ActiveMeSHYearList,
-//                            AllowableQualifiersList?,
-//                            Annotation?,
-//                            HistoryNote?,
-//                            OnlineNote?,
-//                            PublicMeSHNote?,
-//                            PreviousIndexingList?,
-//                            EntryCombinationList?,
-//                            SeeRelatedList?,
-//                            ConsiderAlso?,
-//                            PharmacologicalActionList?,
-//                            RunningHead?,
-//                            TreeNumberList?,
-//                            RecordOriginatorsList,
-//                            ConceptList) >
-//<!ATTLIST DescriptorRecord DescriptorClass (1 | 2 | 3 | 4)  "1">
-//<!ENTITY  % DescriptorReference "(DescriptorUI, DescriptorName)">
-{
-    Json::Object json;
-	const xmlChar* id = NULL;
-	xmlNodePtr child = descriptor_record_ptr->children;
-	while (NULL!=child)
-	{
-		if (XML_ELEMENT_NODE == child->type)
-		{
-			if (0==xmlStrcmp(BAD_CAST("DescriptorUI"), child->name))
-			{
-				id = AddText(json, "id", child);
-			}
-			else if (0==xmlStrcmp(BAD_CAST("DescriptorName"), child->name))
-			{
-				AddName(json, child);
-			}
-			else if (0==xmlStrcmp(BAD_CAST("SeeRelatedList"), child->name))
-			{
-				ReadSeeRelatedList(json, child);
-			}
-			else if (0==xmlStrcmp(BAD_CAST("TreeNumberList"), child->name))
-			{
-				ReadTreeNumberList(json, child);
-			}
-			else if (0==xmlStrcmp(BAD_CAST("ConceptList"), child->name))
-			{
-                ReadConceptList(json, child);
-			}
-		}
-		
-		child = child->next;
-	}
-
-	if (id)
-	{
-        json.addMemberByKey("language_file", CONST_CHAR(g_language_code));
-		g_es->index("mesh", CONST_CHAR(id), json);
-	}
+    }
 
-    g_total_descriptor_count++;
-    if (json.member("eng_name"))
+    bool all_terms = !DeleteTerms(es_location, ids);
+    if (all_terms) //Which terms are left is not known, so start over
     {
-        g_translated_descriptor_count++;
+        fprintf(stderr, "Building a new %s index instead\n", TERM_INDEX_NAME);
+        g_update_terms = false;
+        delete g_term_indexer;
+        g_term_indexer = NULL;
+        CreateTermIndexer(es_location, false);
+        if (!g_term_indexer)
+            return;
     }
 
-    return true;
+    JsonWriter json;
+    std::vector<DescriptorTerm> terms;
+    for (size_t i=0; i<g_descriptors.size(); i++)
+    {
+        if (all_terms || g_changed_descriptors[i])
+        {
+            IndexTerms(g_descriptors[i], terms, json);
+        }
+    }
+}
+
+bool PublishTermIndex()
+{
+    if (0 < g_term_indexer->GetFailedCount())
+    {
+        fprintf(stderr, "Not publishing %s, as some terms failed. Suggestions keep using the old one\n", g_term_index->GetName().c_str());
+        return false;
+    }
+
+    fprintf(stdout, "Publishing %s\n", g_term_index->GetName().c_str());
+    fflush(stdout);
+    PhaseTimer phase(g_metrics, "publish_terms");
+    return g_term_index->Publish(g_replicas, g_keep_versions);
+}
+
+void ReportIndexingStatistics()
+{
+    printIndexingStatistics(g_bulk_indexer->GetIndexedCount(), g_bulk_indexer->GetFailedCount(), g_bulk_indexer->GetRetriedCount());
+    g_metrics.SetCount("indexed", g_bulk_indexer->GetIndexedCount());
+    g_metrics.SetCount("failed", g_bulk_indexer->GetFailedCount());
+    g_metrics.SetCount("retried", g_bulk_indexer->GetRetriedCount());
+    g_metrics.SetCount("batch_documents", g_bulk_indexer->GetBatchDocuments());
+}
+
+void IndexDescriptors(const char* es_location, Manifest& manifest)
+{
+    if (g_manifest_filename)
+    {
+        g_document_hashes.assign(g_descriptors.size(), 0);
+    }
+
+    std::atomic<size_t> next_descriptor(0);
+    std::atomic<long> count(0);
+    std::atomic<long> unchanged_count(0);
+    long deleted_count = 0;
+    std::vector<std::string> deleted_ids;
+    {
+        PhaseTimer phase(g_metrics, "build");
+        g_tree_index.CountDescendants(); //Read by all serializer threads
+        std::vector<std::thread> serializer_threads;
+        for (int i=0; i<g_worker_count; i++)
+        {
+            serializer_threads.push_back(std::thread(SerializerThread, &next_descriptor, &count, &unchanged_count));
+        }
+        for (int i=0; i<g_worker_count; i++)
+        {
+            serializer_threads[i].join();
+        }
+
+        if (g_manifest_filename)
+        {
+            deleted_count = DeleteRemovedDescriptors(manifest, deleted_ids);
+        }
+        if (g_update_terms)
+        {
+            UpdateTerms(es_location, deleted_ids);
+        }
+    }
+
+    {
+        PhaseTimer phase(g_metrics, "flush"); //Batches still queued or in flight when the last document is built
+        g_bulk_indexer->Flush();
+        if (g_term_indexer)
+        {
+            g_term_indexer->Flush();
+        }
+    }
+    fprintf(stdout, "\n");
+    ReportIndexingStatistics();
+    if (g_term_indexer)
+    {
+        printTermStatistics(g_term_indexer->GetIndexedCount(), g_term_indexer->GetFailedCount());
+        g_metrics.SetCount("terms_indexed", g_term_indexer->GetIndexedCount());
+        g_metrics.SetCount("terms_failed", g_term_indexer->GetFailedCount());
+    }
+
+    if (g_manifest_filename)
+    {
+        printDeltaStatistics(unchanged_count, deleted_count);
+        g_metrics.SetCount("unchanged", unchanged_count);
+        g_metrics.SetCount("deleted", deleted_count);
+    }
+}
+
+bool WriteFailedIds(const char* filename)
+{
+    //One descriptor id per line, sorted. Written even when empty, so a missing file means the import did not get this far
+    std::vector<std::string> failed_ids = g_bulk_indexer->GetFailedIds();
+    std::sort(failed_ids.begin(), failed_ids.end());
+    failed_ids.erase(std::unique(failed_ids.begin(), failed_ids.end()), failed_ids.end());
+
+    FILE* file = fopen(filename, "w");
+    if (!file)
+        return false;
+
+    std::vector<std::string>::const_iterator id_iterator = failed_ids.begin();
+    for (; id_iterator!=failed_ids.end(); ++id_iterator)
+    {
+        fprintf(file, "%s\n", id_iterator->c_str());
+    }
+    return 0 == fclose(file);
+}
+
+bool PublishIndex()
+{
+    if (0 < g_bulk_indexer->GetFailedCount())
+    {
+        fprintf(stderr, "Not publishing %s, as some documents failed. The live index is unchanged\n", g_index_name.c_str());
+        return false;
+    }
+
+    fprintf(stdout, "Publishing %s\n", g_index_name.c_str());
+    fflush(stdout);
+    PhaseTimer phase(g_metrics, "publish");
+    return g_versioned_index->Publish(g_replicas, g_keep_versions);
+}
+
+bool HasShardSuffix(const std::string& filename, const char* suffix)
+{
+    size_t length = strlen(suffix);
+    return filename.length()>length && 0==filename.compare(filename.length()-length, length, suffix);
+}
+
+bool PrepareExportDirectory(const char* directory)
+//Creates the directory, and removes the shards and index file of an earlier export. Other files are left alone
+{
+    if (0!=mkdir(directory, 0755) && EEXIST!=errno)
+        return false;
+
+    DIR* dir = opendir(directory);
+    if (!dir)
+        return false;
+
+    bool ok = true;
+    struct dirent* entry;
+    while (NULL != (entry=readdir(dir)))
+    {
+        std::string name = entry->d_name;
+        if (EXPORT_INDEX_FILENAME==name || HasShardSuffix(name, SHARD_SUFFIX) || HasShardSuffix(name, SHARD_SUFFIX ".tmp"))
+        {
+            ok = (0 == remove((std::string(directory) + "/" + name).c_str())) && ok;
+        }
+    }
+    closedir(dir);
+    return ok;
+}
+
+bool FinishExport()
+//The index file is written last. --load-ndjson refuses a directory without it, so an export that failed is never loaded
+{
+    if (0 < g_bulk_indexer->GetFailedCount() || (g_term_indexer && 0<g_term_indexer->GetFailedCount()))
+    {
+        fprintf(stderr, "Export to %s is incomplete, as some documents could not be written\n", g_export_directory);
+        return false;
+    }
+
+    std::string filename = std::string(g_export_directory) + "/" EXPORT_INDEX_FILENAME;
+    std::string temporary_filename = filename + ".tmp";
+    FILE* file = fopen(temporary_filename.c_str(), "w");
+    if (!file)
+        return false;
+
+    bool ok = (0 < fprintf(file, "%s\n", g_index_name.c_str()));
+    ok = (0 == fclose(file)) && ok;
+    if (!ok || 0!=rename(temporary_filename.c_str(), filename.c_str()))
+    {
+        remove(temporary_filename.c_str());
+        fprintf(stderr, "Could not write %s\n", filename.c_str());
+        return false;
+    }
+
+    fprintf(stdout, "Wrote %ld shards to %s\n", g_bulk_indexer->GetShardCount(), g_export_directory);
+    if (g_term_indexer)
+    {
+        fprintf(stdout, "Wrote %ld term shards to %s\n", g_term_indexer->GetShardCount(), TermExportDirectory(g_export_directory).c_str());
+    }
+    fflush(stdout);
+    return true;
+}
+
+bool StampIndex(const char* es_location, std::string& index_name, uint64_t& stamp)
+//Stores a new stamp in the _meta of the index the mesh alias points to. MeSHWeb stops using snapshots that have
+//another one (see common/mesh_snapshot.h)
+{
+    HTTP http(es_location, false);
+    Json::Object result;
+    unsigned int status;
+    try
+    {
+        status = http.get("_alias/" DESCRIPTOR_INDEX_NAME, NULL, &result);
+    }
+    catch(...)
+    {
+        status = 0;
+    }
+
+    if (404 == status) //A plain index, from before imports were versioned
+    {
+        index_name = DESCRIPTOR_INDEX_NAME;
+    }
+    else if (200==status && 1==std::distance(result.begin(), result.end()))
+    {
+        index_name = result.begin()->first;
+    }
+    else
+    {
+        return false;
+    }
+
+    stamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    std::string meta = "{\"_meta\": {\"" MESH_SNAPSHOT_META_KEY "\": \"" + std::to_string(stamp) + "\"}}";
+    try
+    {
+        status = http.put((index_name + "/_mapping").c_str(), meta.c_str(), &result);
+    }
+    catch(...)
+    {
+        status = 0;
+    }
+    return 200 == status;
+}
+
+void UpdateSnapshot(const char* es_location, bool changed, bool complete)
+//After the live mesh index is replaced or changed. changed: documents were updated in place, so snapshots written
+//before no longer describe it. complete: the index holds everything the new snapshot would
+{
+    if (!changed && !g_snapshot_filename)
+        return;
+
+    PhaseTimer phase(g_metrics, "snapshot");
+    std::string index_name;
+    uint64_t stamp = 0;
+    bool stamped = StampIndex(es_location, index_name, stamp);
+    if (!stamped)
+    {
+        fprintf(stderr, "Could not store a new %s in the %s index. MeSHWeb may use an outdated snapshot\n", MESH_SNAPSHOT_META_KEY, DESCRIPTOR_INDEX_NAME);
+    }
+    if (!g_snapshot_filename)
+        return;
+
+    if (!complete)
+    {
+        fprintf(stderr, "Removing snapshot %s, as some documents failed. MeSHWeb asks Elasticsearch until it is written again\n", g_snapshot_filename);
+    }
+    else if (stamped && (g_load_directory ? BindSnapshot(g_snapshot_filename, index_name, stamp) :
+                                            WriteSnapshot(g_snapshot_filename, index_name, stamp, g_descriptors, g_tree_index)))
+    {
+        return;
+    }
+    else
+    {
+        fprintf(stderr, "Could not write snapshot %s. Removed it, MeSHWeb asks Elasticsearch until it is written again\n", g_snapshot_filename);
+    }
+    remove(g_snapshot_filename);
+}
+
+bool ReadWholeFile(const std::string& filename, std::string& contents)
+{
+    FILE* file = fopen(filename.c_str(), "r");
+    if (!file)
+        return false;
+
+    char buffer[64*1024];
+    size_t length;
+    contents.clear();
+    while (0 < (length=fread(buffer, 1, sizeof(buffer), file)))
+    {
+        contents.append(buffer, length);
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+bool ReadExportIndexName(const char* directory)
+{
+    std::string index_name;
+    if (!ReadWholeFile(std::string(directory) + "/" EXPORT_INDEX_FILENAME, index_name))
+        return false;
+
+    index_name.erase(index_name.find_last_not_of("\r\n")+1);
+    if (index_name.empty())
+        return false;
+
+    g_index_name = index_name;
+    g_import_supplemental = (SUPPLEMENTAL_INDEX_NAME == index_name);
+    return true;
+}
+
+bool ListShards(const char* directory, std::vector<std::string>& filenames)
+{
+    DIR* dir = opendir(directory);
+    if (!dir)
+        return false;
+
+    struct dirent* entry;
+    while (NULL != (entry=readdir(dir)))
+    {
+        std::string name = entry->d_name;
+        if (HasShardSuffix(name, SHARD_SUFFIX))
+        {
+            filenames.push_back(std::string(directory) + "/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(filenames.begin(), filenames.end()); //Zero-padded numbers, so this is the order they were built in
+    return true;
+}
+
+bool ReplayShards(BulkIndexer* bulk_indexer, const std::vector<std::string>& filenames)
+{
+    std::string payload;
+    for (size_t i=0; i<filenames.size(); i++)
+    {
+        if (!ReadWholeFile(filenames[i], payload) || !bulk_indexer->Replay(payload)) //Replay blocks while too much is in flight
+        {
+            fprintf(stderr, "\nCould not read shard %s\n", filenames[i].c_str());
+            return false;
+        }
+        printLoadStatus(i+1, filenames.size());
+    }
+    return true;
+}
+
+int LoadShards(const char* es_location)
+//Each shard is sent as the _bulk request it was written as. The sender threads are the parallel connections
+{
+    std::vector<std::string> filenames;
+    if (!ListShards(g_load_directory, filenames))
+    {
+        fprintf(stderr, "Could not read %s\n", g_load_directory);
+        return -1;
+    }
+
+    if (g_should_clean_database && !(g_import_supplemental ? CleanSupplementalDatabase() : CleanDatabase()))
+    {
+        fprintf(stderr, "Nothing imported\n");
+        return -1;
+    }
+    CreateBulkIndexer(es_location);
+
+    //Exports of descriptors have the terms in a subdirectory. Older ones do not, and suggestions keep the term index they have
+    std::vector<std::string> term_filenames;
+    if (!g_import_supplemental && ListShards(TermExportDirectory(g_load_directory).c_str(), term_filenames) && !term_filenames.empty())
+    {
+        CreateTermIndexer(es_location);
+    }
+
+    bool read_ok;
+    {
+        PhaseTimer phase(g_metrics, "load");
+        read_ok = ReplayShards(g_bulk_indexer, filenames);
+        if (g_term_indexer && read_ok)
+        {
+            read_ok = ReplayShards(g_term_indexer, term_filenames);
+        }
+    }
+    {
+        PhaseTimer phase(g_metrics, "flush");
+        g_bulk_indexer->Flush();
+        if (g_term_indexer)
+        {
+            g_term_indexer->Flush();
+        }
+    }
+    fprintf(stdout, "\n");
+    ReportIndexingStatistics();
+    if (g_term_indexer)
+    {
+        printTermStatistics(g_term_indexer->GetIndexedCount(), g_term_indexer->GetFailedCount());
+    }
+    g_metrics.SetCount("shards", filenames.size()+term_filenames.size());
+
+    if (g_failed_ids_filename && !WriteFailedIds(g_failed_ids_filename))
+    {
+        fprintf(stderr, "Could not write failed ids %s\n", g_failed_ids_filename);
+    }
+
+    int result = 0;
+    bool published = false;
+    if (!read_ok)
+    {
+        fprintf(stderr, g_versioned_index ? "Export could not be read completely, nothing published\n" : "Export could not be read completely\n");
+        result = -1;
+    }
+    else if (g_versioned_index && !PublishIndex())
+    {
+        result = -1;
+    }
+    else
+    {
+        published = true;
+        if (g_term_index && !PublishTermIndex())
+        {
+            result = -1;
+        }
+    }
+    if (!g_import_supplemental && (published || !g_versioned_index)) //Without --clean, even a partial load changed the live index
+    {
+        UpdateSnapshot(es_location, !g_versioned_index && 0<g_bulk_indexer->GetIndexedCount()+g_bulk_indexer->GetFailedCount(),
+                       published && 0==g_bulk_indexer->GetFailedCount());
+    }
+
+    delete g_term_indexer;
+    delete g_term_index;
+    delete g_bulk_indexer;
+    return result;
+}
+
+static std::string GetSourceString(const Json::Object& source_object, const char* key)
+{
+    return source_object.member(key) ? source_object.getValue(key).getString() : std::string();
+}
+
+static void GetSourceStrings(const Json::Object& source_object, const char* key, std::vector<std::string>& values)
+{
+    if (!source_object.member(key))
+        return;
+
+    const Json::Array values_array = source_object.getValue(key).getArray();
+    Json::Array::const_iterator value_iterator = values_array.begin();
+    for (; value_iterator!=values_array.end(); ++value_iterator)
+    {
+        values.push_back((*value_iterator).getString());
+    }
+}
+
+void ReadStoredHierarchy(const Json::Object& source_object, Descriptor& stored)
+//What DescriptorHierarchyToJson writes, as the document has it now
+{
+    GetSourceStrings(source_object, "parent_tree_numbers", stored.parent_tree_numbers);
+    GetSourceStrings(source_object, "child_tree_numbers", stored.child_tree_numbers);
+    stored.top_node = ("yes" == GetSourceString(source_object, "top_node"));
+
+    if (source_object.member("child_summaries"))
+    {
+        const Json::Array children_array = source_object.getValue("child_summaries").getArray();
+        Json::Array::const_iterator child_iterator = children_array.begin();
+        for (; child_iterator!=children_array.end(); ++child_iterator)
+        {
+            const Json::Object child_object = (*child_iterator).getObject();
+            DescriptorChild child;
+            child.parent_tree_number = GetSourceString(child_object, "parent_tree_number");
+            child.tree_number = GetSourceString(child_object, "tree_number");
+            child.id = GetSourceString(child_object, "id");
+            child.nor_name = GetSourceString(child_object, "nor_name");
+            child.eng_name = GetSourceString(child_object, "eng_name");
+            child.child_count = child_object.member("child_count") ? child_object.getValue("child_count").getInt() : 0;
+            child.descendant_count = child_object.member("descendant_count") ? child_object.getValue("descendant_count").getInt() : 0;
+            stored.child_summaries.push_back(child);
+        }
+    }
+    if (source_object.member("ancestors"))
+    {
+        const Json::Array ancestors_array = source_object.getValue("ancestors").getArray();
+        Json::Array::const_iterator ancestor_iterator = ancestors_array.begin();
+        for (; ancestor_iterator!=ancestors_array.end(); ++ancestor_iterator)
+        {
+            const Json::Object ancestor_object = (*ancestor_iterator).getObject();
+            DescriptorAncestor ancestor = {GetSourceString(ancestor_object, "tree_number"), GetSourceString(ancestor_object, "id"),
+                                           GetSourceString(ancestor_object, "nor_name"), GetSourceString(ancestor_object, "eng_name")};
+            stored.ancestors.push_back(ancestor);
+        }
+    }
+    if (source_object.member("see_related_names"))
+    {
+        const Json::Array names_array = source_object.getValue("see_related_names").getArray();
+        Json::Array::const_iterator name_iterator = names_array.begin();
+        for (; name_iterator!=names_array.end(); ++name_iterator)
+        {
+            const Json::Object name_object = (*name_iterator).getObject();
+            DescriptorName name = {GetSourceString(name_object, "id"), GetSourceString(name_object, "nor_name"), GetSourceString(name_object, "eng_name")};
+            stored.see_related_names.push_back(name);
+        }
+    }
+    if (source_object.member("tree_paths") && source_object.member("tree_depths"))
+    {
+        const Json::Array paths_array = source_object.getValue("tree_paths").getArray();
+        Json::Array::const_iterator path_iterator = paths_array.begin();
+        for (; path_iterator!=paths_array.end(); ++path_iterator)
+        {
+            stored.tree_paths.push_back((*path_iterator).getLong());
+        }
+        const Json::Array depths_array = source_object.getValue("tree_depths").getArray();
+        Json::Array::const_iterator depth_iterator = depths_array.begin();
+        for (; depth_iterator!=depths_array.end(); ++depth_iterator)
+        {
+            stored.tree_depths.push_back((*depth_iterator).getInt());
+        }
+    }
+}
+
+struct ScrolledSlice
+{
+    ScrolledSlice() : ok(false) {}
+
+    std::vector<Descriptor> descriptors; //Only what the hierarchy is built from
+    std::vector<Descriptor> stored; //Parallel to descriptors, only the fields the hierarchy gives
+    bool ok;
+};
+
+void ScrollSliceThread(const char* es_location, int slice, int slice_count, ScrolledSlice* scrolled)
+//Each slice has its own connection and scroll context, so Elasticsearch serves them in parallel
+{
+    std::stringstream query;
+    query << "{";
+    if (1 < slice_count) //A slice needs at least two
+    {
+        query << "\"slice\": {\"id\": " << slice << ", \"max\": " << slice_count << "}, ";
+    }
+    query << "\"sort\": [\"_doc\"], "
+          << "\"_source\": [\"id\", \"nor_name\", \"eng_name\", \"see_related\", \"tree_numbers\", \"parent_tree_numbers\", \"child_tree_numbers\", "
+          << "\"child_summaries\", \"ancestors\", \"see_related_names\", \"top_node\", \"tree_paths\", \"tree_depths\"], "
+          << "\"query\": {\"match_all\": {}}}";
+
+    ElasticSearch es(es_location);
+    Json::Array result_array;
+    std::string scroll_id;
+    if (!es.initScroll(scroll_id, g_index_name, query.str(), result_array, REBUILD_SCROLL_SIZE))
+        return;
+
+    do
+    {
+        if (result_array.empty())
+            break;
+
+        Json::Array::const_iterator hits_iterator = result_array.begin();
+        for (; hits_iterator!=result_array.end(); ++hits_iterator)
+        {
+            const Json::Object hit_value_object = (*hits_iterator).getObject();
+            const Json::Object source_object = hit_value_object.getValue("_source").getObject();
+
+            Descriptor descriptor;
+            descriptor.id = GetSourceString(source_object, "id");
+            if (descriptor.id.empty())
+                continue;
+
+            descriptor.nor_name = GetSourceString(source_object, "nor_name");
+            descriptor.eng_name = GetSourceString(source_object, "eng_name");
+            GetSourceStrings(source_object, "see_related", descriptor.see_related);
+            GetSourceStrings(source_object, "tree_numbers", descriptor.tree_numbers);
+            scrolled->descriptors.push_back(std::move(descriptor));
+
+            scrolled->stored.push_back(Descriptor());
+            ReadStoredHierarchy(source_object, scrolled->stored.back());
+        }
+        g_read_records += result_array.size();
+        result_array.clear();
+    } while (es.scrollNext(scroll_id, result_array));
+
+    es.clearScroll(scroll_id);
+    scrolled->ok = true;
+}
+
+static bool ChildTreeNumberLess(const DescriptorChild& child, const DescriptorChild& other_child)
+{
+    return child.tree_number < other_child.tree_number;
+}
+
+static void SortChildren(Descriptor& descriptor)
+//An import lists children in file order and the index is scrolled in another order. Only the order would differ
+{
+    std::sort(descriptor.child_tree_numbers.begin(), descriptor.child_tree_numbers.end());
+    std::stable_sort(descriptor.child_summaries.begin(), descriptor.child_summaries.end(), ChildTreeNumberLess);
+}
+
+void RebuildHierarchyThread(std::atomic<size_t>* next_descriptor, std::vector<Descriptor>* stored, std::vector<char>* moved,
+                            std::atomic<long>* count, std::atomic<long>* changed_count)
+{
+    long total = g_descriptors.size();
+    JsonWriter rebuilt_json;
+    JsonWriter stored_json;
+    size_t index;
+    while ((index = (*next_descriptor)++) < g_descriptors.size())
+    {
+        Descriptor& descriptor = g_descriptors[index];
+        PopulateChildTreeNumbers(descriptor);
+        PopulateAncestors(descriptor);
+        PopulateSeeRelatedNames(descriptor);
+        SortChildren(descriptor);
+        SortChildren((*stored)[index]);
+
+        //The stored paths were encoded from the tree numbers the document had when it was written. When they still
+        //match, the stored JSON gets the same ones. Otherwise the document and its terms moved, and are updated
+        (*moved)[index] = !TreePathsMatch(descriptor.tree_numbers, (*stored)[index].tree_paths, (*stored)[index].tree_depths);
+        if (!(*moved)[index])
+        {
+            (*stored)[index].tree_numbers = descriptor.tree_numbers;
+        }
+
+        rebuilt_json.Clear();
+        rebuilt_json.BeginObject();
+        rebuilt_json.Key("doc");
+        DescriptorHierarchyToJson(descriptor, rebuilt_json);
+        rebuilt_json.EndObject();
+
+        stored_json.Clear();
+        stored_json.BeginObject();
+        stored_json.Key("doc");
+        DescriptorHierarchyToJson((*stored)[index], stored_json);
+        stored_json.EndObject();
+
+        if (rebuilt_json.GetDocument() != stored_json.GetDocument())
+        {
+            g_bulk_indexer->Update(descriptor.id, rebuilt_json.GetDocument());
+            (*changed_count)++;
+        }
+
+        long current = ++(*count);
+        if (0==(current%1000) || current==total)
+        {
+            printUpdateHierarchyStatus(current, total);
+        }
+    }
+}
+
+long ESSearch(const std::string& index, const std::string& query, Json::Object& search_result)
+//Like MeSHWeb's ElasticSearchUtil::search. -1 when the search failed, so it is not mistaken for an empty index
+{
+    try
+    {
+        errno = 0;
+        return g_es->search(index, query, search_result);
+    }
+    catch(...)
+    {
+        return -1L;
+    }
+}
+
+bool UpdateTermTreeNumbers(const char* es_location, const std::vector<char>& moved, long& updated_count)
+//The mesh_terms documents of a descriptor copy its tree numbers and paths for subtree filters. One request per
+//descriptor, as each has its own. Only hand-patched descriptors move outside an import, so there are few
+{
+    updated_count = 0;
+    HTTP http(es_location, true);
+    JsonWriter json;
+    for (size_t i=0; i<g_descriptors.size(); i++)
+    {
+        if (!moved[i])
+            continue;
+
+        json.Clear();
+        json.BeginObject();
+        json.Key("query");
+        json.BeginObject();
+        json.Key("term");
+        json.BeginObject();
+        json.StringMember("id", g_descriptors[i].id);
+        json.EndObject();
+        json.EndObject();
+        json.Key("script");
+        json.BeginObject();
+        json.StringMember("source", "for (def field : params.keySet()) {ctx._source[field] = params[field];}");
+        json.Key("params");
+        DescriptorTreeNumbersToJson(g_descriptors[i], json);
+        json.EndObject();
+        json.EndObject();
+
+        Json::Object result;
+        unsigned int status;
+        try
+        {
+            status = http.post(TERM_INDEX_NAME "/_update_by_query?conflicts=proceed", json.GetDocument().c_str(), &result);
+        }
+        catch(...)
+        {
+            status = 0;
+        }
+        if (200!=status || (result.member("failures") && !result.getValue("failures").getArray().empty()))
+        {
+            fprintf(stderr, "\nUpdating the terms of %s in %s failed with HTTP status %u\n", g_descriptors[i].id.c_str(), TERM_INDEX_NAME, status);
+            return false;
+        }
+        updated_count++;
+    }
+    return true;
+}
+
+int RebuildHierarchy(const char* es_location)
+//Hand-patched descriptors can leave parents, children and the names copied from them out of step. Reads every
+//descriptor's tree numbers and names from the index, builds the hierarchy like an import does, and sends partial
+//updates for the documents that differ from it
+{
+    std::vector<ScrolledSlice> slices(g_worker_count);
+    {
+        PhaseTimer phase(g_metrics, "scroll");
+        std::vector<std::thread> scroll_threads;
+        for (int i=0; i<g_worker_count; i++)
+        {
+            scroll_threads.push_back(std::thread(ScrollSliceThread, es_location, i, g_worker_count, &slices[i]));
+        }
+        for (int i=0; i<g_worker_count; i++)
+        {
+            scroll_threads[i].join();
+        }
+    }
+
+    size_t descriptor_count = 0;
+    for (size_t i=0; i<slices.size(); i++)
+    {
+        if (!slices[i].ok)
+        {
+            fprintf(stderr, "Could not read the %s index, nothing updated\n", g_index_name.c_str());
+            return -1;
+        }
+        descriptor_count += slices[i].descriptors.size();
+    }
+
+    //A scroll that stopped early would look like descriptors without children, and clear them everywhere
+    Json::Object search_result;
+    long indexed_count = ESSearch(g_index_name, "{\"size\": 0, \"track_total_hits\": true, \"query\": {\"match_all\": {}}}", search_result);
+    if (0 >= indexed_count)
+    {
+        fprintf(stderr, "Could not count the documents in the %s index, nothing updated\n", g_index_name.c_str());
+        return -1;
+    }
+    if (static_cast<long>(descriptor_count) < indexed_count || 0 == descriptor_count)
+    {
+        fprintf(stderr, "Read %ld of %ld documents in the %s index, nothing updated\n", static_cast<long>(descriptor_count), indexed_count, g_index_name.c_str());
+        return -1;
+    }
+
+    //Single letter tree numbers only exist when the import forced topnodes, and they make the letter every tree's parent
+    std::vector<Descriptor> stored;
+    stored.reserve(descriptor_count);
+    g_descriptors.reserve(descriptor_count);
+    for (size_t i=0; i<slices.size() && !g_should_read_topnodes_file; i++)
+    {
+        std::vector<Descriptor>::const_iterator descriptor_iterator = slices[i].descriptors.begin();
+        for (; descriptor_iterator!=slices[i].descriptors.end() && !g_should_read_topnodes_file; ++descriptor_iterator)
+        {
+            std::vector<std::string>::const_iterator tree_number_iterator = descriptor_iterator->tree_numbers.begin();
+            for (; tree_number_iterator!=descriptor_iterator->tree_numbers.end(); ++tree_number_iterator)
+            {
+                g_should_read_topnodes_file = g_should_read_topnodes_file || 1==tree_number_iterator->length();
+            }
+        }
+    }
+
+    {
+        PhaseTimer phase(g_metrics, "build");
+        std::string parent_tree_number;
+        for (size_t i=0; i<slices.size(); i++)
+        {
+            std::vector<Descriptor>::iterator descriptor_iterator = slices[i].descriptors.begin();
+            for (; descriptor_iterator!=slices[i].descriptors.end(); ++descriptor_iterator)
+            {
+                //The topnodes themselves are read from their own file, without forcing
+                bool topnodes_forced = g_should_read_topnodes_file &&
+                                       !(!descriptor_iterator->tree_numbers.empty() && 1==descriptor_iterator->tree_numbers.front().length());
+                std::vector<std::string>::const_iterator tree_number_iterator = descriptor_iterator->tree_numbers.begin();
+                for (; tree_number_iterator!=descriptor_iterator->tree_numbers.end(); ++tree_number_iterator)
+                {
+                    TreeIndex::GetParentTreeNumber(*tree_number_iterator, topnodes_forced, parent_tree_number);
+                    if (parent_tree_number.empty())
+                    {
+                        descriptor_iterator->top_node = true;
+                    }
+                    else
+                    {
+                        descriptor_iterator->parent_tree_numbers.push_back(parent_tree_number);
+                    }
+                }
+                AddDescriptor(*descriptor_iterator, topnodes_forced);
+            }
+            stored.insert(stored.end(), std::make_move_iterator(slices[i].stored.begin()), std::make_move_iterator(slices[i].stored.end()));
+            std::vector<Descriptor>().swap(slices[i].descriptors);
+            std::vector<Descriptor>().swap(slices[i].stored);
+        }
+        g_tree_index.CountDescendants();
+    }
+    fprintf(stdout, "Read %ld descriptors from the %s index%s\n", static_cast<long>(descriptor_count), g_index_name.c_str(),
+            g_should_read_topnodes_file ? ", with forced topnodes" : "");
+
+    CreateBulkIndexer(es_location);
+    std::atomic<size_t> next_descriptor(0);
+    std::atomic<long> count(0);
+    std::atomic<long> changed_count(0);
+    std::vector<char> moved(g_descriptors.size(), false); //Tree paths no longer those of the tree numbers
+    {
+        PhaseTimer phase(g_metrics, "update");
+        std::vector<std::thread> rebuild_threads;
+        for (int i=0; i<g_worker_count; i++)
+        {
+            rebuild_threads.push_back(std::thread(RebuildHierarchyThread, &next_descriptor, &stored, &moved, &count, &changed_count));
+        }
+        for (int i=0; i<g_worker_count; i++)
+        {
+            rebuild_threads[i].join();
+        }
+    }
+    {
+        PhaseTimer phase(g_metrics, "flush");
+        g_bulk_indexer->Flush();
+    }
+    fprintf(stdout, "\nChanged documents: %ld\n", changed_count.load());
+    ReportIndexingStatistics();
+    g_metrics.SetCount("descriptors", descriptor_count);
+    g_metrics.SetCount("changed", changed_count);
+
+    int result = 0;
+    long moved_count = std::count(moved.begin(), moved.end(), 1);
+    if (0<moved_count && TermIndexExists(es_location))
+    {
+        PhaseTimer phase(g_metrics, "terms");
+        long updated_count;
+        if (!UpdateTermTreeNumbers(es_location, moved, updated_count))
+        {
+            fprintf(stderr, "Subtree filtered suggestions place the other %ld moved descriptors by their old tree numbers until they are updated\n", moved_count-updated_count);
+            result = -1;
+        }
+        fprintf(stdout, "Descriptors with updated terms: %ld\n", updated_count);
+        g_metrics.SetCount("moved", moved_count);
+    }
+
+    //The snapshot only holds the tree numbers and names that were read, so failed updates do not make it wrong
+    UpdateSnapshot(es_location, 0<changed_count, true);
+
+    if (g_failed_ids_filename && !WriteFailedIds(g_failed_ids_filename))
+    {
+        fprintf(stderr, "Could not write failed ids %s\n", g_failed_ids_filename);
+    }
+
+    delete g_bulk_indexer;
+    return result;
+}
+
+bool ReadDescriptorRecordSet(ImportFile& file)
+//<!ELEMENT DescriptorRecordSet (DescriptorRecord*)>
+//<!ATTLIST DescriptorRecordSet LanguageCode (cze|dut|eng|fin|fre|ger|ita|jpn|lav|por|scr|slv|spa) #REQUIRED>
+{
+	if (XML_READER_TYPE_ELEMENT!=xmlTextReaderNodeType(file.reader) || 0!=xmlStrcmp(BAD_CAST("DescriptorRecordSet"), xmlTextReaderConstName(file.reader)))
+		return false;
+
+    xmlChar* language_code = xmlTextReaderGetAttribute(file.reader, BAD_CAST("LanguageCode"));
+    if (!language_code)
+        return false;
+    file.language_code = CONST_CHAR(language_code);
+    xmlFree(language_code);
+    file.has_record_set = true;
+
+	if (1 != xmlTextReaderRead(file.reader)) //Skip to first DescriptorRecord
+		return false;
+
+    //This thread only reads. Expanded records are copied and handed to the converter threads
+    BoundedQueue<DescriptorRecordWork> queue(g_queue_size);
+    std::vector<ConvertedDescriptors> converted(file.worker_count);
+    std::vector<std::thread> converter_threads;
+    for (int i=0; i<file.worker_count; i++)
+    {
+        converter_threads.push_back(std::thread(ConverterThread, &queue, &file, &converted[i]));
+    }
+
+	bool more = true;
+	long reported_records = 0;
+	long reported_bytes = 0;
+	xmlNodePtr descriptor_record_ptr;
+	while (more &&
+	       NULL!=(descriptor_record_ptr=xmlTextReaderExpand(file.reader)) &&
+	       XML_ELEMENT_NODE==descriptor_record_ptr->type && 0==xmlStrcmp(BAD_CAST("DescriptorRecord"), descriptor_record_ptr->name)) //Read and parse current DescriptorRecord
+	{
+		DescriptorRecordWork work = {file.record_count++, xmlCopyNode(descriptor_record_ptr, 1)};
+		queue.Push(work); //Blocks while the converters are behind
+		more = (1 == xmlTextReaderNext(file.reader)); //Skip to next DescriptorRecord
+
+		if (0 == (file.record_count%100))
+		{
+			AddReadProgress(file.record_count-reported_records, file.input.GetBytesConsumed()-reported_bytes);
+			reported_records = file.record_count;
+			reported_bytes = file.input.GetBytesConsumed();
+		}
+	}
+
+    DescriptorRecordWork stop = {0, NULL};
+    for (int i=0; i<file.worker_count; i++)
+    {
+        queue.Push(stop);
+    }
+    for (int i=0; i<file.worker_count; i++)
+    {
+        converter_threads[i].join();
+    }
+    OrderConvertedDescriptors(converted, file.descriptors);
+
+    AddReadProgress(file.record_count-reported_records, file.input.GetBytesConsumed()-reported_bytes);
+	return true;
+}
+
+bool ReadSupplementalRecordSet(ImportFile& file)
+//<!ELEMENT SupplementalRecordSet (SupplementalRecord*)>
+//<!ATTLIST SupplementalRecordSet LanguageCode (cze|dut|eng|fin|fre|ger|ita|jpn|lav|por|scr|slv|spa) #REQUIRED>
+{
+	if (XML_READER_TYPE_ELEMENT!=xmlTextReaderNodeType(file.reader) || 0!=xmlStrcmp(BAD_CAST("SupplementalRecordSet"), xmlTextReaderConstName(file.reader)))
+		return false;
+
+    xmlChar* language_code = xmlTextReaderGetAttribute(file.reader, BAD_CAST("LanguageCode"));
+    if (!language_code)
+        return false;
+    file.language_code = CONST_CHAR(language_code);
+    xmlFree(language_code);
+    file.has_record_set = true;
+    if (g_checkpoint_filename)
+    {
+        g_checkpoint.SetLanguageCode(file.checkpoint_file, file.language_code);
+    }
+
+	if (1 != xmlTextReaderRead(file.reader)) //Skip to first SupplementalRecord
+		return false;
+
+    //Records are indexed by the converter threads as they come, so only the queue
+    //and the bulk indexer's in-flight batches are ever held, whatever the file size
+    BoundedQueue<SupplementalRecordWork> queue(g_queue_size);
+    std::vector<std::thread> converter_threads;
+    for (int i=0; i<file.worker_count; i++)
+    {
+        converter_threads.push_back(std::thread(SupplementalConverterThread, &queue, &file));
+    }
+
+	bool more = true;
+	long reported_records = 0; //Records and bytes skipped by a resume are counted with the first report
+	long reported_bytes = 0;
+	xmlNodePtr supplemental_record_ptr;
+	while (more)
+	{
+		long offset = file.input_offset + xmlTextReaderByteConsumed(file.reader); //Ahead of the record start by the reader's lookahead
+		if (NULL==(supplemental_record_ptr=xmlTextReaderExpand(file.reader)) ||
+		    XML_ELEMENT_NODE!=supplemental_record_ptr->type || 0!=xmlStrcmp(BAD_CAST("SupplementalRecord"), supplemental_record_ptr->name))
+			break;
+
+		if (file.resume_id.empty())
+		{
+			SupplementalRecordWork work = {file.record_count++, offset, xmlCopyNode(supplemental_record_ptr, 1)};
+			queue.Push(work); //Blocks while the converters are behind
+		}
+		else if (0 == xmlStrcmp(BAD_CAST(file.resume_id.c_str()), GetSupplementalRecordUI(supplemental_record_ptr)))
+		{
+			file.resume_id.clear(); //The last acknowledged record, start with the next one
+		}
+		more = (1 == xmlTextReaderNext(file.reader)); //Skip to next SupplementalRecord
+
+		if (file.resume_id.empty() && 0==(file.record_count%100))
+		{
+			AddReadProgress(file.record_count-reported_records, file.input.GetBytesConsumed()-reported_bytes);
+			reported_records = file.record_count;
+			reported_bytes = file.input.GetBytesConsumed();
+		}
+	}
+
+    SupplementalRecordWork stop = {0, 0, NULL};
+    for (int i=0; i<file.worker_count; i++)
+    {
+        queue.Push(stop);
+    }
+    for (int i=0; i<file.worker_count; i++)
+    {
+        converter_threads[i].join();
+    }
+
+    if (!file.resume_id.empty())
+    {
+        fprintf(stderr, "\n%s does not have record %s where the checkpoint says, it is not the file that was imported\n", file.filename, file.resume_id.c_str());
+        file.read_failed = true;
+    }
+
+    AddReadProgress(file.record_count-reported_records, file.input.GetBytesConsumed()-reported_bytes);
+	return true;
+}
+
+void MappedParserThread(const MappedFile* mapped_file, ByteRange range, const ImportFile* file, ConvertedDescriptors* converted,
+                        std::atomic<long>* record_count)
+{
+    ImportMetrics::Clock::time_point start = ImportMetrics::Clock::now();
+    const char* file_begin = mapped_file->GetData();
+    const char* released_position = range.begin;
+    MappedDescriptorParser parser(range.begin, range.end, file->topnodes_forced, file->language_code);
+    long reported_records = 0;
+    const char* reported_position = range.begin;
+
+    Descriptor descriptor;
+    while (parser.Next(descriptor))
+    {
+        if (file->release_runs)
+        {
+            file->release_runs->Add(descriptor);
+        }
+        else
+        {
+            //The record offset orders descriptors across ranges, like the sequence number does for the libxml2 reader
+            converted->push_back(std::make_pair(static_cast<long>(parser.GetRecordStart()-file_begin), std::move(descriptor)));
+        }
+
+        if (0 == (parser.GetRecordCount()%100))
+        {
+            AddReadProgress(parser.GetRecordCount()-reported_records, parser.GetPosition()-reported_position);
+            reported_records = parser.GetRecordCount();
+            reported_position = parser.GetPosition();
+        }
+
+        if (MAPPED_RELEASE_BYTES <= parser.GetPosition()-released_position) //Descriptors hold copies, so parsed pages are not needed again
+        {
+            mapped_file->Release(released_position, parser.GetRecordStart());
+            released_position = parser.GetRecordStart();
+        }
+    }
+
+    AddReadProgress(parser.GetRecordCount()-reported_records, range.end-reported_position);
+    *record_count += parser.GetRecordCount();
+    g_metrics.AddWorkerTime("convert", ImportMetrics::SecondsSince(start)); //Parsing and converting are one pass here
+}
+
+void ReadMappedFile(ImportFile& file)
+{
+    MappedFile mapped_file;
+    if (!mapped_file.Open(file.filename))
+    {
+        fprintf(stderr, "File Not Found: %s\n", file.filename);
+        file.read_failed = true;
+        return;
+    }
+
+    const char* begin = mapped_file.GetData();
+    const char* end = begin + mapped_file.GetSize();
+    const char* records_begin;
+    if (!MappedDescriptorParser::ReadDescriptorRecordSet(begin, end, file.language_code, records_begin))
+        return;
+    file.has_record_set = true;
+    AddReadProgress(0, records_begin-begin);
+
+    //Every thread parses its own slice of the mapping, starting at a <DescriptorRecord> boundary
+    std::vector<ByteRange> ranges;
+    MappedDescriptorParser::SplitAtDescriptorRecords(records_begin, end, file.worker_count, ranges);
+
+    std::atomic<long> record_count(0);
+    std::vector<ConvertedDescriptors> converted(ranges.size());
+    std::vector<std::thread> parser_threads;
+    for (size_t i=0; i<ranges.size(); i++)
+    {
+        parser_threads.push_back(std::thread(MappedParserThread, &mapped_file, ranges[i], &file, &converted[i], &record_count));
+    }
+    for (size_t i=0; i<parser_threads.size(); i++)
+    {
+        parser_threads[i].join();
+    }
+    file.record_count = record_count;
+    OrderConvertedDescriptors(converted, file.descriptors); //Descriptors hold their own copies, so the file may be unmapped
+}
+
+void Usage(const char* name)
+{
+    fprintf(stderr, "Usage: %s <ElasticSearch-location> [--clean] [--topnodes <file>] [--bulk-documents <count>] [--bulk-bytes <bytes>] [--threads <count>] [--senders <count>] [--queue-size <count>] [--bulk-retries <count>] [--bulk-latency <ms>] [--in-flight-bytes <bytes>] [--failed-ids <file>] [--mmap] [--supplemental] [--checkpoint <file> [--resume]] [--emit-ndjson <directory>] [--load-ndjson <directory>] [--rebuild-hierarchy] [--diff <changelog-file>] [--delta <manifest-file>] [--replicas <count>] [--keep-versions <count>] [--snapshot <file>] [--metrics <json-file>] [--prometheus <prom-file>] <MeSH-file> [<MeSH-file>...]\n\nMeSH files may be gzip or zstd compressed. Use - to read from stdin.\nSeveral language files are read concurrently and merged into one document per descriptor. The first one fills the nor_ fields.\nA descriptor import also builds a new mesh_terms index with one document per term for the suggestions. --delta replaces the terms of changed descriptors in the live one instead, and --emit-ndjson writes its shards to a terms subdirectory.\n--supplemental streams SupplementalRecordSet files (supp20xx.xml) into the mesh_scr index instead. With --checkpoint, an interrupted import can be continued with --resume.\n--emit-ndjson writes the _bulk requests to numbered shards instead of sending them. --load-ndjson sends such shards, without MeSH files.\n--rebuild-hierarchy reads tree numbers and names back from the mesh index, and updates the parent, child, related and tree path fields that no longer match them. The mesh_terms documents of descriptors whose tree numbers changed get the new ones.\n--snapshot writes the tables MeSHWeb maps to answer lookups without Elasticsearch. Imports that change the mesh index in place make MeSHWeb stop using snapshots written before them. With --emit-ndjson, pass the same --snapshot when loading the shards.\n--diff compares an old and a new release file, and writes the descriptors that were added, removed, renamed, moved or otherwise changed. The changelog is CSV if its name ends in .csv, JSON otherwise.\n\nExample: %s localhost:9200 ~/Downloads/nordesc2015.xml\n         %s localhost:9200 --clean --supplemental --checkpoint supp.checkpoint ~/Downloads/supp2019.xml\n         %s - --emit-ndjson /tmp/mesh_shards ~/Downloads/nordesc2019.xml && %s localhost:9200 --clean --load-ndjson /tmp/mesh_shards\n         %s localhost:9200 --threads 8 --rebuild-hierarchy\n         %s - --diff changes.csv ~/Downloads/desc2023.xml ~/Downloads/desc2024.xml\n\n", name, name, name, name, name, name, name);
+}
+
+int InputReadCallback(void* context, char* buffer, int length)
+{
+    ImportFile* file = static_cast<ImportFile*>(context);
+    if (file->resume_position < file->resume_input.length())
+    {
+        int copied = static_cast<int>(std::min(static_cast<size_t>(length), file->resume_input.length()-file->resume_position));
+        memcpy(buffer, file->resume_input.data()+file->resume_position, copied);
+        file->resume_position += copied;
+        return copied;
+    }
+    return file->input.Read(buffer, length);
+}
+
+int InputCloseCallback(void* /*context*/)
+{
+    return 0; //ReadFile closes the stream
+}
+
+bool ResyncInput(ImportFile& file, const Checkpoint::FileProgress& progress)
+//Skips to a little before the last acknowledged record, then on to the next SupplementalRecord start tag. The reader gets
+//a made-up start of the file followed by the input from that tag on, and ReadSupplementalRecordSet skips to the record
+{
+    static const char RECORD_TAG[] = "<SupplementalRecord";
+    static const size_t TAG_LENGTH = sizeof(RECORD_TAG)-1;
+    char buffer[INPUT_BUFFER_SIZE/4];
+
+    long skip = std::max(0L, progress.offset-RESYNC_MARGIN_BYTES); //Compressed input has to be decompressed up to there anyway
+    long skipped = 0;
+    while (skipped < skip)
+    {
+        int length = file.input.Read(buffer, static_cast<int>(std::min(static_cast<long>(sizeof(buffer)), skip-skipped)));
+        if (0 >= length)
+            return false;
+        skipped += length;
+    }
+
+    std::string input;
+    size_t position = 0;
+    while (true)
+    {
+        size_t tag = input.find(RECORD_TAG, position);
+        for (; std::string::npos!=tag && tag+TAG_LENGTH<input.length(); tag=input.find(RECORD_TAG, tag+1))
+        {
+            char next = input[tag+TAG_LENGTH];
+            if (' '==next || '>'==next || '\t'==next || '\n'==next || '\r'==next) //Not SupplementalRecordUI, -Name or -Set
+            {
+                file.resume_input = "<?xml version=\"1.0\"?>\n<!DOCTYPE SupplementalRecordSet>\n<SupplementalRecordSet LanguageCode=\"" +
+                                    progress.language_code + "\">\n";
+                file.input_offset = skipped + tag - file.resume_input.length();
+                file.resume_input.append(input, tag, std::string::npos);
+                return true;
+            }
+        }
+        position = (std::string::npos!=tag) ? tag : (input.length()<TAG_LENGTH ? 0 : input.length()-TAG_LENGTH);
+
+        int length = file.input.Read(buffer, sizeof(buffer));
+        if (0 >= length)
+            return false;
+        input.append(buffer, length);
+    }
+}
+
+bool OpenFile(ImportFile& file)
+{
+    if (!file.input.Open(file.filename))
+    {
+        fprintf(stderr, "File Not Found: %s\n", file.filename);
+        file.read_failed = true;
+        return false;
+    }
+    return true;
+}
+
+void ReadFile(ImportFile* file)
+{
+    if (g_use_mapped_parser && !g_import_supplemental)
+    {
+        if (file->input.IsMappable())
+        {
+            file->input.Close();
+            ReadMappedFile(*file);
+            return;
+        }
+        fprintf(stderr, "%s can not be memory-mapped, streaming it instead\n", file->filename);
+    }
+
+    if (!file->resume_id.empty() && !ResyncInput(*file, g_checkpoint.GetFile(file->checkpoint_file)))
+    {
+        fprintf(stderr, "%s ends before the checkpoint, it is not the file that was imported\n", file->filename);
+        file->read_failed = true;
+        file->input.Close();
+        return;
+    }
+
+    file->reader = xmlReaderForIO(InputReadCallback, InputCloseCallback, file,
+                                  0==strcmp(STDIN_FILENAME, file->filename) ? NULL : file->filename, NULL,
+                                  XML_PARSE_NOBLANKS|XML_PARSE_NOCDATA|XML_PARSE_COMPACT);
+    if (!file->reader)
+    {
+        fprintf(stderr, "File Not Found: %s\n", file->filename);
+        file->read_failed = true;
+    }
+    else
+    {
+        if (1==xmlTextReaderNext(file->reader) && XML_READER_TYPE_DOCUMENT_TYPE==xmlTextReaderNodeType(file->reader) && //Skip DOCTYPE
+            1==xmlTextReaderNext(file->reader)) //Read DescriptorRecordSet or SupplementalRecordSet
+        {
+            if (g_import_supplemental)
+            {
+                ReadSupplementalRecordSet(*file);
+            }
+            else
+            {
+                ReadDescriptorRecordSet(*file);
+            }
+        }
+
+        xmlFreeTextReader(file->reader);
+        file->reader = NULL;
+    }
+    if (file->input.HasFailed())
+    {
+        file->read_failed = true;
+    }
+    file->input.Close();
+}
+
+bool ReadFiles(const std::vector<ImportFile*>& files)
+{
+    bool size_known = true;
+    bool opened = true;
+    std::vector<ImportFile*>::const_iterator file_iterator = files.begin();
+    for (; file_iterator!=files.end(); ++file_iterator)
+    {
+        opened = OpenFile(**file_iterator) && opened;
+        size_known = size_known && 0<(*file_iterator)->input.GetSize();
+        g_total_filesize += (*file_iterator)->input.GetSize(); //Compressed size, progress is counted in compressed bytes
+    }
+    if (!size_known)
+    {
+        g_total_filesize = 0;
+    }
+    if (!opened)
+        return false;
+
+    std::vector<std::thread> reader_threads;
+    for (file_iterator=files.begin(); file_iterator!=files.end(); ++file_iterator)
+    {
+        reader_threads.push_back(std::thread(ReadFile, *file_iterator));
+    }
+
+    bool ok = true;
+    for (size_t i=0; i<files.size(); i++)
+    {
+        reader_threads[i].join();
+        if (!files[i]->read_failed && !files[i]->has_record_set)
+        {
+            fprintf(stderr, "%s has no %s with a LanguageCode\n", files[i]->filename, g_import_supplemental ? "SupplementalRecordSet" : "DescriptorRecordSet");
+            files[i]->read_failed = true;
+        }
+        ok = ok && !files[i]->read_failed;
+        g_total_descriptor_count += files[i]->record_count;
+    }
+    return ok;
 }
 
-void PopulateChildrenTreeNumberList(Json::Array& children_tree_number_array, const std::string& tree_number)
+int ImportDescriptors(const char* es_location, ImportFile& topnodes_file, std::vector<ImportFile>& language_files, const std::vector<ImportFile*>& files)
+//Descriptors refer to each other through the hierarchy, so all files are read before anything is indexed
 {
-    std::stringstream query;
-    query << "{\"from\": 0, \"size\": 100, \"query\": {\"bool\": {\"must\": {\"term\": {\"parent_tree_numbers\": \"" << tree_number << "\"} } } } }";
+    bool read_ok;
+    {
+        PhaseTimer phase(g_metrics, "parse");
+        read_ok = ReadFiles(files);
+    }
 
-    Json::Object search_result;
-    if (0 == ESSearch("mesh", query.str(), search_result))
-        return;
-    
-    const Json::Value value = search_result.getValue("hits");
-    const Json::Object value_object = value.getObject();
+    if (read_ok)
+    {
+        std::vector<ImportFile*>::const_iterator file_iterator = files.begin();
+        for (; file_iterator!=files.end(); ++file_iterator)
+        {
+            printFileStatistics((*file_iterator)->filename, (*file_iterator)->language_code, (*file_iterator)->record_count);
+        }
+        fprintf(stdout, "\n");
+
+        std::vector<Descriptor>::iterator descriptor_iterator = topnodes_file.descriptors.begin();
+        for (; descriptor_iterator!=topnodes_file.descriptors.end(); ++descriptor_iterator)
+        {
+            AddDescriptor(*descriptor_iterator, false);
+        }
+        AddLanguageFiles(language_files);
+        printStatistics(g_total_descriptor_count, g_translated_descriptor_count);
+        if (1 < language_files.size())
+        {
+            printMergeStatistics(g_descriptors.size());
+        }
 
-    const Json::Value hits_value = value_object.getValue("hits");
-    const Json::Array hits_array = hits_value.getArray();
+        if (g_should_clean_database && CleanDatabase())
+        {
+            g_should_clean_database = false;
+        }
+    }
+    g_metrics.SetCount("descriptors", g_total_descriptor_count);
+    g_metrics.SetCount("translated", g_translated_descriptor_count);
 
-    Json::Array::const_iterator hits_iterator = hits_array.begin();
-    for (; hits_iterator!=hits_array.end(); ++hits_iterator)
+    int result = 0;
+    if (!read_ok) //Publishing part of a release would hide the rest of it
+    {
+        fprintf(stderr, "Input could not be read completely, nothing imported\n");
+        result = -1;
+    }
+    else if (g_should_clean_database) //Still set when the new index could not be created
+    {
+        fprintf(stderr, "Nothing imported\n");
+        result = -1;
+    }
+    else
     {
-        const Json::Value hit_value = *hits_iterator;
-        const Json::Object hit_value_object = hit_value.getObject();
-        const Json::Value source_value = hit_value_object.getValue("_source");
-        const Json::Object source_object = source_value.getObject();
+        CreateBulkIndexer(es_location);
+        CreateTermIndexer(es_location);
+
+        Manifest manifest;
+        IndexDescriptors(es_location, manifest); //All files are read, so the complete hierarchy is known
 
-        const Json::Value tree_numbers_value = source_object.getValue("tree_numbers");
-        const Json::Array tree_numbers_array = tree_numbers_value.getArray();
+        if (g_failed_ids_filename && !WriteFailedIds(g_failed_ids_filename))
+        {
+            fprintf(stderr, "Could not write failed ids %s\n", g_failed_ids_filename);
+        }
 
-        Json::Array::const_iterator tree_number_iterator = tree_numbers_array.begin();
-        for (; tree_number_iterator!=tree_numbers_array.end(); ++tree_number_iterator)
+        bool published = g_export_directory ? FinishExport() : (!g_versioned_index || PublishIndex());
+        bool terms_published = true; //Separately, the manifest and snapshot describe the descriptor index whatever happens to the terms
+        if (g_term_index && published) //Suggestions must lead to descriptors searches can see
+        {
+            terms_published = PublishTermIndex();
+        }
+        else if (g_update_terms && 0<g_term_indexer->GetFailedCount())
+        {
+            fprintf(stderr, "Some terms failed. Their descriptors are sent again by the next delta import\n");
+            terms_published = false;
+        }
+        if (g_manifest_filename && published) //The manifest must describe what searches see
         {
-            const Json::Value tree_number_value = *tree_number_iterator;
-            const std::string tree_number_str = tree_number_value.getString();
-            size_t substring_length = tree_number_str.find_last_of('.');
-            if ((std::string::npos==substring_length && g_should_read_topnodes_file && 0==tree_number_str.compare(0, 1, tree_number)) || //If we are forcing topnodes, a valid child of "D" could be "D01" (no dot..)
-                (std::string::npos!=substring_length && 0==tree_number_str.compare(0, substring_length, tree_number))) //For all other nodes, a parent "D01" should only have children "D01.*"
+            PhaseTimer phase(g_metrics, "manifest");
+            SaveManifest(manifest);
+        }
+        if (g_export_directory && g_snapshot_filename && published) //Bound to an index when the shards are loaded
+        {
+            PhaseTimer phase(g_metrics, "snapshot");
+            if (!WriteSnapshot(g_snapshot_filename, "", 0, g_descriptors, g_tree_index))
             {
-                Json::Value child_tree_number;
-                child_tree_number.setString(tree_number_str);
-                children_tree_number_array.addElement(child_tree_number);
+                fprintf(stderr, "Could not write snapshot %s\n", g_snapshot_filename);
             }
         }
+        else if (!g_export_directory && published)
+        {
+            UpdateSnapshot(es_location, !g_versioned_index && 0<g_bulk_indexer->GetIndexedCount()+g_bulk_indexer->GetFailedCount(),
+                           g_versioned_index || 0==g_bulk_indexer->GetFailedCount());
+        }
+        result = (published && terms_published) ? 0 : -1;
+
+        delete g_term_indexer;
+        delete g_term_index;
+        delete g_bulk_indexer;
     }
+    return result;
 }
 
-void UpdateChildTreeNumbers()
+int CompareReleases(std::vector<ImportFile>& release_files, const std::vector<ImportFile*>& files)
+//The old and the new release are read at the same time, each sorted into runs on disk, and merged by DescriptorUI
+//into the changelog. Memory holds a run per release, not the releases
 {
-    Json::Array resultArray;
-    std::string scroll_id;
-	int count = 0, updated_count = 0;
-    if (g_es->initScroll(scroll_id, "mesh", "", resultArray, 1))
+    ReleaseRuns old_release;
+    ReleaseRuns new_release;
+    release_files[0].release_runs = &old_release;
+    release_files[1].release_runs = &new_release;
+
+    bool read_ok;
     {
-        do
-        {
-            if (resultArray.empty())
-                break;
+        PhaseTimer phase(g_metrics, "parse");
+        read_ok = ReadFiles(files);
+        read_ok = old_release.Finish() && read_ok;
+        read_ok = new_release.Finish() && read_ok;
+    }
+    g_metrics.SetCount("descriptors", g_total_descriptor_count);
+    if (!read_ok)
+    {
+        fprintf(stderr, "Input could not be read completely, or a run could not be written to disk. No changelog written\n");
+        return -1;
+    }
 
-			count += resultArray.size();
+    std::vector<ImportFile*>::const_iterator file_iterator = files.begin();
+    for (; file_iterator!=files.end(); ++file_iterator)
+    {
+        printFileStatistics((*file_iterator)->filename, (*file_iterator)->language_code, (*file_iterator)->record_count);
+    }
+    fprintf(stdout, "\n\n");
 
-            Json::Array::const_iterator hits_iterator = resultArray.begin();
-            for (; hits_iterator!=resultArray.end(); ++hits_iterator)
-            {
-                const Json::Value hit_value = *hits_iterator;
-                const Json::Object hit_value_object = hit_value.getObject();
-                const Json::Value source_value = hit_value_object.getValue("_source");
-                const Json::Object source_object = source_value.getObject();
-
-                const Json::Value id_value = source_object.getValue("id");
-                const std::string id_value_str = id_value.getString();
-                if (id_value_str.empty())
-                    continue;
-
-                if (!source_object.member("tree_numbers"))
-                    continue;
-                
-                const Json::Value tree_numbers_value = source_object.getValue("tree_numbers");
-                const Json::Array tree_numbers_array = tree_numbers_value.getArray();
-
-                Json::Array children_tree_number_array;
-                Json::Array::const_iterator tree_number_iterator = tree_numbers_array.begin();
-                for (; tree_number_iterator!=tree_numbers_array.end(); ++tree_number_iterator)
-                {
-                    const Json::Value tree_number_value = *tree_number_iterator;
-                    PopulateChildrenTreeNumberList(children_tree_number_array, tree_number_value.getString());
-                }
+    ReleaseDiffCounts counts;
+    bool diff_ok;
+    {
+        PhaseTimer phase(g_metrics, "merge");
+        diff_ok = DiffReleases(old_release, new_release, release_files[0].filename, release_files[1].filename, g_changelog_filename, counts);
+    }
+    if (!diff_ok)
+    {
+        fprintf(stderr, "Could not write changelog %s\n", g_changelog_filename);
+        return -1;
+    }
 
-                if (!children_tree_number_array.empty())
-                {
-					updated_count += children_tree_number_array.size();
+    fprintf(stdout, "Sorted runs: %ld and %ld\nAdded descriptors: %ld\nRemoved descriptors: %ld\nRenamed descriptors: %ld\nMoved descriptors: %ld\n"
+                    "Otherwise changed descriptors: %ld\nUnchanged descriptors: %ld\n\n",
+            static_cast<long>(old_release.GetRunCount()), static_cast<long>(new_release.GetRunCount()),
+            counts.added, counts.removed, counts.renamed, counts.moved, counts.changed, counts.unchanged);
+    g_metrics.SetCount("added", counts.added);
+    g_metrics.SetCount("removed", counts.removed);
+    g_metrics.SetCount("renamed", counts.renamed);
+    g_metrics.SetCount("moved", counts.moved);
+    g_metrics.SetCount("changed", counts.changed);
+    return 0;
+}
 
-                    Json::Object updated_value_object;
-                    updated_value_object.addMemberByKey("child_tree_numbers", children_tree_number_array);
-                    g_es->update("mesh", id_value_str, updated_value_object);
-                }
+long GetStoredFileSize(const char* filename)
+{
+    struct stat filestat;
+    if (0==strcmp(STDIN_FILENAME, filename) || 0!=stat(filename, &filestat) || !S_ISREG(filestat.st_mode))
+        return 0;
+    return filestat.st_size;
+}
 
-                printUpdateChildNumbers(count, updated_count);
-            }
-            resultArray.clear();
-        } while (g_es->scrollNext(scroll_id, resultArray));
+void AcknowledgeRecord(const std::string& id, bool indexed)
+//Called by the sender threads. Saving here keeps the checkpoint current while the reader waits for the senders
+{
+    g_checkpoint.Acknowledge(id, indexed);
+    if (!g_checkpoint.SaveIfDue(g_checkpoint_filename))
+    {
+        fprintf(stderr, "\nCould not write checkpoint %s\n", g_checkpoint_filename);
     }
 }
 
-bool ReadDescriptorRecordSet()
-//<!ELEMENT DescriptorRecordSet (DescriptorRecord*)>
-//<!ATTLIST DescriptorRecordSet LanguageCode (cze|dut|eng|fin|fre|ger|ita|jpn|lav|por|scr|slv|spa) #REQUIRED>
+void StartCheckpoint(const std::vector<ImportFile*>& files)
 {
-	if (XML_READER_TYPE_ELEMENT!=xmlTextReaderNodeType(g_reader) || 0!=xmlStrcmp(BAD_CAST("DescriptorRecordSet"), xmlTextReaderConstName(g_reader)))
-		return false;
+    g_checkpoint.SetIndexName(g_index_name);
+    std::vector<ImportFile*>::const_iterator file_iterator = files.begin();
+    for (; file_iterator!=files.end(); ++file_iterator)
+    {
+        (*file_iterator)->checkpoint_file = g_checkpoint.AddFile((*file_iterator)->filename, GetStoredFileSize((*file_iterator)->filename));
+    }
+}
 
-    g_language_code = xmlStrdup(xmlTextReaderGetAttribute(g_reader, BAD_CAST("LanguageCode")));
-    if (!g_language_code)
+bool ResumeCheckpoint(const std::vector<ImportFile*>& files)
+//The files must be the ones the checkpoint was written for, in the same order
+{
+    if (g_checkpoint.GetFileCount() != files.size())
+    {
+        fprintf(stderr, "%s is for %lu files, not %lu\n", g_checkpoint_filename, (unsigned long)g_checkpoint.GetFileCount(), (unsigned long)files.size());
         return false;
+    }
 
-    if (g_should_clean_database)
+    //A --clean import goes on filling the version it created, which is published when it is complete
+    if (g_versioned_index && !g_versioned_index->Reopen(g_checkpoint.GetIndexName()))
+    {
+        fprintf(stderr, "Can not resume filling %s, it is not an unpublished version of %s that is still there\n", g_checkpoint.GetIndexName().c_str(), g_index_name.c_str());
+        return false;
+    }
+    if (g_versioned_index)
     {
-        CleanDatabase();
-        g_should_clean_database = false;
+        g_index_name = g_versioned_index->GetName();
+    }
+    else if (g_checkpoint.GetIndexName() != g_index_name)
+    {
+        fprintf(stderr, "%s is for %s, pass --clean to resume an import into a new version\n", g_checkpoint_filename, g_checkpoint.GetIndexName().c_str());
+        return false;
     }
 
-	if (1 != xmlTextReaderRead(g_reader)) //Skip to first DescriptorRecord
-		return false;
+    for (size_t i=0; i<files.size(); i++)
+    {
+        Checkpoint::FileProgress& progress = g_checkpoint.GetFile(i);
+        long size = GetStoredFileSize(files[i]->filename);
+        if (progress.filename!=files[i]->filename || (0<progress.size && 0<size && progress.size!=size))
+        {
+            fprintf(stderr, "%s is for %s (%ld bytes), not %s (%ld bytes)\n", g_checkpoint_filename, progress.filename.c_str(), progress.size, files[i]->filename, size);
+            return false;
+        }
 
-	bool more = true;
-	xmlNodePtr descriptor_record_ptr;
-	while (more &&
-	       NULL!=(descriptor_record_ptr=xmlTextReaderExpand(g_reader)) &&
-	       XML_ELEMENT_NODE==descriptor_record_ptr->type && 0==xmlStrcmp(BAD_CAST("DescriptorRecord"), descriptor_record_ptr->name)) //Read and parse current DescriptorRecord
-	{
-		ProcessDescriptorRecord(descriptor_record_ptr);
-		more = (1 == xmlTextReaderNext(g_reader)); //Skip to next DescriptorRecord
+        files[i]->checkpoint_file = i;
+        if (progress.last_id.empty()) //Nothing that can be found again was acknowledged
+        {
+            progress.records = 0;
+            continue;
+        }
+        files[i]->resume_id = progress.last_id;
+        files[i]->record_count = progress.records;
+        fprintf(stdout, "Resuming %s after %ld %s, the last was %s\n", files[i]->filename, progress.records, g_record_name, progress.last_id.c_str());
+    }
 
-		if (!more || 0==(g_total_descriptor_count%100))
-		{
-			printDescriptorStatus(g_total_descriptor_count);
-		}
-	}
+    return true;
+}
 
-    printDescriptorStatus(g_total_descriptor_count);
-    printStatistics(g_total_descriptor_count, g_translated_descriptor_count);
-    
-    if (!g_is_reading_topnodes_file)
+void FinishCheckpoint(bool complete)
+{
+    if (complete) //A later run starts over
     {
-        UpdateChildTreeNumbers();
+        remove(g_checkpoint_filename);
+    }
+    else if (g_checkpoint.Save(g_checkpoint_filename))
+    {
+        fprintf(stderr, "Progress is saved in %s, --resume continues from there\n", g_checkpoint_filename);
+    }
+    else
+    {
+        fprintf(stderr, "Could not write checkpoint %s\n", g_checkpoint_filename);
     }
-    
-	return true;
 }
 
-void Usage(const char* name)
+int ImportSupplementalRecords(const char* es_location, const std::vector<ImportFile*>& files)
+//Supplemental records only refer to descriptors, so they are indexed while they are read and memory stays flat
 {
-    fprintf(stderr, "Usage: %s <ElasticSearch-location> [--clean] [--topnodes <file>] <MeSH-file>\n\nExample: %s localhost:9200 ~/Downloads/nordesc2015.xml\n\n", name, name);
-}
+    if (g_resume)
+    {
+        if (!ResumeCheckpoint(files))
+        {
+            fprintf(stderr, "Nothing imported\n");
+            return -1;
+        }
+    }
+    else if (g_should_clean_database && !CleanSupplementalDatabase())
+    {
+        fprintf(stderr, "Nothing imported\n");
+        return -1;
+    }
+    else if (g_checkpoint_filename)
+    {
+        StartCheckpoint(files);
+    }
+    CreateBulkIndexer(es_location);
+    if (g_checkpoint_filename)
+    {
+        g_bulk_indexer->SetAcknowledgeCallback(AcknowledgeRecord);
+    }
 
-void ReadFile(const char* filename)
-{
-    struct stat filestat;
-    stat(filename, &filestat);
-    g_filesize = filestat.st_size;
+    bool read_ok;
+    {
+        PhaseTimer phase(g_metrics, "parse"); //Includes building and sending, which overlap with reading here
+        read_ok = ReadFiles(files);
+    }
+    {
+        PhaseTimer phase(g_metrics, "flush");
+        g_bulk_indexer->Flush();
+    }
 
-    g_reader = xmlReaderForFile(filename, NULL, XML_PARSE_NOBLANKS|XML_PARSE_NOCDATA|XML_PARSE_COMPACT);
-    if (!g_reader)
+    std::vector<ImportFile*>::const_iterator file_iterator = files.begin();
+    for (; file_iterator!=files.end(); ++file_iterator)
     {
-        fprintf(stderr, "File Not Found: %s\n", filename);
+        printFileStatistics((*file_iterator)->filename, (*file_iterator)->language_code, (*file_iterator)->record_count);
     }
-    else
+    fprintf(stdout, "\n\nTotal supplemental records: %ld\n\n", g_total_descriptor_count);
+    ReportIndexingStatistics();
+    g_metrics.SetCount("supplemental_records", g_total_descriptor_count);
+
+    if (g_failed_ids_filename && !WriteFailedIds(g_failed_ids_filename))
     {
-        if (1==xmlTextReaderNext(g_reader) && XML_READER_TYPE_DOCUMENT_TYPE==xmlTextReaderNodeType(g_reader) && //Skip DOCTYPE
-            1==xmlTextReaderNext(g_reader)) //Read DescriptorRecordSet
-        {
-            ReadDescriptorRecordSet();
-        }
+        fprintf(stderr, "Could not write failed ids %s\n", g_failed_ids_filename);
+    }
+
+    int result = 0;
+    if (!read_ok) //Without --clean, the records read so far are already live
+    {
+        fprintf(stderr, g_versioned_index ? "Input could not be read completely, nothing published\n" : "Input could not be read completely\n");
+        result = -1;
+    }
+    else if (g_versioned_index && !PublishIndex())
+    {
+        result = -1;
+    }
+    else if (g_export_directory && !FinishExport())
+    {
+        result = -1;
+    }
 
-        xmlFreeTextReader(g_reader);
+    if (g_checkpoint_filename)
+    {
+        FinishCheckpoint(0==result && 0==g_bulk_indexer->GetFailedCount());
     }
+    delete g_bulk_indexer;
+    return result;
 }
 
 int main(int argc, char **argv)
@@ -811,11 +2520,11 @@ int main(int argc, char **argv)
     }
 
 	LIBXML_TEST_VERSION
+    xmlInitParser(); //Before any converter threads are started
 
-	g_es = new ElasticSearch(argv[1]);
-    
-    const char* filename = NULL;
+    std::vector<const char*> filenames;
     const char* topnodes_filename = NULL;
+    g_worker_count = std::max(1, (int)std::thread::hardware_concurrency());
 
     int current_arg = 2;
     while(current_arg < argc)
@@ -825,6 +2534,56 @@ int main(int argc, char **argv)
             g_should_clean_database = true;
             current_arg++;
         }
+        else if (0==strcmp("--mmap", argv[current_arg]))
+        {
+            g_use_mapped_parser = true;
+            current_arg++;
+        }
+        else if (0==strcmp("--resume", argv[current_arg]))
+        {
+            g_resume = true;
+            current_arg++;
+        }
+        else if (0==strcmp("--rebuild-hierarchy", argv[current_arg]))
+        {
+            g_rebuild_hierarchy = true;
+            current_arg++;
+        }
+        else if (0==strcmp("--supplemental", argv[current_arg]))
+        {
+            g_import_supplemental = true;
+            g_record_name = "supplemental records";
+            g_index_name = SUPPLEMENTAL_INDEX_NAME;
+            current_arg++;
+        }
+        else if (0==strcmp("--replicas", argv[current_arg]) && current_arg<(argc-2) && 0<=(g_replicas=atoi(argv[current_arg+1])))
+        {
+            current_arg += 2;
+        }
+        else if (0==strcmp("--keep-versions", argv[current_arg]) && current_arg<(argc-2) && 0<=(g_keep_versions=atoi(argv[current_arg+1])))
+        {
+            current_arg += 2;
+        }
+        else if (0==strcmp("--snapshot", argv[current_arg]) && current_arg<(argc-2))
+        {
+            g_snapshot_filename = argv[current_arg+1];
+            current_arg += 2;
+        }
+        else if (0==strcmp("--metrics", argv[current_arg]) && current_arg<(argc-2))
+        {
+            g_metrics_filename = argv[current_arg+1];
+            current_arg += 2;
+        }
+        else if (0==strcmp("--prometheus", argv[current_arg]) && current_arg<(argc-2))
+        {
+            g_prometheus_filename = argv[current_arg+1];
+            current_arg += 2;
+        }
+        else if (0==strcmp("--delta", argv[current_arg]) && current_arg<(argc-2))
+        {
+            g_manifest_filename = argv[current_arg+1];
+            current_arg += 2;
+        }
         else if (0==strcmp("--topnodes", argv[current_arg]) && current_arg<(argc-2))
         {
             current_arg++;
@@ -832,10 +2591,67 @@ int main(int argc, char **argv)
             current_arg++;
             g_should_read_topnodes_file = true;
         }
-        else if (current_arg == (argc-1))
+        else if (0==strcmp("--bulk-documents", argv[current_arg]) && current_arg<(argc-2) && 0<(g_bulk_documents=atol(argv[current_arg+1])))
         {
-            filename = argv[current_arg];
-            break;
+            current_arg += 2;
+        }
+        else if (0==strcmp("--bulk-bytes", argv[current_arg]) && current_arg<(argc-2) && 0<(g_bulk_bytes=atol(argv[current_arg+1])))
+        {
+            current_arg += 2;
+        }
+        else if (0==strcmp("--bulk-retries", argv[current_arg]) && current_arg<(argc-2) && 0<=(g_bulk_retries=atoi(argv[current_arg+1])))
+        {
+            current_arg += 2;
+        }
+        else if (0==strcmp("--bulk-latency", argv[current_arg]) && current_arg<(argc-2) && 0<(g_bulk_latency=atol(argv[current_arg+1])))
+        {
+            current_arg += 2;
+        }
+        else if (0==strcmp("--in-flight-bytes", argv[current_arg]) && current_arg<(argc-2) && 0<(g_in_flight_bytes=atol(argv[current_arg+1])))
+        {
+            current_arg += 2;
+        }
+        else if (0==strcmp("--emit-ndjson", argv[current_arg]) && current_arg<(argc-2))
+        {
+            g_export_directory = argv[current_arg+1];
+            current_arg += 2;
+        }
+        else if (0==strcmp("--load-ndjson", argv[current_arg]) && current_arg<(argc-1))
+        {
+            g_load_directory = argv[current_arg+1];
+            current_arg += 2;
+        }
+        else if (0==strcmp("--checkpoint", argv[current_arg]) && current_arg<(argc-2))
+        {
+            g_checkpoint_filename = argv[current_arg+1];
+            current_arg += 2;
+        }
+        else if (0==strcmp("--diff", argv[current_arg]) && current_arg<(argc-2))
+        {
+            g_changelog_filename = argv[current_arg+1];
+            current_arg += 2;
+        }
+        else if (0==strcmp("--failed-ids", argv[current_arg]) && current_arg<(argc-2))
+        {
+            g_failed_ids_filename = argv[current_arg+1];
+            current_arg += 2;
+        }
+        else if (0==strcmp("--threads", argv[current_arg]) && current_arg<(argc-2) && 0<(g_worker_count=atoi(argv[current_arg+1])))
+        {
+            current_arg += 2;
+        }
+        else if (0==strcmp("--senders", argv[current_arg]) && current_arg<(argc-2) && 0<(g_sender_count=atoi(argv[current_arg+1])))
+        {
+            current_arg += 2;
+        }
+        else if (0==strcmp("--queue-size", argv[current_arg]) && current_arg<(argc-2) && 0<(g_queue_size=atol(argv[current_arg+1])))
+        {
+            current_arg += 2;
+        }
+        else if ('-'!=argv[current_arg][0] || 0==strcmp(STDIN_FILENAME, argv[current_arg]))
+        {
+            filenames.push_back(argv[current_arg]);
+            current_arg++;
         }
         else
         {
@@ -844,19 +2660,150 @@ int main(int argc, char **argv)
         }
     }
 
+    if (filenames.empty() == !(g_load_directory || g_rebuild_hierarchy)) //--load-ndjson reads shards and --rebuild-hierarchy the index instead of MeSH files
+    {
+        Usage(argv[0]);
+        return -1;
+    }
+
+    if (g_rebuild_hierarchy && (g_load_directory || g_export_directory || g_should_clean_database || g_import_supplemental || g_manifest_filename ||
+                                g_should_read_topnodes_file || g_checkpoint_filename))
+    {
+        fprintf(stderr, "--rebuild-hierarchy updates the mesh index in place from what it holds, and takes no other import options than the bulk and thread settings and --snapshot\n");
+        return -1;
+    }
+
+    if (g_changelog_filename && (2!=filenames.size() || g_load_directory || g_export_directory || g_should_clean_database || g_import_supplemental ||
+                                 g_manifest_filename || g_snapshot_filename || g_should_read_topnodes_file || g_checkpoint_filename || g_rebuild_hierarchy))
+    {
+        fprintf(stderr, "--diff compares two descriptor files, the old release first, and writes the changelog without contacting Elasticsearch. It takes no other import options than the thread settings and --mmap\n");
+        return -1;
+    }
+
+    if (g_export_directory && (g_load_directory || g_should_clean_database || g_manifest_filename))
+    {
+        fprintf(stderr, "--emit-ndjson does not contact Elasticsearch, so --load-ndjson, --clean and --delta do not apply. Pass --clean when loading\n");
+        return -1;
+    }
+    if (g_load_directory && (g_import_supplemental || g_manifest_filename || g_should_read_topnodes_file))
+    {
+        fprintf(stderr, "--supplemental, --delta and --topnodes apply when the shards are written, not when they are loaded\n");
+        return -1;
+    }
+
+    if (g_import_supplemental && (g_manifest_filename || g_snapshot_filename || g_should_read_topnodes_file))
+    {
+        fprintf(stderr, "--delta, --snapshot and --topnodes only apply to descriptor files\n");
+        return -1;
+    }
+    if (g_resume && !g_checkpoint_filename)
+    {
+        fprintf(stderr, "--resume continues from the --checkpoint file\n");
+        return -1;
+    }
+    if (g_checkpoint_filename && (!g_import_supplemental || g_export_directory))
+    {
+        fprintf(stderr, "--checkpoint only applies to --supplemental imports into Elasticsearch. Descriptors are all read before any is sent, --delta makes a rerun send only what changed\n");
+        return -1;
+    }
+    if (g_resume && !g_checkpoint.Load(g_checkpoint_filename))
+    {
+        fprintf(stderr, "Could not read checkpoint %s\n", g_checkpoint_filename);
+        return -1;
+    }
+
+    if (g_import_supplemental && g_use_mapped_parser)
+    {
+        fprintf(stderr, "--mmap only reads descriptor files, streaming the supplemental records instead\n");
+    }
+
+    //--clean starts from an empty index, so every descriptor is sent and the manifest is rebuilt
+    if (g_manifest_filename && !g_should_clean_database && !g_previous_manifest.Load(g_manifest_filename))
+    {
+        fprintf(stderr, "Could not read manifest %s\n", g_manifest_filename);
+        return -1;
+    }
+
+    if (g_load_directory && !ReadExportIndexName(g_load_directory))
+    {
+        fprintf(stderr, "%s has no complete --emit-ndjson export\n", g_load_directory);
+        return -1;
+    }
+    if (g_load_directory && g_import_supplemental && g_snapshot_filename)
+    {
+        fprintf(stderr, "--snapshot only applies to descriptor shards\n");
+        return -1;
+    }
+    if (g_export_directory && (!PrepareExportDirectory(g_export_directory) ||
+                               (!g_import_supplemental && !PrepareExportDirectory(TermExportDirectory(g_export_directory).c_str()))))
+    {
+        fprintf(stderr, "Could not prepare %s for the shards\n", g_export_directory);
+        return -1;
+    }
+
+    if (!g_export_directory && !g_changelog_filename)
+    {
+        g_es = new ElasticSearch(argv[1]);
+    }
+    if (g_should_clean_database)
+    {
+        g_versioned_index = new VersionedIndex(argv[1], g_index_name);
+    }
+
+    //All files are read at the same time, each with its share of the worker threads
+    ImportFile topnodes_file;
+    std::vector<ImportFile> language_files(filenames.size());
+    std::vector<ImportFile*> files;
     if (g_should_read_topnodes_file)
     {
-        g_is_reading_topnodes_file = true;
-        ReadFile(topnodes_filename);
-        g_is_reading_topnodes_file = false;
+        topnodes_file.filename = topnodes_filename;
+        files.push_back(&topnodes_file);
+    }
+    for (size_t i=0; i<filenames.size(); i++)
+    {
+        language_files[i].filename = filenames[i];
+        language_files[i].topnodes_forced = g_should_read_topnodes_file;
+        language_files[i].worker_count = std::max(1, g_worker_count/static_cast<int>(filenames.size()));
+        files.push_back(&language_files[i]);
     }
 
-    ReadFile(filename);
+    int result = 0;
+    if (g_load_directory)
+    {
+        result = LoadShards(argv[1]);
+    }
+    else if (g_rebuild_hierarchy)
+    {
+        result = RebuildHierarchy(argv[1]);
+    }
+    else if (g_changelog_filename)
+    {
+        result = CompareReleases(language_files, files);
+    }
+    else if (g_import_supplemental)
+    {
+        result = ImportSupplementalRecords(argv[1], files);
+    }
+    else
+    {
+        result = ImportDescriptors(argv[1], topnodes_file, language_files, files);
+    }
 
-    xmlFree(g_language_code);
+    //Written for failed imports too, so a nightly run that stopped early is visible
+    g_metrics.SetSucceeded(0 == result);
+    g_metrics.PrintPhaseTimes(stdout);
+    if (g_metrics_filename && !g_metrics.WriteJson(g_metrics_filename))
+    {
+        fprintf(stderr, "Could not write metrics %s\n", g_metrics_filename);
+    }
+    if (g_prometheus_filename && !g_metrics.WritePrometheus(g_prometheus_filename))
+    {
+        fprintf(stderr, "Could not write metrics %s\n", g_prometheus_filename);
+    }
 
     xmlCleanupParser();
+	delete g_versioned_index;
 	delete g_es;
 	
-    return 0;
+    return result;
 }
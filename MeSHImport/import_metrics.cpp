@@ -0,0 +1,336 @@
+#include "import_metrics.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+//Upper bounds in seconds for the Elasticsearch request latency histogram
+static const double LATENCY_BUCKETS[] = {0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0};
+static const size_t LATENCY_BUCKET_COUNT = sizeof(LATENCY_BUCKETS)/sizeof(LATENCY_BUCKETS[0]);
+
+#define PROGRESS_SAMPLE_SECONDS (1.0)
+
+
+ImportMetrics::RequestStats::RequestStats()
+: failed(0),
+  retries(0),
+  bytes_sent(0),
+  buckets(LATENCY_BUCKET_COUNT+1, 0)
+{
+}
+
+ImportMetrics::ImportMetrics()
+: m_start(Clock::now()),
+  m_start_time(time(NULL)),
+  m_succeeded(false)
+{
+}
+
+void ImportMetrics::AddPhaseTime(const std::string& phase, double seconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::pair<std::string, double> >::iterator phase_iterator = m_phases.begin();
+    for (; phase_iterator!=m_phases.end(); ++phase_iterator)
+    {
+        if (phase_iterator->first == phase)
+        {
+            phase_iterator->second += seconds; //The topnodes file and the MeSH file are both parsed
+            return;
+        }
+    }
+    m_phases.push_back(std::make_pair(phase, seconds));
+}
+
+void ImportMetrics::AddWorkerTime(const std::string& stage, double seconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_worker_seconds[stage] += seconds;
+}
+
+void ImportMetrics::AddRequest(const std::string& endpoint, double seconds, long bytes_sent, bool ok)
+{
+    size_t bucket = std::upper_bound(LATENCY_BUCKETS, LATENCY_BUCKETS+LATENCY_BUCKET_COUNT, seconds) - LATENCY_BUCKETS;
+    if (0<bucket && LATENCY_BUCKETS[bucket-1]==seconds) //Prometheus buckets include their upper bound
+    {
+        bucket--;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RequestStats& stats = m_requests[endpoint];
+    stats.latencies.push_back(seconds);
+    stats.buckets[bucket]++;
+    stats.bytes_sent += bytes_sent;
+    if (!ok)
+    {
+        stats.failed++;
+    }
+}
+
+void ImportMetrics::AddRetry(const std::string& endpoint)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_requests[endpoint].retries++;
+}
+
+void ImportMetrics::SampleProgress(const std::string& phase, long records)
+{
+    double seconds = GetElapsedSeconds();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const ProgressSample* previous = NULL;
+    std::vector<ProgressSample>::const_reverse_iterator sample_iterator = m_progress.rbegin();
+    for (; sample_iterator!=m_progress.rend(); ++sample_iterator)
+    {
+        if (sample_iterator->phase == phase)
+        {
+            previous = &*sample_iterator;
+            break;
+        }
+    }
+    if (previous && (seconds-previous->seconds)<PROGRESS_SAMPLE_SECONDS)
+        return;
+
+    ProgressSample sample;
+    sample.phase = phase;
+    sample.seconds = seconds;
+    sample.records = records;
+    sample.records_per_second = 0.0;
+    if (previous && seconds>previous->seconds)
+    {
+        sample.records_per_second = (records-previous->records)/(seconds-previous->seconds);
+    }
+    m_progress.push_back(sample);
+}
+
+void ImportMetrics::SetCount(const std::string& name, long value)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::pair<std::string, long> >::iterator count_iterator = m_counts.begin();
+    for (; count_iterator!=m_counts.end(); ++count_iterator)
+    {
+        if (count_iterator->first == name)
+        {
+            count_iterator->second = value;
+            return;
+        }
+    }
+    m_counts.push_back(std::make_pair(name, value));
+}
+
+double ImportMetrics::GetElapsedSeconds() const
+{
+    return SecondsSince(m_start);
+}
+
+void ImportMetrics::PrintPhaseTimes(FILE* file) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    fprintf(file, "Phase times:");
+    std::vector<std::pair<std::string, double> >::const_iterator phase_iterator = m_phases.begin();
+    for (; phase_iterator!=m_phases.end(); ++phase_iterator)
+    {
+        fprintf(file, " %s %0.2fs", phase_iterator->first.c_str(), phase_iterator->second);
+    }
+    fprintf(file, "\nTotal time: %0.2fs (%0.0f records/s)\n\n", GetElapsedSeconds(), GetRecordsPerSecond());
+    fflush(file);
+}
+
+bool ImportMetrics::WriteJson(const char* filename) const
+{
+    std::string temporary_filename = std::string(filename) + ".tmp";
+    FILE* file = fopen(temporary_filename.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    char started[sizeof("YYYY-MM-DDThh:mm:ssZ")];
+    struct tm start_tm;
+    strftime(started, sizeof(started), "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&m_start_time, &start_tm));
+    fprintf(file, "{\n \"started\": \"%s\",\n \"seconds\": %0.3f,\n \"succeeded\": %s,\n \"records_per_second\": %0.1f,\n",
+            started, GetElapsedSeconds(), m_succeeded ? "true" : "false", GetRecordsPerSecond());
+
+    fprintf(file, " \"counts\": {");
+    std::vector<std::pair<std::string, long> >::const_iterator count_iterator = m_counts.begin();
+    for (; count_iterator!=m_counts.end(); ++count_iterator)
+    {
+        fprintf(file, "%s\"%s\": %ld", count_iterator==m_counts.begin() ? "" : ", ", count_iterator->first.c_str(), count_iterator->second);
+    }
+
+    fprintf(file, "},\n \"phase_seconds\": {");
+    std::vector<std::pair<std::string, double> >::const_iterator phase_iterator = m_phases.begin();
+    for (; phase_iterator!=m_phases.end(); ++phase_iterator)
+    {
+        fprintf(file, "%s\"%s\": %0.3f", phase_iterator==m_phases.begin() ? "" : ", ", phase_iterator->first.c_str(), phase_iterator->second);
+    }
+
+    fprintf(file, "},\n \"worker_seconds\": {");
+    std::map<std::string, double>::const_iterator worker_iterator = m_worker_seconds.begin();
+    for (; worker_iterator!=m_worker_seconds.end(); ++worker_iterator)
+    {
+        fprintf(file, "%s\"%s\": %0.3f", worker_iterator==m_worker_seconds.begin() ? "" : ", ", worker_iterator->first.c_str(), worker_iterator->second);
+    }
+
+    fprintf(file, "},\n \"elasticsearch\": {");
+    std::map<std::string, RequestStats>::const_iterator request_iterator = m_requests.begin();
+    for (; request_iterator!=m_requests.end(); ++request_iterator)
+    {
+        const RequestStats& stats = request_iterator->second;
+        fprintf(file, "%s\n  \"%s\": {\"requests\": %ld, \"failed\": %ld, \"retries\": %ld, \"bytes_sent\": %ld, "
+                "\"p50_ms\": %0.1f, \"p95_ms\": %0.1f, \"p99_ms\": %0.1f, \"max_ms\": %0.1f, \"buckets\": [",
+                request_iterator==m_requests.begin() ? "" : ",", request_iterator->first.c_str(),
+                (long)stats.latencies.size(), stats.failed, stats.retries, stats.bytes_sent,
+                Percentile(stats.latencies, 0.50)*1000.0, Percentile(stats.latencies, 0.95)*1000.0,
+                Percentile(stats.latencies, 0.99)*1000.0, Percentile(stats.latencies, 1.0)*1000.0);
+        for (size_t i=0; i<=LATENCY_BUCKET_COUNT; i++)
+        {
+            if (i < LATENCY_BUCKET_COUNT)
+                fprintf(file, "%s{\"le\": %g, \"count\": %ld}", 0==i ? "" : ", ", LATENCY_BUCKETS[i], stats.buckets[i]);
+            else
+                fprintf(file, ", {\"le\": \"+Inf\", \"count\": %ld}", stats.buckets[i]);
+        }
+        fprintf(file, "]}");
+    }
+
+    fprintf(file, "%s},\n \"progress\": [", m_requests.empty() ? "" : "\n ");
+    std::vector<ProgressSample>::const_iterator sample_iterator = m_progress.begin();
+    for (; sample_iterator!=m_progress.end(); ++sample_iterator)
+    {
+        fprintf(file, "%s\n  {\"phase\": \"%s\", \"seconds\": %0.3f, \"records\": %ld, \"records_per_second\": %0.1f}",
+                sample_iterator==m_progress.begin() ? "" : ",", sample_iterator->phase.c_str(),
+                sample_iterator->seconds, sample_iterator->records, sample_iterator->records_per_second);
+    }
+    fprintf(file, "%s]\n}\n", m_progress.empty() ? "" : "\n ");
+
+    bool ok = (0 == fclose(file));
+    return ok && 0==rename(temporary_filename.c_str(), filename);
+}
+
+bool ImportMetrics::WritePrometheus(const char* filename) const
+{
+    //The textfile collector may read at any time, so write next to the file and rename
+    std::string temporary_filename = std::string(filename) + ".tmp";
+    FILE* file = fopen(temporary_filename.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    fprintf(file, "# HELP mesh_import_success Whether the last import completed and was published.\n"
+                  "# TYPE mesh_import_success gauge\n"
+                  "mesh_import_success %d\n", m_succeeded ? 1 : 0);
+    fprintf(file, "# HELP mesh_import_last_run_timestamp_seconds When the last import started.\n"
+                  "# TYPE mesh_import_last_run_timestamp_seconds gauge\n"
+                  "mesh_import_last_run_timestamp_seconds %ld\n", (long)m_start_time);
+    fprintf(file, "# HELP mesh_import_duration_seconds Wall-clock time of the last import.\n"
+                  "# TYPE mesh_import_duration_seconds gauge\n"
+                  "mesh_import_duration_seconds %0.3f\n", GetElapsedSeconds());
+    fprintf(file, "# HELP mesh_import_records_per_second Descriptors imported per second over the whole import.\n"
+                  "# TYPE mesh_import_records_per_second gauge\n"
+                  "mesh_import_records_per_second %0.1f\n", GetRecordsPerSecond());
+
+    fprintf(file, "# HELP mesh_import_phase_seconds Wall-clock time per import phase.\n"
+                  "# TYPE mesh_import_phase_seconds gauge\n");
+    std::vector<std::pair<std::string, double> >::const_iterator phase_iterator = m_phases.begin();
+    for (; phase_iterator!=m_phases.end(); ++phase_iterator)
+    {
+        fprintf(file, "mesh_import_phase_seconds{phase=\"%s\"} %0.3f\n", phase_iterator->first.c_str(), phase_iterator->second);
+    }
+
+    fprintf(file, "# HELP mesh_import_worker_seconds Time summed over the worker threads of a stage.\n"
+                  "# TYPE mesh_import_worker_seconds gauge\n");
+    std::map<std::string, double>::const_iterator worker_iterator = m_worker_seconds.begin();
+    for (; worker_iterator!=m_worker_seconds.end(); ++worker_iterator)
+    {
+        fprintf(file, "mesh_import_worker_seconds{stage=\"%s\"} %0.3f\n", worker_iterator->first.c_str(), worker_iterator->second);
+    }
+
+    fprintf(file, "# HELP mesh_import_documents Descriptors and documents handled by the last import.\n"
+                  "# TYPE mesh_import_documents gauge\n");
+    std::vector<std::pair<std::string, long> >::const_iterator count_iterator = m_counts.begin();
+    for (; count_iterator!=m_counts.end(); ++count_iterator)
+    {
+        fprintf(file, "mesh_import_documents{kind=\"%s\"} %ld\n", count_iterator->first.c_str(), count_iterator->second);
+    }
+
+    fprintf(file, "# HELP mesh_import_es_request_duration_seconds Elasticsearch request latency.\n"
+                  "# TYPE mesh_import_es_request_duration_seconds histogram\n");
+    std::map<std::string, RequestStats>::const_iterator request_iterator = m_requests.begin();
+    for (; request_iterator!=m_requests.end(); ++request_iterator)
+    {
+        const char* endpoint = request_iterator->first.c_str();
+        const RequestStats& stats = request_iterator->second;
+        long cumulative = 0;
+        for (size_t i=0; i<LATENCY_BUCKET_COUNT; i++)
+        {
+            cumulative += stats.buckets[i];
+            fprintf(file, "mesh_import_es_request_duration_seconds_bucket{endpoint=\"%s\",le=\"%g\"} %ld\n", endpoint, LATENCY_BUCKETS[i], cumulative);
+        }
+        double sum = 0.0;
+        std::vector<double>::const_iterator latency_iterator = stats.latencies.begin();
+        for (; latency_iterator!=stats.latencies.end(); ++latency_iterator)
+        {
+            sum += *latency_iterator;
+        }
+        fprintf(file, "mesh_import_es_request_duration_seconds_bucket{endpoint=\"%s\",le=\"+Inf\"} %ld\n", endpoint, (long)stats.latencies.size());
+        fprintf(file, "mesh_import_es_request_duration_seconds_sum{endpoint=\"%s\"} %0.6f\n", endpoint, sum);
+        fprintf(file, "mesh_import_es_request_duration_seconds_count{endpoint=\"%s\"} %ld\n", endpoint, (long)stats.latencies.size());
+    }
+
+    fprintf(file, "# HELP mesh_import_es_failed_requests Elasticsearch requests that failed.\n"
+                  "# TYPE mesh_import_es_failed_requests gauge\n");
+    for (request_iterator=m_requests.begin(); request_iterator!=m_requests.end(); ++request_iterator)
+    {
+        fprintf(file, "mesh_import_es_failed_requests{endpoint=\"%s\"} %ld\n", request_iterator->first.c_str(), request_iterator->second.failed);
+    }
+    fprintf(file, "# HELP mesh_import_es_retries Elasticsearch requests that were sent again.\n"
+                  "# TYPE mesh_import_es_retries gauge\n");
+    for (request_iterator=m_requests.begin(); request_iterator!=m_requests.end(); ++request_iterator)
+    {
+        fprintf(file, "mesh_import_es_retries{endpoint=\"%s\"} %ld\n", request_iterator->first.c_str(), request_iterator->second.retries);
+    }
+    fprintf(file, "# HELP mesh_import_es_bytes_sent Request bytes sent to Elasticsearch.\n"
+                  "# TYPE mesh_import_es_bytes_sent gauge\n");
+    for (request_iterator=m_requests.begin(); request_iterator!=m_requests.end(); ++request_iterator)
+    {
+        fprintf(file, "mesh_import_es_bytes_sent{endpoint=\"%s\"} %ld\n", request_iterator->first.c_str(), request_iterator->second.bytes_sent);
+    }
+
+    bool ok = (0 == fclose(file));
+    return ok && 0==rename(temporary_filename.c_str(), filename);
+}
+
+double ImportMetrics::SecondsSince(const Clock::time_point& start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double ImportMetrics::GetRecordsPerSecond() const
+{
+    //Records read from MeSH files, or documents sent when loading shards, which has none
+    double seconds = GetElapsedSeconds();
+    long records = 0;
+    std::vector<std::pair<std::string, long> >::const_iterator count_iterator = m_counts.begin();
+    for (; count_iterator!=m_counts.end(); ++count_iterator)
+    {
+        if (count_iterator->first == "descriptors" || count_iterator->first == "supplemental_records")
+        {
+            records = count_iterator->second;
+            break;
+        }
+        if (count_iterator->first == "indexed")
+        {
+            records = count_iterator->second;
+        }
+    }
+    return 0.0<seconds ? records/seconds : 0.0;
+}
+
+double ImportMetrics::Percentile(std::vector<double> latencies, double percentile)
+{
+    if (latencies.empty())
+        return 0.0;
+
+    //Nearest rank
+    size_t rank = std::max(static_cast<size_t>(1), static_cast<size_t>(ceil(percentile*latencies.size())));
+    std::nth_element(latencies.begin(), latencies.begin()+(rank-1), latencies.end());
+    return latencies[rank-1];
+}
@@ -0,0 +1,93 @@
+#ifndef _IMPORT_METRICS_H_
+#define _IMPORT_METRICS_H_
+
+#include <stdio.h>
+#include <time.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Timings and counters for one import, written as a JSON summary and as a
+// Prometheus textfile for the node exporter's textfile collector.
+// Phases are wall-clock time. Worker time is summed over the threads of a
+// stage, so it shows where the CPU went even while stages overlap.
+// All methods may be called from several threads.
+class ImportMetrics
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    ImportMetrics();
+
+public:
+    void AddPhaseTime(const std::string& phase, double seconds);
+    void AddWorkerTime(const std::string& stage, double seconds); //"convert" for parsing records, "serialize" for building documents
+    void AddRequest(const std::string& endpoint, double seconds, long bytes_sent, bool ok);
+    void AddRetry(const std::string& endpoint);
+    void SampleProgress(const std::string& phase, long records); //Keeps at most one sample per phase and second
+
+    void SetCount(const std::string& name, long value);
+    void SetSucceeded(bool succeeded) {m_succeeded = succeeded;}
+
+    double GetElapsedSeconds() const;
+    void PrintPhaseTimes(FILE* file) const;
+
+    bool WriteJson(const char* filename) const;
+    bool WritePrometheus(const char* filename) const;
+
+    static double SecondsSince(const Clock::time_point& start);
+
+private:
+    struct RequestStats
+    {
+        RequestStats();
+
+        std::vector<double> latencies; //Seconds, kept for exact percentiles
+        long failed;
+        long retries;
+        long bytes_sent;
+        std::vector<long> buckets; //Not cumulative, one per LATENCY_BUCKETS bound and one for +Inf
+    };
+
+    struct ProgressSample
+    {
+        std::string phase;
+        double seconds;
+        long records;
+        double records_per_second; //Since the previous sample of the phase
+    };
+
+    double GetRecordsPerSecond() const;
+    static double Percentile(std::vector<double> latencies, double percentile);
+
+private:
+    Clock::time_point m_start;
+    time_t m_start_time;
+    bool m_succeeded;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::pair<std::string, double> > m_phases; //In the order they first ran
+    std::map<std::string, double> m_worker_seconds;
+    std::map<std::string, RequestStats> m_requests;
+    std::vector<std::pair<std::string, long> > m_counts;
+    std::vector<ProgressSample> m_progress;
+};
+
+// Adds the lifetime of the scope to a phase
+class PhaseTimer
+{
+public:
+    PhaseTimer(ImportMetrics& metrics, const char* phase) : m_metrics(metrics), m_phase(phase), m_start(ImportMetrics::Clock::now()) {}
+    ~PhaseTimer() {m_metrics.AddPhaseTime(m_phase, ImportMetrics::SecondsSince(m_start));}
+
+private:
+    ImportMetrics& m_metrics;
+    const char* m_phase;
+    ImportMetrics::Clock::time_point m_start;
+};
+
+#endif // _IMPORT_METRICS_H_
@@ -0,0 +1,254 @@
+#include "input_stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+
+
+static const unsigned char GZIP_MAGIC[] = {0x1F, 0x8B};
+static const unsigned char ZSTD_MAGIC[] = {0x28, 0xB5, 0x2F, 0xFD};
+
+
+InputStream::InputStream()
+: m_fd(-1),
+  m_size(0),
+  m_bytes_consumed(0),
+  m_compression(COMPRESSION_NONE),
+  m_end_of_file(false),
+  m_in_frame(false),
+  m_failed(false),
+  m_input(new unsigned char[INPUT_BUFFER_SIZE]),
+  m_input_position(0),
+  m_input_length(0),
+  m_decompressor(NULL)
+{
+}
+
+InputStream::~InputStream()
+{
+    Close();
+    delete[] m_input;
+}
+
+bool InputStream::Open(const char* filename)
+{
+    Close();
+
+    m_fd = (0 == strcmp(STDIN_FILENAME, filename)) ? STDIN_FILENO : open(filename, O_RDONLY);
+    if (-1 == m_fd)
+        return false;
+
+    struct stat filestat;
+    if (0==fstat(m_fd, &filestat) && S_ISREG(filestat.st_mode))
+    {
+        m_size = filestat.st_size;
+    }
+
+    //Read until we can tell the format. A pipe may deliver less than the magic in one read
+    while (m_input_length<sizeof(ZSTD_MAGIC) && !m_end_of_file)
+    {
+        if (!FillInput())
+        {
+            Close();
+            return false;
+        }
+    }
+
+    if (m_input_length>=sizeof(GZIP_MAGIC) && 0==memcmp(m_input, GZIP_MAGIC, sizeof(GZIP_MAGIC)))
+    {
+        z_stream* stream = new z_stream;
+        memset(stream, 0, sizeof(z_stream));
+        if (Z_OK != inflateInit2(stream, 15+16)) //gzip header only
+        {
+            delete stream;
+            Close();
+            return false;
+        }
+        m_decompressor = stream;
+        m_compression = COMPRESSION_GZIP;
+    }
+    else if (m_input_length>=sizeof(ZSTD_MAGIC) && 0==memcmp(m_input, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)))
+    {
+#ifdef HAVE_ZSTD
+        m_decompressor = ZSTD_createDStream();
+        if (!m_decompressor)
+        {
+            Close();
+            return false;
+        }
+        m_compression = COMPRESSION_ZSTD;
+#else
+        fprintf(stderr, "%s is zstd compressed, but MeSHImport is built without zstd support\n", filename);
+        Close();
+        return false;
+#endif
+    }
+    return true;
+}
+
+void InputStream::Close()
+{
+    if (COMPRESSION_GZIP == m_compression)
+    {
+        z_stream* stream = static_cast<z_stream*>(m_decompressor);
+        inflateEnd(stream);
+        delete stream;
+    }
+#ifdef HAVE_ZSTD
+    else if (COMPRESSION_ZSTD == m_compression)
+    {
+        ZSTD_freeDStream(static_cast<ZSTD_DStream*>(m_decompressor));
+    }
+#endif
+    m_decompressor = NULL;
+    m_compression = COMPRESSION_NONE;
+
+    if (-1!=m_fd && STDIN_FILENO!=m_fd)
+    {
+        close(m_fd);
+    }
+    m_fd = -1;
+    m_size = 0;
+    m_bytes_consumed = 0;
+    m_end_of_file = false;
+    m_in_frame = false;
+    m_failed = false;
+    m_input_position = 0;
+    m_input_length = 0;
+}
+
+int InputStream::Read(char* buffer, int length)
+{
+    if (-1==m_fd || 0>=length || m_failed)
+        return -1;
+
+    if (COMPRESSION_GZIP == m_compression)
+        return ReadGzip(buffer, length);
+
+    if (COMPRESSION_ZSTD == m_compression)
+        return ReadZstd(buffer, length);
+
+    if (m_input_position==m_input_length && !m_end_of_file && !FillInput())
+        return Fail(strerror(errno));
+
+    size_t count = std::min(static_cast<size_t>(length), m_input_length-m_input_position);
+    memcpy(buffer, m_input+m_input_position, count);
+    m_input_position += count;
+    m_bytes_consumed += count;
+    return count;
+}
+
+bool InputStream::FillInput()
+{
+    if (m_input_position == m_input_length)
+    {
+        m_input_position = 0;
+        m_input_length = 0;
+    }
+
+    ssize_t count;
+    do
+    {
+        count = read(m_fd, m_input+m_input_length, INPUT_BUFFER_SIZE-m_input_length);
+    } while (-1==count && EINTR==errno);
+
+    if (-1 == count)
+        return false;
+
+    if (0 == count)
+    {
+        m_end_of_file = true;
+    }
+    m_input_length += count;
+    return true;
+}
+
+int InputStream::Fail(const char* reason)
+{
+    fprintf(stderr, "\nCould not read input: %s\n", reason);
+    m_failed = true;
+    return -1;
+}
+
+int InputStream::ReadGzip(char* buffer, int length)
+{
+    z_stream* stream = static_cast<z_stream*>(m_decompressor);
+    stream->next_out = reinterpret_cast<Bytef*>(buffer);
+    stream->avail_out = length;
+
+    while (stream->avail_out == static_cast<uInt>(length))
+    {
+        if (m_input_position==m_input_length)
+        {
+            if (m_end_of_file && m_in_frame)
+                return Fail("truncated gzip data");
+            if (m_end_of_file)
+                break;
+            if (!FillInput())
+                return Fail(strerror(errno));
+            continue;
+        }
+
+        m_in_frame = true;
+        stream->next_in = m_input+m_input_position;
+        stream->avail_in = m_input_length-m_input_position;
+        int result = inflate(stream, Z_NO_FLUSH);
+        size_t consumed = (m_input_length-m_input_position) - stream->avail_in;
+        m_input_position += consumed;
+        m_bytes_consumed += consumed;
+
+        if (Z_STREAM_END == result)
+        {
+            inflateReset(stream); //gzip allows several members after each other
+            m_in_frame = false;
+        }
+        else if (Z_OK != result && Z_BUF_ERROR != result)
+        {
+            return Fail(stream->msg ? stream->msg : "corrupt gzip data");
+        }
+    }
+    return length - stream->avail_out;
+}
+
+int InputStream::ReadZstd(char* buffer, int length)
+{
+#ifdef HAVE_ZSTD
+    ZSTD_DStream* stream = static_cast<ZSTD_DStream*>(m_decompressor);
+    ZSTD_outBuffer output = {buffer, static_cast<size_t>(length), 0};
+    while (0 == output.pos)
+    {
+        if (m_input_position==m_input_length)
+        {
+            if (m_end_of_file && m_in_frame)
+                return Fail("truncated zstd data");
+            if (m_end_of_file)
+                break;
+            if (!FillInput())
+                return Fail(strerror(errno));
+            continue;
+        }
+
+        ZSTD_inBuffer input = {m_input+m_input_position, m_input_length-m_input_position, 0};
+        size_t result = ZSTD_decompressStream(stream, &output, &input);
+        m_input_position += input.pos;
+        m_bytes_consumed += input.pos;
+        if (ZSTD_isError(result))
+            return Fail(ZSTD_getErrorName(result));
+        m_in_frame = (0 != result); //0 when a frame is complete
+    }
+    return output.pos;
+#else
+    (void)buffer;
+    (void)length;
+    return -1;
+#endif
+}
@@ -0,0 +1,53 @@
+#ifndef _INPUT_STREAM_H_
+#define _INPUT_STREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define INPUT_BUFFER_SIZE (256*1024)
+#define STDIN_FILENAME    "-"
+
+
+// Reads a MeSH file sequentially, decompressing gzip and zstd on the fly.
+// The format is found from the first bytes, so a compressed stdin works too.
+// Progress is counted in bytes read from the file, before decompression.
+class InputStream
+{
+public:
+    InputStream();
+    ~InputStream();
+
+public:
+    bool Open(const char* filename); //STDIN_FILENAME reads stdin
+    void Close();
+    int Read(char* buffer, int length); //Returns bytes read, 0 at the end and -1 on errors
+    bool HasFailed() const {return m_failed;} //Read error, corrupt or truncated data
+
+    bool IsMappable() const {return COMPRESSION_NONE==m_compression && 0<m_size;} //Uncompressed regular file
+    long GetSize() const {return m_size;} //0 if not known, like for a pipe
+    long GetBytesConsumed() const {return m_bytes_consumed;}
+
+private:
+    enum Compression {COMPRESSION_NONE, COMPRESSION_GZIP, COMPRESSION_ZSTD};
+
+    bool FillInput();
+    int Fail(const char* reason);
+    int ReadGzip(char* buffer, int length);
+    int ReadZstd(char* buffer, int length);
+
+private:
+    int m_fd;
+    long m_size;
+    long m_bytes_consumed;
+    Compression m_compression;
+    bool m_end_of_file;
+    bool m_in_frame; //Inside a gzip member or zstd frame, so the data must not end here
+    bool m_failed;
+
+    unsigned char* m_input;
+    size_t m_input_position;
+    size_t m_input_length;
+    void* m_decompressor;
+};
+
+#endif // _INPUT_STREAM_H_
@@ -0,0 +1,175 @@
+#include "json_writer.h"
+
+#include <string.h>
+
+
+JsonWriter::JsonWriter()
+: m_depth(0),
+  m_after_key(false)
+{
+    m_first[0] = true;
+}
+
+void JsonWriter::Clear()
+{
+    m_buffer.clear(); //Keeps the capacity
+    m_depth = 0;
+    m_first[0] = true;
+    m_after_key = false;
+}
+
+void JsonWriter::BeginObject()
+{
+    Separate();
+    m_buffer.push_back('{');
+    m_first[++m_depth] = true;
+}
+
+void JsonWriter::EndObject()
+{
+    m_buffer.push_back('}');
+    m_depth--;
+}
+
+void JsonWriter::BeginArray()
+{
+    Separate();
+    m_buffer.push_back('[');
+    m_first[++m_depth] = true;
+}
+
+void JsonWriter::EndArray()
+{
+    m_buffer.push_back(']');
+    m_depth--;
+}
+
+void JsonWriter::Key(const char* key)
+{
+    Key(key, strlen(key), NULL);
+}
+
+void JsonWriter::Key(const char* key, size_t length, const char* suffix)
+{
+    Separate();
+    m_buffer.push_back('"');
+    AppendEscaped(key, length);
+    if (suffix)
+    {
+        AppendEscaped(suffix, strlen(suffix));
+    }
+    m_buffer.append("\":", 2);
+    m_after_key = true;
+}
+
+void JsonWriter::String(const char* value, size_t length)
+{
+    Separate();
+    m_buffer.push_back('"');
+    AppendEscaped(value, length);
+    m_buffer.push_back('"');
+}
+
+void JsonWriter::Number(long value)
+{
+    Separate();
+    char digits[24];
+    char* digit = digits+sizeof(digits);
+    unsigned long magnitude = (0 > value) ? 0UL-(unsigned long)value : (unsigned long)value;
+    do
+    {
+        *--digit = '0' + (magnitude%10);
+        magnitude /= 10;
+    } while (0 < magnitude);
+    if (0 > value)
+    {
+        *--digit = '-';
+    }
+    m_buffer.append(digit, digits+sizeof(digits)-digit);
+}
+
+void JsonWriter::Null()
+{
+    Separate();
+    m_buffer.append("null", 4);
+}
+
+void JsonWriter::StringArray(const std::vector<std::string>& values)
+{
+    BeginArray();
+    std::vector<std::string>::const_iterator iterator = values.begin();
+    for (; iterator!=values.end(); ++iterator)
+    {
+        String(*iterator);
+    }
+    EndArray();
+}
+
+void JsonWriter::StringMember(const char* key, const std::string& value)
+{
+    if (!value.empty())
+    {
+        Key(key);
+        String(value);
+    }
+}
+
+void JsonWriter::StringArrayMember(const char* key, const std::vector<std::string>& values)
+{
+    if (values.empty())
+        return;
+
+    Key(key);
+    StringArray(values);
+}
+
+void JsonWriter::StringArrayMember(const std::string& key, const std::vector<std::string>& values)
+{
+    StringArrayMember(key.c_str(), values);
+}
+
+void JsonWriter::Separate()
+{
+    if (m_after_key)
+    {
+        m_after_key = false;
+    }
+    else if (!m_first[m_depth])
+    {
+        m_buffer.push_back(',');
+    }
+    m_first[m_depth] = false;
+}
+
+void JsonWriter::AppendEscaped(const char* value, size_t length)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    //Text is copied in runs between the characters that need escaping, which most values do not have
+    const char* run = value;
+    const char* end = value+length;
+    for (const char* character=value; character!=end; ++character)
+    {
+        unsigned char c = static_cast<unsigned char>(*character);
+        if ('"'!=c && '\\'!=c && 0x20<=c)
+            continue;
+
+        m_buffer.append(run, character-run);
+        run = character+1;
+        switch (c)
+        {
+            case '"':  m_buffer.append("\\\"", 2); break;
+            case '\\': m_buffer.append("\\\\", 2); break;
+            case '\n': m_buffer.append("\\n", 2); break;
+            case '\t': m_buffer.append("\\t", 2); break;
+            case '\r': m_buffer.append("\\r", 2); break;
+            default:
+            {
+                char escaped[6] = {'\\', 'u', '0', '0', hex[c>>4], hex[c&0x0F]};
+                m_buffer.append(escaped, sizeof(escaped));
+                break;
+            }
+        }
+    }
+    m_buffer.append(run, end-run);
+}
@@ -0,0 +1,55 @@
+#ifndef _JSON_WRITER_H_
+#define _JSON_WRITER_H_
+
+#include <string>
+#include <vector>
+
+#define JSON_WRITER_MAX_DEPTH (16)
+
+
+// Writes a JSON document straight into one buffer, escaping values as they
+// are appended, instead of building a Json::Object tree and serializing it.
+// Each thread keeps its own writer and clears it for every record. The buffer
+// keeps its capacity, so once a writer has seen its largest document, writing
+// one more does not allocate.
+class JsonWriter
+{
+public:
+    JsonWriter();
+
+public:
+    void Clear();
+    const std::string& GetDocument() const {return m_buffer;}
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    void Key(const char* key);
+    void Key(const std::string& key) {Key(key.data(), key.length(), NULL);}
+    void Key(const std::string& prefix, const char* suffix) {Key(prefix.data(), prefix.length(), suffix);} //"<prefix><suffix>", without building it
+    void String(const char* value, size_t length);
+    void String(const std::string& value) {String(value.data(), value.length());}
+    void Number(long value);
+    void Null();
+    void StringArray(const std::vector<std::string>& values); //Also when empty
+
+    // Left out when empty, so documents only have the fields a record has
+    void StringMember(const char* key, const std::string& value);
+    void StringArrayMember(const char* key, const std::vector<std::string>& values);
+    void StringArrayMember(const std::string& key, const std::vector<std::string>& values);
+
+private:
+    void Key(const char* key, size_t length, const char* suffix);
+    void Separate(); //A comma before all but the first value in an object or array
+    void AppendEscaped(const char* value, size_t length);
+
+private:
+    std::string m_buffer;
+    int m_depth;
+    bool m_first[JSON_WRITER_MAX_DEPTH]; //Nothing written yet at this depth
+    bool m_after_key;
+};
+
+#endif // _JSON_WRITER_H_
@@ -0,0 +1,76 @@
+#include "manifest.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <errno.h>
+
+
+bool Manifest::Load(const char* filename)
+{
+    m_entries.clear();
+
+    FILE* file = fopen(filename, "r");
+    if (!file)
+        return ENOENT == errno;
+
+    char id[256];
+    uint64_t hash;
+    while (2 == fscanf(file, "%255s %" SCNx64, id, &hash))
+    {
+        m_entries[id] = hash;
+    }
+
+    bool ok = feof(file);
+    fclose(file);
+    return ok;
+}
+
+bool Manifest::Save(const char* filename) const
+{
+    //Write next to the old manifest and rename, so an interrupted run never leaves half a manifest
+    std::string temporary_filename = std::string(filename) + ".tmp";
+    FILE* file = fopen(temporary_filename.c_str(), "w");
+    if (!file)
+        return false;
+
+    Entries::const_iterator entry_iterator = m_entries.begin();
+    for (; entry_iterator!=m_entries.end(); ++entry_iterator)
+    {
+        fprintf(file, "%s %016" PRIx64 "\n", entry_iterator->first.c_str(), entry_iterator->second);
+    }
+
+    bool ok = (0 == fclose(file));
+    return ok && 0==rename(temporary_filename.c_str(), filename);
+}
+
+bool Manifest::Find(const std::string& id, uint64_t& hash) const
+{
+    Entries::const_iterator entry_iterator = m_entries.find(id);
+    if (m_entries.end() == entry_iterator)
+        return false;
+
+    hash = entry_iterator->second;
+    return true;
+}
+
+void Manifest::Set(const std::string& id, uint64_t hash)
+{
+    m_entries[id] = hash;
+}
+
+void Manifest::Remove(const std::string& id)
+{
+    m_entries.erase(id);
+}
+
+uint64_t Manifest::Hash(const std::string& document)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    std::string::const_iterator c = document.begin();
+    for (; c!=document.end(); ++c)
+    {
+        hash ^= static_cast<unsigned char>(*c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
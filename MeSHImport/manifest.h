@@ -0,0 +1,33 @@
+#ifndef _MANIFEST_H_
+#define _MANIFEST_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+
+
+// Descriptor id -> hash of the document we sent for it, kept between runs so
+// a delta import only has to send what changed. Stored as "<id> <hash>" lines.
+class Manifest
+{
+public:
+    typedef std::unordered_map<std::string, uint64_t> Entries;
+
+public:
+    bool Load(const char* filename); //A missing file is an empty manifest
+    bool Save(const char* filename) const;
+
+    bool Find(const std::string& id, uint64_t& hash) const;
+    void Set(const std::string& id, uint64_t hash);
+    void Remove(const std::string& id);
+    const Entries& GetEntries() const {return m_entries;}
+
+public:
+    static uint64_t Hash(const std::string& document); //64-bit FNV-1a
+
+private:
+    Entries m_entries;
+};
+
+#endif // _MANIFEST_H_
@@ -0,0 +1,74 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+MappedFile::MappedFile()
+: m_fd(-1),
+  m_data(NULL),
+  m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const char* filename)
+{
+    Close();
+
+    m_fd = open(filename, O_RDONLY);
+    if (-1 == m_fd)
+        return false;
+
+    struct stat filestat;
+    if (0!=fstat(m_fd, &filestat) || 0==filestat.st_size)
+    {
+        Close();
+        return false;
+    }
+
+    void* data = mmap(NULL, filestat.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (MAP_FAILED == data)
+    {
+        Close();
+        return false;
+    }
+    madvise(data, filestat.st_size, MADV_SEQUENTIAL); //Each parser thread walks its range front to back
+
+    m_data = static_cast<const char*>(data);
+    m_size = filestat.st_size;
+    return true;
+}
+
+void MappedFile::Release(const char* begin, const char* end) const
+{
+    const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t first_page = (reinterpret_cast<uintptr_t>(begin) + page_size-1) & ~(page_size-1);
+    uintptr_t last_page = reinterpret_cast<uintptr_t>(end) & ~(page_size-1);
+    if (first_page < last_page)
+    {
+        madvise(reinterpret_cast<void*>(first_page), last_page-first_page, MADV_DONTNEED);
+    }
+}
+
+void MappedFile::Close()
+{
+    if (m_data)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+        m_data = NULL;
+        m_size = 0;
+    }
+    if (-1 != m_fd)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
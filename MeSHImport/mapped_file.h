@@ -0,0 +1,28 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <stddef.h>
+
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+public:
+    bool Open(const char* filename);
+    void Close();
+    void Release(const char* begin, const char* end) const; //Drops the pages fully inside [begin,end) from memory
+
+    const char* GetData() const {return m_data;}
+    size_t GetSize() const {return m_size;}
+
+private:
+    int m_fd;
+    const char* m_data;
+    size_t m_size;
+};
+
+#endif // _MAPPED_FILE_H_
@@ -0,0 +1,616 @@
+#include "mmap_parser.h"
+
+#include <string.h>
+
+#include "descriptor_parser.h"
+
+
+static const char DESCRIPTOR_RECORD_TAG[] = "<DescriptorRecord";
+static const size_t DESCRIPTOR_RECORD_TAG_LENGTH = sizeof(DESCRIPTOR_RECORD_TAG)-1;
+
+
+bool StringRef::Equals(const char* literal) const
+{
+    return 0==strncmp(data, literal, length) && '\0'==literal[length];
+}
+
+static bool IsSpace(char c)
+{
+    return ' '==c || '\n'==c || '\t'==c || '\r'==c;
+}
+
+static const char* Find(const char* position, const char* end, const char* needle)
+{
+    size_t needle_length = strlen(needle);
+    while (position < end)
+    {
+        position = static_cast<const char*>(memchr(position, needle[0], end-position));
+        if (!position || static_cast<size_t>(end-position) < needle_length)
+            return NULL;
+
+        if (0 == memcmp(position, needle, needle_length))
+            return position;
+
+        position++;
+    }
+    return NULL;
+}
+
+static bool StartsWith(const char* position, const char* end, const char* prefix)
+{
+    size_t prefix_length = strlen(prefix);
+    return static_cast<size_t>(end-position)>=prefix_length && 0==memcmp(position, prefix, prefix_length);
+}
+
+static const char* FindRecordStart(const char* position, const char* end)
+{
+    const char* record_start;
+    while (NULL!=(record_start=Find(position, end, DESCRIPTOR_RECORD_TAG)))
+    {
+        const char* next = record_start + DESCRIPTOR_RECORD_TAG_LENGTH;
+        if (next<end && (IsSpace(*next) || '>'==*next || '/'==*next)) //Not <DescriptorRecordSet
+            return record_start;
+
+        position = next;
+    }
+    return end;
+}
+
+static void AppendUtf8(std::string& value, unsigned long codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        value += static_cast<char>(codepoint);
+    }
+    else if (codepoint < 0x800)
+    {
+        value += static_cast<char>(0xC0 | (codepoint>>6));
+        value += static_cast<char>(0x80 | (codepoint&0x3F));
+    }
+    else if (codepoint < 0x10000)
+    {
+        value += static_cast<char>(0xE0 | (codepoint>>12));
+        value += static_cast<char>(0x80 | ((codepoint>>6)&0x3F));
+        value += static_cast<char>(0x80 | (codepoint&0x3F));
+    }
+    else
+    {
+        value += static_cast<char>(0xF0 | (codepoint>>18));
+        value += static_cast<char>(0x80 | ((codepoint>>12)&0x3F));
+        value += static_cast<char>(0x80 | ((codepoint>>6)&0x3F));
+        value += static_cast<char>(0x80 | (codepoint&0x3F));
+    }
+}
+
+static bool AppendEntity(std::string& value, const StringRef& entity)
+{
+    if (entity.Equals("amp"))       value += '&';
+    else if (entity.Equals("lt"))   value += '<';
+    else if (entity.Equals("gt"))   value += '>';
+    else if (entity.Equals("quot")) value += '"';
+    else if (entity.Equals("apos")) value += '\'';
+    else if (1<entity.length && '#'==entity.data[0])
+    {
+        bool hex = ('x'==entity.data[1] || 'X'==entity.data[1]);
+        unsigned long codepoint = 0;
+        for (size_t i=(hex ? 2 : 1); i<entity.length; i++)
+        {
+            char c = entity.data[i];
+            if ('0'<=c && '9'>=c)             codepoint = codepoint*(hex ? 16 : 10) + (c-'0');
+            else if (hex && 'a'<=c && 'f'>=c) codepoint = codepoint*16 + (c-'a'+10);
+            else if (hex && 'A'<=c && 'F'>=c) codepoint = codepoint*16 + (c-'A'+10);
+            else return false;
+        }
+        AppendUtf8(value, codepoint);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// Appends text with entities replaced and line ends normalized, like libxml2 does
+static void AppendDecoded(std::string& value, const StringRef& text)
+{
+    const char* position = text.data;
+    const char* end = text.data + text.length;
+    if (!memchr(position, '&', text.length) && !memchr(position, '\r', text.length))
+    {
+        value.append(position, text.length);
+        return;
+    }
+
+    while (position < end)
+    {
+        const char* semicolon;
+        if ('&'==*position && NULL!=(semicolon=static_cast<const char*>(memchr(position, ';', end-position))) &&
+            AppendEntity(value, StringRef(position+1, semicolon-(position+1))))
+        {
+            position = semicolon+1;
+        }
+        else if ('\r'==*position)
+        {
+            value += '\n';
+            position++;
+            if (position<end && '\n'==*position)
+                position++;
+        }
+        else
+        {
+            value += *position++;
+        }
+    }
+}
+
+static bool GetAttribute(const StringRef& attributes, const char* name, StringRef& value)
+{
+    const char* position = attributes.data;
+    const char* end = attributes.data + attributes.length;
+    while (position < end)
+    {
+        while (position<end && IsSpace(*position))
+            position++;
+
+        const char* name_begin = position;
+        while (position<end && !IsSpace(*position) && '='!=*position)
+            position++;
+        StringRef attribute_name(name_begin, position-name_begin);
+
+        while (position<end && IsSpace(*position))
+            position++;
+        if (position>=end || '='!=*position++)
+            return false;
+        while (position<end && IsSpace(*position))
+            position++;
+        if (position>=end || ('"'!=*position && '\''!=*position))
+            return false;
+
+        char quote = *position++;
+        const char* value_begin = position;
+        position = static_cast<const char*>(memchr(position, quote, end-position));
+        if (!position)
+            return false;
+
+        if (attribute_name.Equals(name))
+        {
+            value = StringRef(value_begin, position-value_begin);
+            return true;
+        }
+        position++;
+    }
+    return false;
+}
+
+
+MappedDescriptorParser::MappedDescriptorParser(const char* begin, const char* end, bool topnodes_forced, const std::string& language_code)
+: m_position(begin),
+  m_end(end),
+  m_record_start(NULL),
+  m_topnodes_forced(topnodes_forced),
+  m_language_code(language_code),
+  m_record_count(0)
+{
+}
+
+bool MappedDescriptorParser::Next(Descriptor& descriptor)
+{
+    Token token;
+    while (NextToken(token))
+    {
+        if (TOKEN_START==token.type && token.name.Equals("DescriptorRecord"))
+        {
+            m_record_start = token.name.data - 1;
+            m_record_count++;
+
+            descriptor = Descriptor();
+            descriptor.language_file = m_language_code;
+            bool has_id = false;
+            ReadDescriptorRecord(descriptor, has_id);
+            if (has_id)
+                return true;
+        }
+    }
+    return false;
+}
+
+bool MappedDescriptorParser::ReadDescriptorRecordSet(const char* begin, const char* end, std::string& language_code, const char*& records_begin)
+{
+    MappedDescriptorParser parser(begin, end, false, "");
+    Token token;
+    while (parser.NextToken(token))
+    {
+        if (TOKEN_START == token.type)
+        {
+            StringRef value;
+            if (!token.name.Equals("DescriptorRecordSet") || !GetAttribute(token.attributes, "LanguageCode", value))
+                return false;
+
+            language_code.clear();
+            AppendDecoded(language_code, value);
+            records_begin = parser.m_position;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MappedDescriptorParser::SplitAtDescriptorRecords(const char* begin, const char* end, int parts, std::vector<ByteRange>& ranges)
+{
+    ranges.clear();
+    const char* range_begin = FindRecordStart(begin, end);
+    for (int i=1; i<=parts && range_begin<end; i++)
+    {
+        const char* range_end = end;
+        if (i < parts)
+        {
+            const char* target = begin + (end-begin)/parts*i;
+            range_end = FindRecordStart(target>range_begin ? target : range_begin+1, end);
+        }
+
+        ByteRange range = {range_begin, range_end};
+        ranges.push_back(range);
+        range_begin = range_end;
+    }
+}
+
+bool MappedDescriptorParser::NextToken(Token& token)
+{
+    while (m_position < m_end)
+    {
+        if ('<' != *m_position)
+        {
+            const char* text_end = static_cast<const char*>(memchr(m_position, '<', m_end-m_position));
+            if (!text_end)
+                text_end = m_end;
+
+            token.type = TOKEN_TEXT;
+            token.text = StringRef(m_position, text_end-m_position);
+            m_position = text_end;
+            return true;
+        }
+
+        const char* tag = m_position+1;
+        const char* tag_end;
+        if (StartsWith(tag, m_end, "!--"))
+        {
+            tag_end = Find(tag+3, m_end, "-->");
+            m_position = tag_end ? tag_end+3 : m_end;
+        }
+        else if (StartsWith(tag, m_end, "![CDATA["))
+        {
+            tag_end = Find(tag+8, m_end, "]]>");
+            if (!tag_end)
+                break;
+
+            token.type = TOKEN_CDATA;
+            token.text = StringRef(tag+8, tag_end-(tag+8));
+            m_position = tag_end+3;
+            return true;
+        }
+        else if (StartsWith(tag, m_end, "?")) //Processing instruction or XML declaration
+        {
+            tag_end = Find(tag, m_end, "?>");
+            m_position = tag_end ? tag_end+2 : m_end;
+        }
+        else if (StartsWith(tag, m_end, "!")) //DOCTYPE, possibly with an internal subset
+        {
+            int brackets = 0;
+            for (tag_end=tag; tag_end<m_end && ('>'!=*tag_end || 0<brackets); tag_end++)
+            {
+                if ('['==*tag_end) brackets++;
+                else if (']'==*tag_end) brackets--;
+            }
+            m_position = tag_end<m_end ? tag_end+1 : m_end;
+        }
+        else
+        {
+            bool end_tag = (tag<m_end && '/'==*tag);
+            const char* name = end_tag ? tag+1 : tag;
+            const char* name_end = name;
+            while (name_end<m_end && !IsSpace(*name_end) && '>'!=*name_end && '/'!=*name_end)
+                name_end++;
+
+            char quote = '\0';
+            for (tag_end=name_end; tag_end<m_end && ('>'!=*tag_end || '\0'!=quote); tag_end++) //'>' is allowed in attribute values
+            {
+                if ('\0'==quote && ('"'==*tag_end || '\''==*tag_end)) quote = *tag_end;
+                else if (quote==*tag_end) quote = '\0';
+            }
+            if (tag_end >= m_end)
+                break;
+
+            bool empty_element = (!end_tag && '/'==*(tag_end-1));
+            token.type = end_tag ? TOKEN_END : (empty_element ? TOKEN_EMPTY : TOKEN_START);
+            token.name = StringRef(name, name_end-name);
+            token.attributes = StringRef(name_end, (empty_element ? tag_end-1 : tag_end)-name_end);
+            m_position = tag_end+1;
+            return true;
+        }
+    }
+
+    m_position = m_end;
+    token.type = TOKEN_EOF;
+    return false;
+}
+
+bool MappedDescriptorParser::NextChild(Token& token)
+{
+    while (NextToken(token))
+    {
+        if (TOKEN_START == token.type)
+            return true;
+        if (TOKEN_END == token.type)
+            return false;
+    }
+    return false;
+}
+
+void MappedDescriptorParser::SkipElement()
+{
+    int depth = 1;
+    Token token;
+    while (0<depth && NextToken(token))
+    {
+        if (TOKEN_START == token.type)
+            depth++;
+        else if (TOKEN_END == token.type)
+            depth--;
+    }
+}
+
+bool MappedDescriptorParser::ReadText(std::string& value)
+//Like GetText in the libxml2 parser: only text before the first child element counts
+{
+    std::string text;
+    bool has_child = false;
+    Token token;
+    while (NextToken(token))
+    {
+        if (TOKEN_END == token.type)
+            break;
+
+        if (TOKEN_START == token.type)
+        {
+            has_child = true;
+            SkipElement();
+        }
+        else if (TOKEN_EMPTY == token.type)
+        {
+            has_child = true;
+        }
+        else if (!has_child)
+        {
+            if (TOKEN_CDATA == token.type)
+                text.append(token.text.data, token.text.length);
+            else
+                AppendDecoded(text, token.text);
+        }
+    }
+
+    if (text.empty())
+        return false;
+
+    if (has_child) //Whitespace between elements is not text (XML_PARSE_NOBLANKS)
+    {
+        size_t i = 0;
+        while (i<text.length() && IsSpace(text[i]))
+            i++;
+        if (i == text.length())
+            return false;
+    }
+
+    value.swap(text);
+    return true;
+}
+
+void MappedDescriptorParser::ReadDescriptorRecord(Descriptor& descriptor, bool& has_id)
+{
+    Token token;
+    while (NextChild(token))
+    {
+        switch (GetMeshElement(token.name.data, token.name.length))
+        {
+            case MESH_ELEMENT_DESCRIPTOR_UI:    has_id = ReadText(descriptor.id); break;
+            case MESH_ELEMENT_DESCRIPTOR_NAME:  ReadDescriptorName(descriptor); break;
+            case MESH_ELEMENT_SEE_RELATED_LIST: ReadSeeRelatedList(descriptor); break;
+            case MESH_ELEMENT_TREE_NUMBER_LIST: ReadTreeNumberList(descriptor); break;
+            case MESH_ELEMENT_CONCEPT_LIST:     ReadConceptList(descriptor); break;
+            default:                            SkipElement(); break;
+        }
+    }
+}
+
+void MappedDescriptorParser::ReadDescriptorName(Descriptor& descriptor)
+{
+    bool first_child = true;
+    Token token;
+    while (NextChild(token))
+    {
+        std::string name;
+        bool is_string = (MESH_ELEMENT_STRING == GetMeshElement(token.name.data, token.name.length));
+        if (first_child && is_string && ReadText(name))
+        {
+            SetDescriptorName(descriptor, BAD_CAST(name.c_str()));
+        }
+        else if (!first_child || !is_string)
+        {
+            SkipElement();
+        }
+        first_child = false;
+    }
+}
+
+void MappedDescriptorParser::ReadSeeRelatedList(Descriptor& descriptor)
+{
+    Token token;
+    while (NextChild(token))
+    {
+        if (MESH_ELEMENT_SEE_RELATED_DESCRIPTOR != GetMeshElement(token.name.data, token.name.length))
+        {
+            SkipElement();
+            continue;
+        }
+
+        while (NextChild(token))
+        {
+            if (MESH_ELEMENT_DESCRIPTOR_REFERRED_TO != GetMeshElement(token.name.data, token.name.length))
+            {
+                SkipElement();
+                continue;
+            }
+
+            while (NextChild(token))
+            {
+                std::string see_related;
+                if (MESH_ELEMENT_DESCRIPTOR_UI != GetMeshElement(token.name.data, token.name.length))
+                {
+                    SkipElement();
+                }
+                else if (ReadText(see_related))
+                {
+                    descriptor.see_related.push_back(see_related);
+                }
+            }
+        }
+    }
+}
+
+void MappedDescriptorParser::ReadTreeNumberList(Descriptor& descriptor)
+{
+    Token token;
+    while (NextChild(token))
+    {
+        std::string tree_number;
+        if (MESH_ELEMENT_TREE_NUMBER != GetMeshElement(token.name.data, token.name.length))
+        {
+            SkipElement();
+        }
+        else if (ReadText(tree_number))
+        {
+            AddTreeNumber(descriptor, m_topnodes_forced, tree_number);
+        }
+    }
+}
+
+void MappedDescriptorParser::ReadConceptList(Descriptor& descriptor)
+{
+    Token token;
+    while (NextChild(token))
+    {
+        if (MESH_ELEMENT_CONCEPT == GetMeshElement(token.name.data, token.name.length))
+        {
+            StringRef preferred;
+            ReadConcept(descriptor, GetAttribute(token.attributes, "PreferredConceptYN", preferred) && preferred.Equals("Y"));
+        }
+        else
+        {
+            SkipElement();
+        }
+    }
+}
+
+void MappedDescriptorParser::ReadConcept(Descriptor& descriptor, bool preferred_concept)
+{
+    Token token;
+    while (NextChild(token))
+    {
+        std::string concept_id;
+        MeshElement element = GetMeshElement(token.name.data, token.name.length);
+        if (preferred_concept && MESH_ELEMENT_SCOPE_NOTE==element)
+        {
+            ReadText(descriptor.eng_description);
+        }
+        else if (preferred_concept && MESH_ELEMENT_TRANSLATORS_SCOPE_NOTE==element)
+        {
+            ReadText(descriptor.nor_description);
+        }
+        else if (MESH_ELEMENT_TERM_LIST == element)
+        {
+            ReadTermList(descriptor, preferred_concept);
+        }
+        else if (MESH_ELEMENT_CONCEPT_UI == element)
+        {
+            if (ReadText(concept_id))
+            {
+                descriptor.other_ids.push_back(concept_id);
+            }
+        }
+        else
+        {
+            SkipElement();
+        }
+    }
+}
+
+void MappedDescriptorParser::ReadTermList(Descriptor& descriptor, bool preferred_concept)
+{
+    Token token;
+    while (NextChild(token))
+    {
+        if (MESH_ELEMENT_TERM == GetMeshElement(token.name.data, token.name.length))
+        {
+            StringRef preferred;
+            ReadTerm(descriptor, preferred_concept && GetAttribute(token.attributes, "ConceptPreferredTermYN", preferred) && preferred.Equals("Y"));
+        }
+        else
+        {
+            SkipElement();
+        }
+    }
+}
+
+void MappedDescriptorParser::ReadTerm(Descriptor& descriptor, bool preferred)
+{
+    std::string language = "eng";
+    std::string term_text;
+    bool has_term_text = false;
+
+    Token token;
+    while (NextChild(token))
+    {
+        std::string term_id;
+        switch (GetMeshElement(token.name.data, token.name.length))
+        {
+            case MESH_ELEMENT_STRING:
+                has_term_text = ReadText(term_text);
+                break;
+            case MESH_ELEMENT_TERM_UI:
+                if (ReadText(term_id))
+                {
+                    descriptor.other_ids.push_back(term_id);
+                }
+                break;
+            case MESH_ELEMENT_THESAURUS_ID_LIST:
+                ReadThesaurusIDlist(language);
+                break;
+            default:
+                SkipElement();
+                break;
+        }
+    }
+
+    if (has_term_text)
+    {
+        AddTerm(descriptor, preferred, language, BAD_CAST(term_text.c_str()));
+    }
+}
+
+void MappedDescriptorParser::ReadThesaurusIDlist(std::string& language)
+{
+    bool first_child = true;
+    Token token;
+    while (NextChild(token))
+    {
+        std::string thesaurus_id;
+        if (first_child && ReadText(thesaurus_id))
+        {
+            GetThesaurusLanguage(thesaurus_id.data(), thesaurus_id.length(), language);
+        }
+        else if (!first_child)
+        {
+            SkipElement();
+        }
+        first_child = false;
+    }
+}
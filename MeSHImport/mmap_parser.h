@@ -0,0 +1,90 @@
+#ifndef _MMAP_PARSER_H_
+#define _MMAP_PARSER_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "descriptor.h"
+
+
+// A view into the mapped file. Nothing is copied until a value is stored in a Descriptor
+struct StringRef
+{
+    StringRef() : data(NULL), length(0) {}
+    StringRef(const char* data, size_t length) : data(data), length(length) {}
+
+    bool Equals(const char* literal) const;
+
+    const char* data;
+    size_t length;
+};
+
+struct ByteRange
+{
+    const char* begin;
+    const char* end;
+};
+
+// Pull parser that reads DescriptorRecords straight from a mapped MeSH file,
+// instead of building a libxml2 DOM subtree per record. It understands the
+// XML subset the MeSH files use (elements, attributes, predefined and numeric
+// entities, CDATA, comments, processing instructions), does not read the DTD
+// and assumes the file is well-formed. Use the libxml2 parser to validate.
+#define MAPPED_RELEASE_BYTES (1024*1024) //Parsed bytes between releasing the pages behind us
+
+class MappedDescriptorParser
+{
+public:
+    MappedDescriptorParser(const char* begin, const char* end, bool topnodes_forced, const std::string& language_code);
+
+public:
+    // Reads the next DescriptorRecord with a DescriptorUI. Records without one are counted and skipped
+    bool Next(Descriptor& descriptor);
+
+    const char* GetPosition() const {return m_position;}
+    const char* GetRecordStart() const {return m_record_start;}
+    long GetRecordCount() const {return m_record_count;}
+
+public:
+    // Finds <DescriptorRecordSet>, returns its LanguageCode and where the first record may start
+    static bool ReadDescriptorRecordSet(const char* begin, const char* end, std::string& language_code, const char*& records_begin);
+    // Splits [begin,end) into at most parts ranges, each starting at a <DescriptorRecord> tag
+    static void SplitAtDescriptorRecords(const char* begin, const char* end, int parts, std::vector<ByteRange>& ranges);
+
+private:
+    enum TokenType {TOKEN_START, TOKEN_END, TOKEN_EMPTY, TOKEN_TEXT, TOKEN_CDATA, TOKEN_EOF};
+    struct Token
+    {
+        TokenType type;
+        StringRef name;       //Element name for START/END/EMPTY
+        StringRef attributes; //Raw attribute text for START/EMPTY
+        StringRef text;       //Undecoded text for TEXT/CDATA
+    };
+
+    bool NextToken(Token& token);
+    bool NextChild(Token& token); //Skips to the next child element, false at the end of the current one
+    void SkipElement();
+    bool ReadText(std::string& value);
+
+    void ReadDescriptorRecord(Descriptor& descriptor, bool& has_id);
+    void ReadDescriptorName(Descriptor& descriptor);
+    void ReadSeeRelatedList(Descriptor& descriptor);
+    void ReadTreeNumberList(Descriptor& descriptor);
+    void ReadConceptList(Descriptor& descriptor);
+    void ReadConcept(Descriptor& descriptor, bool preferred_concept);
+    void ReadTermList(Descriptor& descriptor, bool preferred_concept);
+    void ReadTerm(Descriptor& descriptor, bool preferred);
+    void ReadThesaurusIDlist(std::string& language);
+
+private:
+    const char* m_position;
+    const char* m_end;
+    const char* m_record_start;
+    bool m_topnodes_forced;
+    std::string m_language_code;
+    long m_record_count;
+};
+
+#endif // _MMAP_PARSER_H_
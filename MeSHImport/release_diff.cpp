@@ -0,0 +1,453 @@
+#include "release_diff.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "json_writer.h"
+#include "manifest.h"
+
+
+//Run files hold entries one after another: id, nor_name, eng_name, tree number count, tree numbers and the content hash.
+//Strings are a uint32_t length and the bytes
+static bool WriteString(FILE* file, const std::string& value)
+{
+    uint32_t length = value.length();
+    return 1==fwrite(&length, sizeof(length), 1, file) && length==fwrite(value.data(), 1, length, file);
+}
+
+static bool ReadString(FILE* file, std::string& value)
+{
+    uint32_t length;
+    if (1 != fread(&length, sizeof(length), 1, file))
+        return false;
+    value.resize(length);
+    return 0==length || length==fread(&value[0], 1, length, file);
+}
+
+static bool WriteEntry(FILE* file, const ReleaseEntry& entry)
+{
+    bool ok = WriteString(file, entry.id) && WriteString(file, entry.nor_name) && WriteString(file, entry.eng_name);
+    uint32_t tree_number_count = entry.tree_numbers.size();
+    ok = ok && 1==fwrite(&tree_number_count, sizeof(tree_number_count), 1, file);
+    for (uint32_t i=0; ok && i<tree_number_count; i++)
+    {
+        ok = WriteString(file, entry.tree_numbers[i]);
+    }
+    return ok && 1==fwrite(&entry.content_hash, sizeof(entry.content_hash), 1, file);
+}
+
+static bool ReadEntry(FILE* file, ReleaseEntry& entry)
+{
+    uint32_t tree_number_count;
+    if (!ReadString(file, entry.id) || !ReadString(file, entry.nor_name) || !ReadString(file, entry.eng_name) ||
+        1!=fread(&tree_number_count, sizeof(tree_number_count), 1, file))
+        return false;
+
+    entry.tree_numbers.resize(tree_number_count);
+    for (uint32_t i=0; i<tree_number_count; i++)
+    {
+        if (!ReadString(file, entry.tree_numbers[i]))
+            return false;
+    }
+    return 1 == fread(&entry.content_hash, sizeof(entry.content_hash), 1, file);
+}
+
+static bool EntryIdLess(const ReleaseEntry& entry, const ReleaseEntry& other_entry)
+{
+    return entry.id < other_entry.id;
+}
+
+
+ReleaseRuns::ReleaseRuns(size_t run_records)
+: m_run_records(std::max(static_cast<size_t>(1), run_records)),
+  m_entry_count(0),
+  m_failed(false)
+{
+}
+
+ReleaseRuns::~ReleaseRuns()
+{
+    std::vector<FILE*>::iterator run_iterator = m_runs.begin();
+    for (; run_iterator!=m_runs.end(); ++run_iterator)
+    {
+        fclose(*run_iterator); //tmpfile() files are removed when closed
+    }
+}
+
+bool ReleaseRuns::Add(Descriptor& descriptor)
+{
+    ReleaseEntry entry;
+    entry.id = descriptor.id;
+    entry.nor_name.swap(descriptor.nor_name);
+    entry.eng_name.swap(descriptor.eng_name);
+    entry.tree_numbers.swap(descriptor.tree_numbers);
+    std::sort(entry.tree_numbers.begin(), entry.tree_numbers.end());
+
+    //What is left of the document is the content. Parents and top_node follow from the tree numbers, and
+    //the terms that repeat a name are renamed with it
+    descriptor.parent_tree_numbers.clear();
+    descriptor.top_node = false;
+    std::map<std::string, std::vector<std::string> >::iterator term_iterator = descriptor.term_texts.begin();
+    for (; term_iterator!=descriptor.term_texts.end(); ++term_iterator)
+    {
+        std::vector<std::string>& terms = term_iterator->second;
+        terms.erase(std::remove(terms.begin(), terms.end(), entry.nor_name), terms.end());
+        terms.erase(std::remove(terms.begin(), terms.end(), entry.eng_name), terms.end());
+    }
+    JsonWriter json;
+    DescriptorToJson(descriptor, json);
+    entry.content_hash = Manifest::Hash(json.GetDocument());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_failed)
+        return false;
+    m_run.push_back(std::move(entry));
+    m_entry_count++;
+    if (m_run.size() < m_run_records)
+        return true;
+
+    return SpillRun();
+}
+
+bool ReleaseRuns::SpillRun()
+{
+    if (m_run.empty() || m_failed)
+        return !m_failed;
+
+    FILE* file = tmpfile();
+    if (!file)
+    {
+        m_failed = true;
+        return false;
+    }
+    m_runs.push_back(file);
+
+    std::sort(m_run.begin(), m_run.end(), EntryIdLess);
+    bool ok = true;
+    std::vector<ReleaseEntry>::const_iterator entry_iterator = m_run.begin();
+    for (; ok && entry_iterator!=m_run.end(); ++entry_iterator)
+    {
+        ok = WriteEntry(file, *entry_iterator);
+    }
+    std::vector<ReleaseEntry>().swap(m_run); //Let the next run start small again
+    m_failed = !ok || 0!=fflush(file);
+    return !m_failed;
+}
+
+bool ReleaseRuns::Finish()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!SpillRun())
+        return false;
+
+    m_heads.resize(m_runs.size());
+    for (size_t run=0; run<m_runs.size(); run++)
+    {
+        rewind(m_runs[run]);
+        if (ReadHead(run))
+        {
+            m_heap.push_back(run);
+        }
+    }
+    std::make_heap(m_heap.begin(), m_heap.end(), std::bind(&ReleaseRuns::HeadGreater, this, std::placeholders::_1, std::placeholders::_2));
+    return !m_failed;
+}
+
+bool ReleaseRuns::ReadHead(size_t run)
+{
+    if (ReadEntry(m_runs[run], m_heads[run]))
+        return true;
+
+    m_failed = m_failed || !feof(m_runs[run]); //A run ends after a whole entry
+    return false;
+}
+
+bool ReleaseRuns::HeadGreater(size_t run, size_t other_run) const
+{
+    int compare = m_heads[run].id.compare(m_heads[other_run].id);
+    return 0<compare || (0==compare && run>other_run); //Earlier runs first for equal ids, like a stable sort
+}
+
+bool ReleaseRuns::Next(ReleaseEntry& entry)
+{
+    if (m_heap.empty() || m_failed)
+        return false;
+
+    auto greater = std::bind(&ReleaseRuns::HeadGreater, this, std::placeholders::_1, std::placeholders::_2);
+    std::pop_heap(m_heap.begin(), m_heap.end(), greater);
+    size_t run = m_heap.back();
+    entry.id.swap(m_heads[run].id);
+    entry.nor_name.swap(m_heads[run].nor_name);
+    entry.eng_name.swap(m_heads[run].eng_name);
+    entry.tree_numbers.swap(m_heads[run].tree_numbers);
+    entry.content_hash = m_heads[run].content_hash;
+
+    if (ReadHead(run))
+    {
+        std::push_heap(m_heap.begin(), m_heap.end(), greater);
+    }
+    else
+    {
+        m_heap.pop_back();
+    }
+    return !m_failed;
+}
+
+
+// Writes the changelog as it is merged, one change per line
+class ChangelogWriter
+{
+public:
+    ChangelogWriter() : m_file(NULL), m_csv(false), m_first(true) {}
+    ~ChangelogWriter() {if (m_file) fclose(m_file);}
+
+public:
+    bool Open(const char* filename, const char* old_filename, const char* new_filename);
+    void Write(int changes, const ReleaseEntry* old_entry, const ReleaseEntry* new_entry);
+    bool Close(const ReleaseDiffCounts& counts);
+
+private:
+    void AppendCsv(const std::string& value);
+    void AppendCsv(const std::vector<std::string>& values);
+    void WriteJsonEntry(const char* key, const ReleaseEntry* entry);
+
+private:
+    FILE* m_file;
+    bool m_csv;
+    bool m_first;
+    std::string m_line;
+    JsonWriter m_json;
+};
+
+static const char* CHANGE_NAMES[] = {"added", "removed", "renamed", "moved", "changed"};
+#define CHANGE_NAME_COUNT (sizeof(CHANGE_NAMES)/sizeof(CHANGE_NAMES[0]))
+
+bool ChangelogWriter::Open(const char* filename, const char* old_filename, const char* new_filename)
+{
+    size_t length = strlen(filename);
+    m_csv = (4<=length && 0==strcmp(".csv", filename+length-4));
+    m_file = fopen(filename, "w");
+    if (!m_file)
+        return false;
+
+    if (m_csv)
+    {
+        fputs("id,change,old_nor_name,new_nor_name,old_eng_name,new_eng_name,old_tree_numbers,new_tree_numbers\n", m_file);
+    }
+    else
+    {
+        m_json.Clear();
+        m_json.BeginObject();
+        m_json.Key("old_release");
+        m_json.String(old_filename, strlen(old_filename));
+        m_json.Key("new_release");
+        m_json.String(new_filename, strlen(new_filename));
+        m_json.Key("changes");
+        fprintf(m_file, "%s[", m_json.GetDocument().c_str());
+    }
+    return true;
+}
+
+void ChangelogWriter::AppendCsv(const std::string& value)
+{
+    if (std::string::npos == value.find_first_of(",\"\r\n"))
+    {
+        m_line.append(value);
+        return;
+    }
+
+    m_line.push_back('"');
+    for (size_t i=0; i<value.length(); i++)
+    {
+        if ('"' == value[i])
+        {
+            m_line.push_back('"');
+        }
+        m_line.push_back(value[i]);
+    }
+    m_line.push_back('"');
+}
+
+void ChangelogWriter::AppendCsv(const std::vector<std::string>& values) //Tree numbers have no commas or quotes
+{
+    for (size_t i=0; i<values.size(); i++)
+    {
+        if (0 < i)
+        {
+            m_line.push_back(';');
+        }
+        m_line.append(values[i]);
+    }
+}
+
+void ChangelogWriter::WriteJsonEntry(const char* key, const ReleaseEntry* entry)
+{
+    if (!entry)
+        return;
+
+    m_json.Key(key);
+    m_json.BeginObject();
+    m_json.StringMember("nor_name", entry->nor_name);
+    m_json.StringMember("eng_name", entry->eng_name);
+    m_json.Key("tree_numbers");
+    m_json.StringArray(entry->tree_numbers);
+    m_json.EndObject();
+}
+
+void ChangelogWriter::Write(int changes, const ReleaseEntry* old_entry, const ReleaseEntry* new_entry)
+{
+    const std::string& id = old_entry ? old_entry->id : new_entry->id;
+    static const ReleaseEntry none;
+    if (m_csv)
+    {
+        m_line.clear();
+        AppendCsv(id);
+        m_line.push_back(',');
+        bool first_change = true;
+        for (size_t i=0; i<CHANGE_NAME_COUNT; i++)
+        {
+            if (changes & (1<<i))
+            {
+                m_line.append(first_change ? "" : ";");
+                m_line.append(CHANGE_NAMES[i]);
+                first_change = false;
+            }
+        }
+        const ReleaseEntry& old_values = old_entry ? *old_entry : none;
+        const ReleaseEntry& new_values = new_entry ? *new_entry : none;
+        m_line.push_back(',');
+        AppendCsv(old_values.nor_name);
+        m_line.push_back(',');
+        AppendCsv(new_values.nor_name);
+        m_line.push_back(',');
+        AppendCsv(old_values.eng_name);
+        m_line.push_back(',');
+        AppendCsv(new_values.eng_name);
+        m_line.push_back(',');
+        AppendCsv(old_values.tree_numbers);
+        m_line.push_back(',');
+        AppendCsv(new_values.tree_numbers);
+        m_line.push_back('\n');
+        fwrite(m_line.data(), 1, m_line.length(), m_file);
+        return;
+    }
+
+    m_json.Clear();
+    m_json.BeginObject();
+    m_json.Key("id");
+    m_json.String(id);
+    m_json.Key("change");
+    m_json.BeginArray();
+    for (size_t i=0; i<CHANGE_NAME_COUNT; i++)
+    {
+        if (changes & (1<<i))
+        {
+            m_json.String(CHANGE_NAMES[i], strlen(CHANGE_NAMES[i]));
+        }
+    }
+    m_json.EndArray();
+    WriteJsonEntry("old", old_entry);
+    WriteJsonEntry("new", new_entry);
+    m_json.EndObject();
+    fputs(m_first ? "\n" : ",\n", m_file);
+    fwrite(m_json.GetDocument().data(), 1, m_json.GetDocument().length(), m_file);
+    m_first = false;
+}
+
+bool ChangelogWriter::Close(const ReleaseDiffCounts& counts)
+{
+    if (!m_csv)
+    {
+        m_json.Clear();
+        m_json.BeginObject();
+        m_json.Key("added");
+        m_json.Number(counts.added);
+        m_json.Key("removed");
+        m_json.Number(counts.removed);
+        m_json.Key("renamed");
+        m_json.Number(counts.renamed);
+        m_json.Key("moved");
+        m_json.Number(counts.moved);
+        m_json.Key("changed");
+        m_json.Number(counts.changed);
+        m_json.Key("unchanged");
+        m_json.Number(counts.unchanged);
+        m_json.EndObject();
+        fprintf(m_file, "\n],\"counts\":%s}\n", m_json.GetDocument().c_str());
+    }
+
+    bool ok = !ferror(m_file);
+    ok = (0 == fclose(m_file)) && ok;
+    m_file = NULL;
+    return ok;
+}
+
+static int CompareEntries(const ReleaseEntry& old_entry, const ReleaseEntry& new_entry)
+{
+    int changes = 0;
+    if (old_entry.nor_name!=new_entry.nor_name || old_entry.eng_name!=new_entry.eng_name)
+    {
+        changes |= RELEASE_CHANGE_RENAMED;
+    }
+    if (old_entry.tree_numbers != new_entry.tree_numbers)
+    {
+        changes |= RELEASE_CHANGE_MOVED;
+    }
+    if (old_entry.content_hash != new_entry.content_hash)
+    {
+        changes |= RELEASE_CHANGE_CHANGED;
+    }
+    return changes;
+}
+
+bool DiffReleases(ReleaseRuns& old_release, ReleaseRuns& new_release, const char* old_filename, const char* new_filename,
+                  const char* changelog_filename, ReleaseDiffCounts& counts)
+{
+    ChangelogWriter changelog;
+    if (!changelog.Open(changelog_filename, old_filename, new_filename))
+        return false;
+
+    //Both releases come out in id order, so one pass pairs them up
+    ReleaseEntry old_entry;
+    ReleaseEntry new_entry;
+    bool has_old = old_release.Next(old_entry);
+    bool has_new = new_release.Next(new_entry);
+    while (has_old || has_new)
+    {
+        int compare = !has_old ? 1 : (!has_new ? -1 : old_entry.id.compare(new_entry.id));
+        if (0 > compare)
+        {
+            changelog.Write(RELEASE_CHANGE_REMOVED, &old_entry, NULL);
+            counts.removed++;
+            has_old = old_release.Next(old_entry);
+        }
+        else if (0 < compare)
+        {
+            changelog.Write(RELEASE_CHANGE_ADDED, NULL, &new_entry);
+            counts.added++;
+            has_new = new_release.Next(new_entry);
+        }
+        else
+        {
+            int changes = CompareEntries(old_entry, new_entry);
+            if (0 == changes)
+            {
+                counts.unchanged++;
+            }
+            else
+            {
+                changelog.Write(changes, &old_entry, &new_entry);
+                counts.renamed += (changes & RELEASE_CHANGE_RENAMED) ? 1 : 0;
+                counts.moved += (changes & RELEASE_CHANGE_MOVED) ? 1 : 0;
+                counts.changed += (changes & RELEASE_CHANGE_CHANGED) ? 1 : 0;
+            }
+            has_old = old_release.Next(old_entry);
+            has_new = new_release.Next(new_entry);
+        }
+    }
+
+    bool ok = changelog.Close(counts);
+    return ok && !old_release.HasFailed() && !new_release.HasFailed();
+}
@@ -0,0 +1,87 @@
+#ifndef _RELEASE_DIFF_H_
+#define _RELEASE_DIFF_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "descriptor.h"
+
+#define DIFF_RUN_RECORDS (20000) //Descriptors of a release kept in memory before they are sorted and spilled
+
+#define RELEASE_CHANGE_ADDED   (1<<0)
+#define RELEASE_CHANGE_REMOVED (1<<1)
+#define RELEASE_CHANGE_RENAMED (1<<2)
+#define RELEASE_CHANGE_MOVED   (1<<3) //Other tree numbers
+#define RELEASE_CHANGE_CHANGED (1<<4) //Anything else in the record, like terms or the scope note
+
+
+// What a release diff keeps of a descriptor
+struct ReleaseEntry
+{
+    ReleaseEntry() : content_hash(0) {}
+
+    std::string id;
+    std::string nor_name;
+    std::string eng_name;
+    std::vector<std::string> tree_numbers; //Sorted, their order in the file means nothing
+    uint64_t content_hash; //Of the document without the names and the tree numbers
+};
+
+// The descriptors of one release in id order, in bounded memory. Descriptors
+// are collected into a run, which is sorted and spilled to an anonymous
+// temporary file when it is full. Reading them back merges the runs, keeping
+// one entry per run in memory.
+class ReleaseRuns
+{
+public:
+    ReleaseRuns(size_t run_records=DIFF_RUN_RECORDS);
+    ~ReleaseRuns();
+
+public:
+    bool Add(Descriptor& descriptor); //From any thread. Takes the names and tree numbers, false if a run could not be written
+    bool Finish(); //When all are added, spills the last run and starts the merge
+    bool Next(ReleaseEntry& entry); //In id order, false at the end or if a run could not be read
+    bool HasFailed() const {return m_failed;}
+
+    long GetEntryCount() const {return m_entry_count;}
+    size_t GetRunCount() const {return m_runs.size();}
+
+private:
+    bool SpillRun(); //With m_mutex held
+    bool ReadHead(size_t run); //False at the end of the run
+    bool HeadGreater(size_t run, size_t other_run) const;
+
+private:
+    std::mutex m_mutex;
+    size_t m_run_records;
+    std::vector<ReleaseEntry> m_run;
+    std::vector<FILE*> m_runs;
+    std::vector<ReleaseEntry> m_heads; //Parallel to m_runs, the next entry of each run while merging
+    std::vector<size_t> m_heap; //Runs with entries left, smallest head on top
+    long m_entry_count;
+    bool m_failed;
+};
+
+struct ReleaseDiffCounts
+{
+    ReleaseDiffCounts() : added(0), removed(0), renamed(0), moved(0), changed(0), unchanged(0) {}
+
+    long added;
+    long removed;
+    long renamed; //A descriptor can be renamed, moved and changed at once, and is counted for each
+    long moved;
+    long changed;
+    long unchanged;
+};
+
+// Merges two releases by DescriptorUI and writes an entry to the changelog for
+// every descriptor that was added, removed or differs. The changelog is CSV if
+// its name ends in .csv, JSON otherwise
+bool DiffReleases(ReleaseRuns& old_release, ReleaseRuns& new_release, const char* old_filename, const char* new_filename,
+                  const char* changelog_filename, ReleaseDiffCounts& counts);
+
+#endif // _RELEASE_DIFF_H_
@@ -0,0 +1,202 @@
+#include "snapshot_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "mesh_snapshot.h"
+
+
+class StringPool
+{
+public:
+    StringPool() : m_data(1, '\0') {} //Offset 0 is ""
+
+    uint32_t Add(const std::string& value)
+    {
+        if (value.empty())
+            return 0;
+
+        std::unordered_map<std::string, uint32_t>::const_iterator offset_iterator = m_offsets.find(value);
+        if (m_offsets.end() != offset_iterator)
+            return offset_iterator->second;
+
+        uint32_t offset = m_data.size();
+        m_data.append(value).append(1, '\0');
+        m_offsets[value] = offset;
+        return offset;
+    }
+
+    const std::string& GetData() const {return m_data;}
+
+private:
+    std::string m_data;
+    std::unordered_map<std::string, uint32_t> m_offsets;
+};
+
+static void AppendSection(std::string& file, const void* data, size_t length, uint64_t& offset)
+{
+    file.append((8 - file.length()%8)%8, '\0');
+    offset = file.length();
+    file.append(static_cast<const char*>(data), length);
+}
+
+static bool SetIndex(MeshSnapshotHeader& header, const std::string& index_name, uint64_t index_stamp)
+{
+    if (sizeof(header.index_name) <= index_name.length())
+        return false;
+
+    memset(header.index_name, 0, sizeof(header.index_name));
+    memcpy(header.index_name, index_name.data(), index_name.length());
+    header.index_stamp = index_stamp;
+    return true;
+}
+
+static bool ReplaceFile(const char* filename, const std::string& file)
+{
+    std::string temporary_filename = std::string(filename) + ".tmp";
+    FILE* snapshot_file = fopen(temporary_filename.c_str(), "wb");
+    if (!snapshot_file)
+        return false;
+
+    bool ok = (file.size() == fwrite(file.data(), 1, file.size(), snapshot_file));
+    ok = (0 == fclose(snapshot_file)) && ok;
+    return ok && 0==rename(temporary_filename.c_str(), filename);
+}
+
+bool WriteSnapshot(const char* filename, const std::string& index_name, uint64_t index_stamp,
+                   const std::vector<Descriptor>& descriptors, const TreeIndex& tree_index)
+{
+    StringPool strings;
+
+    //Descriptors sorted by id, so MeSHWeb can binary search them
+    std::vector<size_t> descriptor_order(descriptors.size());
+    for (size_t i=0; i<descriptors.size(); i++)
+    {
+        descriptor_order[i] = i;
+    }
+    std::sort(descriptor_order.begin(), descriptor_order.end(), [&descriptors](size_t a, size_t b) {return descriptors[a].id < descriptors[b].id;});
+
+    std::vector<uint32_t> snapshot_descriptor_index(descriptors.size());
+    for (size_t i=0; i<descriptor_order.size(); i++)
+    {
+        snapshot_descriptor_index[descriptor_order[i]] = i;
+    }
+
+    //Every tree number once, sorted. The tree index knows which descriptor owns it
+    std::vector<std::string> tree_numbers;
+    std::vector<Descriptor>::const_iterator descriptor_iterator = descriptors.begin();
+    for (; descriptor_iterator!=descriptors.end(); ++descriptor_iterator)
+    {
+        tree_numbers.insert(tree_numbers.end(), descriptor_iterator->tree_numbers.begin(), descriptor_iterator->tree_numbers.end());
+    }
+    std::sort(tree_numbers.begin(), tree_numbers.end());
+    tree_numbers.erase(std::unique(tree_numbers.begin(), tree_numbers.end()), tree_numbers.end());
+
+    std::unordered_map<std::string, uint32_t> tree_number_index;
+    for (size_t i=0; i<tree_numbers.size(); i++)
+    {
+        tree_number_index[tree_numbers[i]] = i;
+    }
+
+    std::vector<MeshSnapshotTreeNumber> snapshot_tree_numbers(tree_numbers.size());
+    std::vector<uint32_t> children;
+    for (size_t i=0; i<tree_numbers.size(); i++)
+    {
+        size_t descriptor_index = 0;
+        tree_index.FindDescriptor(tree_numbers[i], descriptor_index);
+
+        MeshSnapshotTreeNumber& snapshot_tree_number = snapshot_tree_numbers[i];
+        snapshot_tree_number.tree_number = strings.Add(tree_numbers[i]);
+        snapshot_tree_number.descriptor = snapshot_descriptor_index[descriptor_index];
+        snapshot_tree_number.first_child = children.size();
+
+        const std::vector<std::string>& tree_number_children = tree_index.GetChildren(tree_numbers[i]);
+        std::vector<std::string>::const_iterator child_iterator = tree_number_children.begin();
+        for (; child_iterator!=tree_number_children.end(); ++child_iterator)
+        {
+            children.push_back(tree_number_index[*child_iterator]);
+        }
+        std::sort(children.begin()+snapshot_tree_number.first_child, children.end());
+        children.erase(std::unique(children.begin()+snapshot_tree_number.first_child, children.end()), children.end());
+        snapshot_tree_number.child_count = children.size() - snapshot_tree_number.first_child;
+    }
+
+    std::vector<MeshSnapshotDescriptor> snapshot_descriptors(descriptors.size());
+    std::vector<uint32_t> descriptor_tree_numbers;
+    for (size_t i=0; i<descriptor_order.size(); i++)
+    {
+        const Descriptor& descriptor = descriptors[descriptor_order[i]];
+        MeshSnapshotDescriptor& snapshot_descriptor = snapshot_descriptors[i];
+        snapshot_descriptor.id = strings.Add(descriptor.id);
+        snapshot_descriptor.nor_name = strings.Add(descriptor.nor_name);
+        snapshot_descriptor.eng_name = strings.Add(descriptor.eng_name);
+        snapshot_descriptor.flags = descriptor.top_node ? MESH_SNAPSHOT_TOP_NODE : 0;
+        snapshot_descriptor.first_tree_number = descriptor_tree_numbers.size();
+        snapshot_descriptor.tree_number_count = descriptor.tree_numbers.size();
+
+        std::vector<std::string>::const_iterator tree_number_iterator = descriptor.tree_numbers.begin();
+        for (; tree_number_iterator!=descriptor.tree_numbers.end(); ++tree_number_iterator)
+        {
+            descriptor_tree_numbers.push_back(tree_number_index[*tree_number_iterator]);
+        }
+    }
+
+    MeshSnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = MESH_SNAPSHOT_VERSION;
+    header.header_size = sizeof(header);
+    header.created = time(NULL);
+    if (!SetIndex(header, index_name, index_stamp))
+        return false;
+    header.descriptor_count = snapshot_descriptors.size();
+    header.tree_number_count = snapshot_tree_numbers.size();
+    header.child_count = children.size();
+    header.descriptor_tree_number_count = descriptor_tree_numbers.size();
+    header.strings_size = strings.GetData().size();
+
+    std::string file(sizeof(header), '\0');
+    AppendSection(file, snapshot_descriptors.data(), snapshot_descriptors.size()*sizeof(MeshSnapshotDescriptor), header.descriptors_offset);
+    AppendSection(file, snapshot_tree_numbers.data(), snapshot_tree_numbers.size()*sizeof(MeshSnapshotTreeNumber), header.tree_numbers_offset);
+    AppendSection(file, children.data(), children.size()*sizeof(uint32_t), header.children_offset);
+    AppendSection(file, descriptor_tree_numbers.data(), descriptor_tree_numbers.size()*sizeof(uint32_t), header.descriptor_tree_numbers_offset);
+    AppendSection(file, strings.GetData().data(), strings.GetData().size(), header.strings_offset);
+
+    header.file_size = file.size();
+    header.checksum = MeshSnapshotChecksum(file.data()+sizeof(header), file.size()-sizeof(header));
+    memcpy(&file[0], &header, sizeof(header));
+    return ReplaceFile(filename, file);
+}
+
+bool BindSnapshot(const char* filename, const std::string& index_name, uint64_t index_stamp)
+{
+    FILE* snapshot_file = fopen(filename, "rb");
+    if (!snapshot_file)
+        return false;
+
+    std::string file;
+    char buffer[64*1024];
+    size_t length;
+    while (0 < (length=fread(buffer, 1, sizeof(buffer), snapshot_file)))
+    {
+        file.append(buffer, length);
+    }
+    bool ok = !ferror(snapshot_file);
+    fclose(snapshot_file);
+
+    //The header is not part of the checksum, so the rest is written back unchanged
+    MeshSnapshotHeader header;
+    if (!ok || file.size()<sizeof(header))
+        return false;
+    memcpy(&header, file.data(), sizeof(header));
+    if (0!=memcmp(header.magic, MESH_SNAPSHOT_MAGIC, sizeof(header.magic)) || MESH_SNAPSHOT_VERSION!=header.version ||
+        sizeof(header)!=header.header_size || file.size()!=header.file_size || !SetIndex(header, index_name, index_stamp))
+        return false;
+
+    memcpy(&file[0], &header, sizeof(header));
+    return ReplaceFile(filename, file);
+}
@@ -0,0 +1,21 @@
+#ifndef _SNAPSHOT_WRITER_H_
+#define _SNAPSHOT_WRITER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "descriptor.h"
+#include "tree_index.h"
+
+
+// Writes the lookup tables MeSHWeb needs (see common/mesh_snapshot.h).
+// Written to a temporary file and renamed, so a running MeSHWeb never maps half a snapshot.
+bool WriteSnapshot(const char* filename, const std::string& index_name, uint64_t index_stamp,
+                   const std::vector<Descriptor>& descriptors, const TreeIndex& tree_index);
+
+// Sets the index of a snapshot written with --emit-ndjson, once its shards are loaded
+bool BindSnapshot(const char* filename, const std::string& index_name, uint64_t index_stamp);
+
+#endif // _SNAPSHOT_WRITER_H_
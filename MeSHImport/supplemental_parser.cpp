@@ -0,0 +1,288 @@
+#include "supplemental_parser.h"
+
+#include "descriptor_parser.h"
+
+
+static void AddElementText(std::vector<std::string>& values, xmlNodePtr text_ptr)
+{
+    const xmlChar* text = GetText(text_ptr);
+    if (text)
+    {
+        values.push_back(CONST_CHAR(text));
+    }
+}
+
+static void AddReferencedUI(std::vector<std::string>& ids, xmlNodePtr ui_ptr)
+{
+    const xmlChar* ui = GetText(ui_ptr);
+    if (ui)
+    {
+        ids.push_back(CONST_CHAR('*'==ui[0] ? ui+1 : ui)); //HeadingMappedTo stars main headings
+    }
+}
+
+static bool AddName(std::string& name, xmlNodePtr name_ptr)
+//<!ELEMENT SupplementalRecordName (String)>
+{
+    xmlNodePtr string_ptr = name_ptr->children;
+    if (NULL!=string_ptr && XML_ELEMENT_NODE==string_ptr->type && MESH_ELEMENT_STRING==GetMeshElement(string_ptr->name))
+    {
+        return NULL!=AddText(name, string_ptr);
+    }
+    return false;
+}
+
+static void ReadDescriptorReferredTo(xmlNodePtr descriptor_referred_to_ptr, std::vector<std::string>& ids, std::vector<std::string>* names)
+//<!ELEMENT DescriptorReferredTo (DescriptorUI, DescriptorName)>
+{
+    xmlNodePtr child = descriptor_referred_to_ptr->children;
+    while (NULL!=child)
+    {
+        if (XML_ELEMENT_NODE == child->type)
+        {
+            switch (GetMeshElement(child->name))
+            {
+                case MESH_ELEMENT_DESCRIPTOR_UI:
+                    AddReferencedUI(ids, child);
+                    break;
+                case MESH_ELEMENT_DESCRIPTOR_NAME:
+                    if (names && NULL!=child->children)
+                    {
+                        AddElementText(*names, child->children);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        child = child->next;
+    }
+}
+
+static void ReadHeadingMappedToList(SupplementalRecord& record, xmlNodePtr heading_mapped_to_list_ptr)
+//<!ELEMENT HeadingMappedToList (HeadingMappedTo)+>
+//<!ELEMENT HeadingMappedTo (DescriptorReferredTo, QualifierReferredTo?)>
+{
+    xmlNodePtr heading_mapped_to_ptr = heading_mapped_to_list_ptr->children;
+    while (NULL!=heading_mapped_to_ptr)
+    {
+        if (XML_ELEMENT_NODE==heading_mapped_to_ptr->type && MESH_ELEMENT_HEADING_MAPPED_TO==GetMeshElement(heading_mapped_to_ptr->name))
+        {
+            xmlNodePtr child = heading_mapped_to_ptr->children;
+            while (NULL!=child)
+            {
+                if (XML_ELEMENT_NODE == child->type)
+                {
+                    switch (GetMeshElement(child->name))
+                    {
+                        case MESH_ELEMENT_DESCRIPTOR_REFERRED_TO:
+                            ReadDescriptorReferredTo(child, record.heading_mapped_to, &record.heading_mapped_to_names);
+                            break;
+                        case MESH_ELEMENT_QUALIFIER_REFERRED_TO:
+                            for (xmlNodePtr qualifier_ptr=child->children; NULL!=qualifier_ptr; qualifier_ptr=qualifier_ptr->next)
+                            {
+                                if (XML_ELEMENT_NODE==qualifier_ptr->type && MESH_ELEMENT_QUALIFIER_UI==GetMeshElement(qualifier_ptr->name))
+                                {
+                                    AddReferencedUI(record.heading_mapped_to_qualifiers, qualifier_ptr);
+                                }
+                            }
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                child = child->next;
+            }
+        }
+        heading_mapped_to_ptr = heading_mapped_to_ptr->next;
+    }
+}
+
+static void ReadPharmacologicalActionList(SupplementalRecord& record, xmlNodePtr pharmacological_action_list_ptr)
+//<!ELEMENT PharmacologicalActionList (PharmacologicalAction)+>
+//<!ELEMENT PharmacologicalAction (DescriptorReferredTo)>
+{
+    xmlNodePtr pharmacological_action_ptr = pharmacological_action_list_ptr->children;
+    while (NULL!=pharmacological_action_ptr)
+    {
+        if (XML_ELEMENT_NODE==pharmacological_action_ptr->type && MESH_ELEMENT_PHARMACOLOGICAL_ACTION==GetMeshElement(pharmacological_action_ptr->name))
+        {
+            xmlNodePtr descriptor_referred_to_ptr = pharmacological_action_ptr->children;
+            if (NULL!=descriptor_referred_to_ptr && XML_ELEMENT_NODE==descriptor_referred_to_ptr->type &&
+                MESH_ELEMENT_DESCRIPTOR_REFERRED_TO==GetMeshElement(descriptor_referred_to_ptr->name))
+            {
+                ReadDescriptorReferredTo(descriptor_referred_to_ptr, record.pharmacological_actions, NULL);
+            }
+        }
+        pharmacological_action_ptr = pharmacological_action_ptr->next;
+    }
+}
+
+static void ReadSourceList(SupplementalRecord& record, xmlNodePtr source_list_ptr)
+//<!ELEMENT SourceList (Source)+>
+{
+    xmlNodePtr source_ptr = source_list_ptr->children;
+    while (NULL!=source_ptr)
+    {
+        if (XML_ELEMENT_NODE==source_ptr->type && MESH_ELEMENT_SOURCE==GetMeshElement(source_ptr->name))
+        {
+            AddElementText(record.sources, source_ptr);
+        }
+        source_ptr = source_ptr->next;
+    }
+}
+
+static void AddRegistryNumber(SupplementalRecord& record, xmlNodePtr registry_number_ptr)
+{
+    const xmlChar* registry_number = GetText(registry_number_ptr);
+    if (registry_number && 0!=xmlStrcmp(BAD_CAST("0"), registry_number)) //0 means there is none
+    {
+        record.registry_numbers.push_back(CONST_CHAR(registry_number));
+    }
+}
+
+static void ReadTermList(SupplementalRecord& record, bool preferred_concept, xmlNodePtr term_list_ptr)
+//<!ELEMENT TermList (Term+)>
+{
+    xmlNodePtr term_ptr = term_list_ptr->children;
+    while (NULL!=term_ptr)
+    {
+        if (XML_ELEMENT_NODE==term_ptr->type && MESH_ELEMENT_TERM==GetMeshElement(term_ptr->name))
+        {
+            std::string language = record.language_file;
+            const xmlChar* term_text = NULL;
+            bool preferred_term = preferred_concept && (0 == xmlStrcmp(BAD_CAST("Y"), GetAttribute("ConceptPreferredTermYN", term_ptr)));
+
+            xmlNodePtr child = term_ptr->children;
+            while (NULL!=child)
+            {
+                if (XML_ELEMENT_NODE == child->type)
+                {
+                    switch (GetMeshElement(child->name))
+                    {
+                        case MESH_ELEMENT_STRING:            term_text = GetText(child); break;
+                        case MESH_ELEMENT_TERM_UI:           AddElementText(record.other_ids, child); break;
+                        case MESH_ELEMENT_THESAURUS_ID_LIST: if (NULL!=child->children) GetLanguage(child, language); break;
+                        default: break;
+                    }
+                }
+                child = child->next;
+            }
+
+            if (term_text && !language.empty())
+            {
+                record.term_texts[language + (preferred_term ? "_preferred_term_text" : "_other_term_texts")].push_back(CONST_CHAR(term_text));
+            }
+        }
+        term_ptr = term_ptr->next;
+    }
+}
+
+static void ReadConceptList(SupplementalRecord& record, xmlNodePtr concept_list_ptr)
+//<!ELEMENT ConceptList (Concept+)>
+//<!ELEMENT Concept (ConceptUI, ConceptName, CASN1Name?, RegistryNumberList?, ScopeNote?, ..., TermList)>
+//Files before 2020 have RegistryNumber directly in Concept
+{
+    xmlNodePtr concept_ptr = concept_list_ptr->children;
+    while (NULL!=concept_ptr)
+    {
+        if (XML_ELEMENT_NODE==concept_ptr->type && MESH_ELEMENT_CONCEPT==GetMeshElement(concept_ptr->name))
+        {
+            bool preferred_concept = (0 == xmlStrcmp(BAD_CAST("Y"), GetAttribute("PreferredConceptYN", concept_ptr)));
+
+            xmlNodePtr child = concept_ptr->children;
+            while (NULL!=child)
+            {
+                if (XML_ELEMENT_NODE == child->type)
+                {
+                    switch (GetMeshElement(child->name))
+                    {
+                        case MESH_ELEMENT_CONCEPT_UI:
+                            AddElementText(record.other_ids, child);
+                            break;
+                        case MESH_ELEMENT_SCOPE_NOTE:
+                            if (preferred_concept && record.description.empty()) AddText(record.description, child);
+                            break;
+                        case MESH_ELEMENT_REGISTRY_NUMBER:
+                            AddRegistryNumber(record, child);
+                            break;
+                        case MESH_ELEMENT_REGISTRY_NUMBER_LIST:
+                            for (xmlNodePtr registry_number_ptr=child->children; NULL!=registry_number_ptr; registry_number_ptr=registry_number_ptr->next)
+                            {
+                                if (XML_ELEMENT_NODE==registry_number_ptr->type && MESH_ELEMENT_REGISTRY_NUMBER==GetMeshElement(registry_number_ptr->name))
+                                {
+                                    AddRegistryNumber(record, registry_number_ptr);
+                                }
+                            }
+                            break;
+                        case MESH_ELEMENT_TERM_LIST:
+                            ReadTermList(record, preferred_concept, child);
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                child = child->next;
+            }
+        }
+        concept_ptr = concept_ptr->next;
+    }
+}
+
+bool ProcessSupplementalRecord(xmlNodePtr supplemental_record_ptr, const std::string& language_code, SupplementalRecord& record)
+//<!ELEMENT SupplementalRecord (SupplementalRecordUI,
+//                              SupplementalRecordName,
+//                              DateCreated,
+//                              DateRevised?,
+//                              Note?,
+//                              Frequency?,
+//                              PreviousIndexingList?,
+//                              HeadingMappedToList?,
+//                              IndexingInformationList?,
+//                              PharmacologicalActionList?,
+//                              SourceList?,
+//                              ConceptList) >
+//<!ATTLIST SupplementalRecord SCRClass (1 | 2 | 3 | 4) "1">
+{
+    record.language_file = language_code;
+    const xmlChar* scr_class = GetAttribute("SCRClass", supplemental_record_ptr);
+    record.scr_class = scr_class ? CONST_CHAR(scr_class) : "1";
+
+    const xmlChar* id = NULL;
+    xmlNodePtr child = supplemental_record_ptr->children;
+    while (NULL!=child)
+    {
+        if (XML_ELEMENT_NODE == child->type)
+        {
+            switch (GetMeshElement(child->name))
+            {
+                case MESH_ELEMENT_SUPPLEMENTAL_RECORD_UI:      id = AddText(record.id, child); break;
+                case MESH_ELEMENT_SUPPLEMENTAL_RECORD_NAME:    AddName(record.name, child); break;
+                case MESH_ELEMENT_NOTE:                        AddText(record.description, child); break;
+                case MESH_ELEMENT_FREQUENCY:                   AddText(record.frequency, child); break;
+                case MESH_ELEMENT_HEADING_MAPPED_TO_LIST:      ReadHeadingMappedToList(record, child); break;
+                case MESH_ELEMENT_PHARMACOLOGICAL_ACTION_LIST: ReadPharmacologicalActionList(record, child); break;
+                case MESH_ELEMENT_SOURCE_LIST:                 ReadSourceList(record, child); break;
+                case MESH_ELEMENT_CONCEPT_LIST:                ReadConceptList(record, child); break;
+                default: break;
+            }
+        }
+        child = child->next;
+    }
+
+    return NULL!=id;
+}
+
+const xmlChar* GetSupplementalRecordUI(xmlNodePtr supplemental_record_ptr)
+{
+    xmlNodePtr child = supplemental_record_ptr->children;
+    while (NULL!=child)
+    {
+        if (XML_ELEMENT_NODE==child->type && MESH_ELEMENT_SUPPLEMENTAL_RECORD_UI==GetMeshElement(child->name))
+        {
+            return GetText(child);
+        }
+        child = child->next;
+    }
+    return NULL;
+}
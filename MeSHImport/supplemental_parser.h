@@ -0,0 +1,17 @@
+#ifndef _SUPPLEMENTAL_PARSER_H_
+#define _SUPPLEMENTAL_PARSER_H_
+
+#include <libxml/xmlreader.h>
+
+#include "supplemental_record.h"
+
+
+// Converts an expanded SupplementalRecord subtree from a file with the given
+// LanguageCode. Like ProcessDescriptorRecord, only reads the subtree and the
+// arguments, so several records can be converted in parallel.
+bool ProcessSupplementalRecord(xmlNodePtr supplemental_record_ptr, const std::string& language_code, SupplementalRecord& record);
+
+// Only the SupplementalRecordUI, or NULL. For finding a record again without converting it
+const xmlChar* GetSupplementalRecordUI(xmlNodePtr supplemental_record_ptr);
+
+#endif // _SUPPLEMENTAL_PARSER_H_
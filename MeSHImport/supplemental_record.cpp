@@ -0,0 +1,35 @@
+#include "supplemental_record.h"
+
+
+void SupplementalRecordToJson(const SupplementalRecord& record, JsonWriter& json)
+{
+    json.BeginObject();
+    json.StringMember("id", record.id);
+    json.StringMember("language_file", record.language_file);
+    json.StringMember("scr_class", record.scr_class);
+    if (!record.name.empty())
+    {
+        json.Key(record.language_file, "_name");
+        json.String(record.name);
+    }
+    if (!record.description.empty())
+    {
+        json.Key(record.language_file, "_description");
+        json.String(record.description);
+    }
+    json.StringMember("frequency", record.frequency);
+    json.StringArrayMember("heading_mapped_to", record.heading_mapped_to);
+    json.StringArrayMember("heading_mapped_to_names", record.heading_mapped_to_names);
+    json.StringArrayMember("heading_mapped_to_qualifiers", record.heading_mapped_to_qualifiers);
+    json.StringArrayMember("pharmacological_actions", record.pharmacological_actions);
+    json.StringArrayMember("registry_numbers", record.registry_numbers);
+    json.StringArrayMember("sources", record.sources);
+    json.StringArrayMember("other_ids", record.other_ids);
+
+    std::map<std::string, std::vector<std::string> >::const_iterator term_iterator = record.term_texts.begin();
+    for (; term_iterator!=record.term_texts.end(); ++term_iterator)
+    {
+        json.StringArrayMember(term_iterator->first, term_iterator->second);
+    }
+    json.EndObject();
+}
@@ -0,0 +1,33 @@
+#ifndef _SUPPLEMENTAL_RECORD_H_
+#define _SUPPLEMENTAL_RECORD_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "json_writer.h"
+
+
+// The parts of a SupplementalRecord (SCR) we index. SCRs do not refer to each
+// other, only to descriptors, so each one is indexed as soon as it is read.
+struct SupplementalRecord
+{
+    std::string id;
+    std::string language_file; //LanguageCode of the file, prefixes name and description
+    std::string scr_class; //1 chemical, 2 protocol, 3 rare disease, 4 organism
+    std::string name;
+    std::string description; //Note, or the preferred concept's ScopeNote
+    std::string frequency;
+    std::vector<std::string> heading_mapped_to; //DescriptorUIs, without the * that marks a main heading
+    std::vector<std::string> heading_mapped_to_names;
+    std::vector<std::string> heading_mapped_to_qualifiers; //QualifierUIs of descriptor/qualifier mappings
+    std::vector<std::string> pharmacological_actions; //DescriptorUIs
+    std::vector<std::string> registry_numbers;
+    std::vector<std::string> sources;
+    std::vector<std::string> other_ids;
+    std::map<std::string, std::vector<std::string> > term_texts; //Keyed by field name, e.g. "eng_other_term_texts"
+};
+
+void SupplementalRecordToJson(const SupplementalRecord& record, JsonWriter& json);
+
+#endif // _SUPPLEMENTAL_RECORD_H_
@@ -0,0 +1,81 @@
+#include "tree_index.h"
+
+
+void TreeIndex::Add(const std::string& tree_number, const std::string& parent_tree_number, size_t descriptor_index)
+{
+    m_descriptors[tree_number] = descriptor_index;
+    if (!parent_tree_number.empty())
+    {
+        m_children[parent_tree_number].push_back(tree_number);
+    }
+}
+
+void TreeIndex::Clear()
+{
+    m_descriptors.clear();
+    m_children.clear();
+    m_descendant_counts.clear();
+}
+
+bool TreeIndex::FindDescriptor(const std::string& tree_number, size_t& descriptor_index) const
+{
+    std::unordered_map<std::string, size_t>::const_iterator iterator = m_descriptors.find(tree_number);
+    if (m_descriptors.end() == iterator)
+        return false;
+
+    descriptor_index = iterator->second;
+    return true;
+}
+
+const std::vector<std::string>& TreeIndex::GetChildren(const std::string& parent_tree_number) const
+{
+    std::unordered_map<std::string, std::vector<std::string> >::const_iterator iterator = m_children.find(parent_tree_number);
+    return (m_children.end() == iterator) ? m_no_children : iterator->second;
+}
+
+void TreeIndex::CountDescendants()
+{
+    m_descendant_counts.clear();
+    std::unordered_map<std::string, size_t>::const_iterator iterator = m_descriptors.begin();
+    for (; iterator!=m_descriptors.end(); ++iterator)
+    {
+        CountDescendants(iterator->first);
+    }
+}
+
+long TreeIndex::GetDescendantCount(const std::string& tree_number) const
+{
+    std::unordered_map<std::string, long>::const_iterator iterator = m_descendant_counts.find(tree_number);
+    return (m_descendant_counts.end() == iterator) ? 0 : iterator->second;
+}
+
+long TreeIndex::CountDescendants(const std::string& tree_number)
+{
+    std::unordered_map<std::string, long>::const_iterator count_iterator = m_descendant_counts.find(tree_number);
+    if (m_descendant_counts.end() != count_iterator)
+        return count_iterator->second;
+
+    //Each subtree is counted once, the tree is at most about a dozen levels deep
+    long count = 0;
+    const std::vector<std::string>& children = GetChildren(tree_number);
+    std::vector<std::string>::const_iterator child_iterator = children.begin();
+    for (; child_iterator!=children.end(); ++child_iterator)
+    {
+        if (*child_iterator != tree_number) //A forced topnode is its own parent
+        {
+            count += 1 + CountDescendants(*child_iterator);
+        }
+    }
+    m_descendant_counts[tree_number] = count;
+    return count;
+}
+
+void TreeIndex::GetParentTreeNumber(const std::string& tree_number, bool topnodes_forced, std::string& parent_tree_number)
+{
+    size_t substring_length = tree_number.find_last_of('.');
+    if (std::string::npos==substring_length && topnodes_forced && !tree_number.empty())
+    {
+        substring_length = 1; //If we are forcing topnodes, "D" is the valid parent for "D01" (without dot..)
+    }
+    parent_tree_number = (std::string::npos==substring_length) ? "" : tree_number.substr(0, substring_length);
+}
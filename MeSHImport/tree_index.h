@@ -0,0 +1,36 @@
+#ifndef _TREE_INDEX_H_
+#define _TREE_INDEX_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// Tree number -> descriptor and parent -> children lookups, built while the
+// MeSH file is streamed so the hierarchy never has to be queried back from ES.
+class TreeIndex
+{
+public:
+    void Add(const std::string& tree_number, const std::string& parent_tree_number, size_t descriptor_index);
+    void Clear();
+
+    bool FindDescriptor(const std::string& tree_number, size_t& descriptor_index) const;
+    const std::vector<std::string>& GetChildren(const std::string& parent_tree_number) const;
+
+    void CountDescendants(); //When all tree numbers are added, before GetDescendantCount()
+    long GetDescendantCount(const std::string& tree_number) const;
+
+public:
+    static void GetParentTreeNumber(const std::string& tree_number, bool topnodes_forced, std::string& parent_tree_number);
+
+private:
+    long CountDescendants(const std::string& tree_number);
+
+private:
+    std::unordered_map<std::string, size_t> m_descriptors;
+    std::unordered_map<std::string, std::vector<std::string> > m_children;
+    std::vector<std::string> m_no_children;
+    std::unordered_map<std::string, long> m_descendant_counts;
+};
+
+#endif // _TREE_INDEX_H_
@@ -0,0 +1,167 @@
+#include "versioned_index.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#include <algorithm>
+
+
+VersionedIndex::VersionedIndex(const std::string& es_location, const std::string& alias)
+: m_http(es_location, true),
+  m_alias(alias)
+{
+}
+
+bool VersionedIndex::Create(const std::string& settings_and_mappings)
+{
+    char timestamp[sizeof("YYYYMMDDhhmmss")];
+    time_t now = time(NULL);
+    struct tm now_tm;
+    strftime(timestamp, sizeof(timestamp), "%Y%m%d%H%M%S", gmtime_r(&now, &now_tm));
+
+    m_name = m_alias + "_" + timestamp;
+    return Request(&HTTP::put, m_name, settings_and_mappings);
+}
+
+bool VersionedIndex::Reopen(const std::string& name)
+{
+    if (!IsVersion(name))
+        return false;
+
+    unsigned int status;
+    try
+    {
+        status = m_http.head(name.c_str(), NULL, NULL);
+    }
+    catch(...)
+    {
+        status = 0;
+    }
+    if (200 != status)
+        return false;
+
+    m_name = name;
+    return true;
+}
+
+bool VersionedIndex::Publish(int replicas, int keep_versions)
+{
+    if (!Request(&HTTP::post, m_name + "/_forcemerge?max_num_segments=1", "") ||
+        !Request(&HTTP::put, m_name + "/_settings", "{\"index\": {\"refresh_interval\": null, \"number_of_replicas\": " + std::to_string(replicas) + "}}") ||
+        !Request(&HTTP::post, m_name + "/_refresh", ""))
+    {
+        return false;
+    }
+
+    std::vector<std::string> aliased_indices;
+    if (!GetAliasedIndices(aliased_indices))
+        return false;
+
+    std::string actions = "{\"actions\": [{\"add\": {\"index\": \"" + m_name + "\", \"alias\": \"" + m_alias + "\"}}";
+    if (aliased_indices.empty() && 200==m_http.head(m_alias.c_str(), NULL, NULL))
+    {
+        //The live index predates versioning and has the alias' name. Replace it in the same atomic request
+        actions += ", {\"remove_index\": {\"index\": \"" + m_alias + "\"}}";
+    }
+    std::vector<std::string>::const_iterator index_iterator = aliased_indices.begin();
+    for (; index_iterator!=aliased_indices.end(); ++index_iterator)
+    {
+        actions += ", {\"remove\": {\"index\": \"" + *index_iterator + "\", \"alias\": \"" + m_alias + "\"}}";
+    }
+    actions += "]}";
+
+    if (!Request(&HTTP::post, "_aliases", actions))
+        return false;
+
+    //Versions sort by age. Keep the new one, and the newest keep_versions before it for rolling back
+    std::vector<std::string> versions;
+    if (GetVersions(versions))
+    {
+        std::sort(versions.begin(), versions.end());
+        versions.erase(std::remove(versions.begin(), versions.end(), m_name), versions.end());
+        for (size_t i=0; i+keep_versions<versions.size(); i++)
+        {
+            Request(&HTTP::remove, versions[i], "");
+        }
+    }
+    return true;
+}
+
+bool VersionedIndex::Request(unsigned int (HTTP::*method)(const char*, const char*, Json::Object*),
+                             const std::string& url, const std::string& data, Json::Object* result)
+{
+    Json::Object response;
+    unsigned int status;
+    try
+    {
+        status = (m_http.*method)(url.c_str(), data.empty() ? NULL : data.c_str(), result ? result : &response);
+    }
+    catch(...)
+    {
+        status = 0;
+    }
+
+    if (200 != status)
+    {
+        fprintf(stderr, "\nRequest to %s failed with HTTP status %u\n", url.c_str(), status);
+        return false;
+    }
+    return true;
+}
+
+bool VersionedIndex::IsVersion(const std::string& index) const
+{
+    //<alias>_ followed by the 14 digit timestamp. Other <alias>_ indices are not ours
+    const std::string prefix = m_alias + "_";
+    if (index.length()!=prefix.length()+14 || 0!=index.compare(0, prefix.length(), prefix))
+        return false;
+
+    return index.end() == std::find_if(index.begin()+prefix.length(), index.end(), [](char c) {return c<'0' || c>'9';});
+}
+
+bool VersionedIndex::GetAliasedIndices(std::vector<std::string>& indices)
+{
+    indices.clear();
+
+    Json::Object result;
+    unsigned int status;
+    try
+    {
+        status = m_http.get(("_alias/" + m_alias).c_str(), NULL, &result);
+    }
+    catch(...)
+    {
+        status = 0;
+    }
+
+    if (404 == status) //No alias yet
+        return true;
+    if (200 != status)
+        return false;
+
+    Json::Object::const_iterator index_iterator = result.begin();
+    for (; index_iterator!=result.end(); ++index_iterator)
+    {
+        indices.push_back(index_iterator->first);
+    }
+    return true;
+}
+
+bool VersionedIndex::GetVersions(std::vector<std::string>& versions)
+{
+    versions.clear();
+
+    Json::Object result;
+    if (!Request(&HTTP::get, m_alias + "_*/_alias", "", &result))
+        return false;
+
+    Json::Object::const_iterator index_iterator = result.begin();
+    for (; index_iterator!=result.end(); ++index_iterator)
+    {
+        if (IsVersion(index_iterator->first))
+        {
+            versions.push_back(index_iterator->first);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef _VERSIONED_INDEX_H_
+#define _VERSIONED_INDEX_H_
+
+#include <string>
+#include <vector>
+
+#include "http/http.h"
+
+#define DEFAULT_REPLICAS      (1)
+#define DEFAULT_KEEP_VERSIONS (1)
+
+
+// Builds a fresh <alias>_<UTC timestamp> index next to the live one, and only
+// points the alias at it when the import is done, so searches never see an
+// empty or half-filled index.
+class VersionedIndex
+{
+public:
+    VersionedIndex(const std::string& es_location, const std::string& alias);
+
+public:
+    bool Create(const std::string& settings_and_mappings); //Settings should be tuned for writing, see Publish()
+    bool Reopen(const std::string& name); //Continues filling an unpublished version Create() made earlier
+    const std::string& GetName() const {return m_name;}
+
+    // Force-merges, restores refresh and replicas, swaps the alias in one request and
+    // deletes all but keep_versions of the previous versions
+    bool Publish(int replicas, int keep_versions);
+
+private:
+    bool Request(unsigned int (HTTP::*method)(const char*, const char*, Json::Object*),
+                 const std::string& url, const std::string& data, Json::Object* result=NULL);
+    bool IsVersion(const std::string& index) const;
+    bool GetAliasedIndices(std::vector<std::string>& indices);
+    bool GetVersions(std::vector<std::string>& versions);
+
+private:
+    HTTP m_http;
+    std::string m_alias;
+    std::string m_name;
+};
+
+#endif // _VERSIONED_INDEX_H_
@@ -10,6 +10,7 @@
 #include "about_tab.h"
 #include "search_tab.h"
 #include "hierarchy_tab.h"
+#include "snapshot.h"
 
 
 MeSHApplication::MeSHApplication(const Wt::WEnvironment& environment)
@@ -23,6 +24,7 @@ MeSHApplication::MeSHApplication(const Wt::WEnvironment& environment)
   messageResourceBundle().use(appRoot() + "strings");
 
   m_es_util = std::make_shared<ElasticSearchUtil>();
+  MeshSnapshot::Refresh(appRoot(), *m_es_util); //Picks up a snapshot from a new import without restarting
 
   setTitle(Wt::WString::tr("AppName"));
 
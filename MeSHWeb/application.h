@@ -19,6 +19,7 @@
 #define SUGGESTIONLIST_ITEM_ID_ROLE     (Wt::ItemDataRole::User)
 #define HIERARCHY_ITEM_TREE_NUMBER_ROLE (Wt::ItemDataRole::User+1)
 #define HIERARCHY_ITEM_ID_ROLE          (Wt::ItemDataRole::User+2)
+#define HIERARCHY_ITEM_NAME_ROLE        (Wt::ItemDataRole::User+3) //Without the " [<tree number>]" of the text
 
 
 class MeSHApplication : public Wt::WApplication
@@ -1,9 +1,12 @@
 #include "elasticsearchutil.h"
 
+#define ELASTICSEARCH_LOCATION "localhost:9200"
+
 
 ElasticSearchUtil::ElasticSearchUtil()
 {
-	m_es = std::make_unique<ElasticSearch>("localhost:9200");
+	m_es = std::make_unique<ElasticSearch>(ELASTICSEARCH_LOCATION);
+	m_http = std::make_unique<HTTP>(ELASTICSEARCH_LOCATION);
 }
 
 long ElasticSearchUtil::search(const std::string& index, const std::string& query, Json::Object& search_result)
@@ -44,3 +47,27 @@ bool ElasticSearchUtil::upsert(const std::string& index, const std::string& id,
 		return false;
     }
 }
+
+bool ElasticSearchUtil::getIndexMeta(const std::string& index, std::string& index_name, Json::Object& meta)
+{
+	try
+	{
+        errno = 0;
+		Json::Object result;
+		if (200 != m_http->get((index + "/_mapping?filter_path=*.mappings._meta").c_str(), NULL, &result))
+			return false;
+
+		index_name.clear();
+		meta = Json::Object();
+		if (!result.empty()) //{"<index name>": {"mappings": {"_meta": {...}}}}
+		{
+			index_name = result.begin()->first;
+			meta = result.begin()->second.getObject().getValue("mappings").getObject().getValue("_meta").getObject();
+		}
+		return true;
+	}
+    catch(...)
+	{
+		return false;
+    }
+}
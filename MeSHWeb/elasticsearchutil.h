@@ -2,6 +2,7 @@
 #define _ELASTICSEARCHUTIL_H_
 
 #include "elasticsearch/elasticsearch.h"
+#include "http/http.h"
 
 #include <memory>
 
@@ -19,8 +20,12 @@ public:
 
 	bool upsert(const std::string& index, const std::string& id, const Json::Object& jData);
 
+	//The _meta of the index an alias points to. index_name is empty if the index has none
+	bool getIndexMeta(const std::string& index, std::string& index_name, Json::Object& meta);
+
 private:
 	std::unique_ptr<ElasticSearch> m_es;
+	std::unique_ptr<HTTP> m_http;
 };
 
 #endif // _ELASTICSEARCHUTIL_H_
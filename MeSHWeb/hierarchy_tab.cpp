@@ -1,5 +1,7 @@
 #include "hierarchy_tab.h"
 
+#include <string.h>
+
 #include <Wt/WStandardItem.h>
 
 #include "application.h"
@@ -34,6 +36,23 @@ void HierarchyTab::PopulateHierarchy()
     return;
   }
 
+  std::shared_ptr<const MeshSnapshot> snapshot = MeshSnapshot::Get();
+  if (snapshot)
+  {
+    int row = 0;
+    for (uint32_t i=0; i<snapshot->GetTreeNumberCount(); i++)
+    {
+      if (nullptr != strchr(snapshot->GetTreeNumber(i), '.') ||
+          !snapshot->IsTopNode(snapshot->GetTreeNumberDescriptor(i)))
+        continue;
+
+      m_hierarchy_model->setItem(row++, 0, CreateSnapshotItem(*snapshot, i));
+    }
+    m_hierarchy_model->sort(0);
+    m_has_populated_hierarchy_model = true;
+    return;
+  }
+
   Wt::WString query = Wt::WString::tr("HierarchyTopNodesQuery");
 
   Json::Object search_result;
@@ -95,6 +114,7 @@ void HierarchyTab::PopulateHierarchy()
         AddChildPlaceholderIfNeeded(source_object, tree_number_value_string, item);
         item->setData(Wt::cpp17::any(tree_number_value_string), HIERARCHY_ITEM_TREE_NUMBER_ROLE);
         item->setData(Wt::cpp17::any(id_value_string), HIERARCHY_ITEM_ID_ROLE);
+        item->setData(Wt::cpp17::any(name_str), HIERARCHY_ITEM_NAME_ROLE);
         m_hierarchy_model->setItem(row++, 0, std::move(item));
       }
     }
@@ -167,7 +187,31 @@ void HierarchyTab::TreeItemExpanded(const Wt::WModelIndex& index)
   standard_item->takeChild(0, 0);
 
   std::string parent_tree_number_string = Wt::cpp17::any_cast<std::string>(standard_item->data(HIERARCHY_ITEM_TREE_NUMBER_ROLE));
-  //Fetch all children from ElasticSearch
+
+  std::shared_ptr<const MeshSnapshot> snapshot = MeshSnapshot::Get();
+  uint32_t parent_index;
+  if (snapshot && snapshot->FindTreeNumber(parent_tree_number_string, parent_index))
+  {
+    uint32_t child_count = snapshot->GetChildCount(parent_index);
+    for (uint32_t i=0; i<child_count; i++)
+    {
+      standard_item->setChild(i, 0, CreateSnapshotItem(*snapshot, snapshot->GetChild(parent_index, i)));
+    }
+    if (0 < child_count)
+    {
+      m_hierarchy_model->sort(0);
+    }
+    return;
+  }
+
+  //The parent's document summarizes its children, so only that document is fetched
+  std::string parent_id_string = Wt::cpp17::any_cast<std::string>(standard_item->data(HIERARCHY_ITEM_ID_ROLE));
+  if (AddSummarizedChildren(standard_item, parent_id_string, parent_tree_number_string))
+  {
+    return;
+  }
+
+  //Index without child summaries. Fetch all children from ElasticSearch
   Wt::WString query = Wt::WString::tr("HierarchyChildrenQuery").arg(parent_tree_number_string);
 
   Json::Object search_result;
@@ -224,6 +268,7 @@ void HierarchyTab::TreeItemExpanded(const Wt::WModelIndex& index)
         AddChildPlaceholderIfNeeded(source_object, tree_number_value_string, item);
         item->setData(Wt::cpp17::any(tree_number_value_string), HIERARCHY_ITEM_TREE_NUMBER_ROLE);
         item->setData(Wt::cpp17::any(id_value_string), HIERARCHY_ITEM_ID_ROLE);
+        item->setData(Wt::cpp17::any(name_str), HIERARCHY_ITEM_NAME_ROLE);
         standard_item->setChild(row++, 0, std::move(item));
         added_items = true;
       }
@@ -253,10 +298,15 @@ void HierarchyTab::TreeItemClicked(const Wt::WModelIndex& index, const Wt::WMous
   m_hierarchy_popup_menu->setAutoHide(true, 1000);
 
   m_popup_menu_id_string = Wt::cpp17::any_cast<std::string>(standard_item->data(HIERARCHY_ITEM_ID_ROLE));
+  m_popup_menu_tree_number_string = Wt::cpp17::any_cast<std::string>(standard_item->data(HIERARCHY_ITEM_TREE_NUMBER_ROLE));
+  m_popup_menu_name_string = Wt::cpp17::any_cast<std::string>(standard_item->data(HIERARCHY_ITEM_NAME_ROLE));
 
-  Wt::WString soek = Wt::WString::tr("SearchFromHierarchy").arg(standard_item->text().toUTF8());
+  Wt::WString soek = Wt::WString::tr("SearchFromHierarchy").arg(m_popup_menu_name_string);
   m_hierarchy_popup_menu->addItem(soek)->triggered().connect(this, &HierarchyTab::PopupMenuTriggered);
 
+  Wt::WString soek_innenfor = Wt::WString::tr("SearchWithinHierarchy").arg(m_popup_menu_name_string);
+  m_hierarchy_popup_menu->addItem(soek_innenfor)->triggered().connect(this, &HierarchyTab::SubtreeMenuTriggered);
+
   m_hierarchy_popup_menu->popup(mouse);
 }
 
@@ -270,6 +320,17 @@ void HierarchyTab::PopupMenuTriggered(Wt::WMenuItem* item)
   }
 }
 
+void HierarchyTab::SubtreeMenuTriggered(Wt::WMenuItem* item)
+{
+  if (item && !m_popup_menu_tree_number_string.empty())
+  {
+    m_mesh_application->ClearLayout();
+    m_mesh_application->SetActiveTab(MeSHApplication::TAB_INDEX_SEARCH);
+    m_mesh_application->GetSearch()->SetSubtree(m_popup_menu_tree_number_string, m_popup_menu_name_string);
+    m_mesh_application->GetSearch()->FocusSearchEdit();
+  }
+}
+
 void HierarchyTab::ExpandTreeNumberRecursive(const std::string& current_tree_number_string, Wt::WModelIndex& model_index)
 {
   std::string parent_tree_number_string;
@@ -318,11 +379,84 @@ bool HierarchyTab::FindChildModelIndex(const std::string& tree_number_string, bo
   }
 }
 
+bool HierarchyTab::AddSummarizedChildren(Wt::WStandardItem* standard_item, const std::string& parent_id_string, const std::string& parent_tree_number_string)
+{
+  if (parent_id_string.empty())
+  {
+    return false;
+  }
+
+  Wt::WString query = Wt::WString::tr("HierarchyChildSummariesQuery").arg(parent_id_string);
+
+  Json::Object search_result;
+  auto es_util = m_mesh_application->GetElasticSearchUtil();
+  long result_size = es_util->search("mesh", query.toUTF8(), search_result);
+  if (0 == result_size)
+  {
+    return false;
+  }
+
+  const Json::Value value = search_result.getValue("hits");
+  const Json::Object value_object = value.getObject();
+  const Json::Value hits_value = value_object.getValue("hits");
+  const Json::Array hits_array = hits_value.getArray();
+  if (hits_array.begin() == hits_array.end())
+  {
+    return false;
+  }
+
+  const Json::Value hit_value = *hits_array.begin();
+  const Json::Object hit_value_object = hit_value.getObject();
+  const Json::Value source_value = hit_value_object.getValue("_source");
+  const Json::Object source_object = source_value.getObject();
+  if (!source_object.member("child_summaries")) //Imported before children were summarized
+  {
+    return false;
+  }
+
+  int row = 0;
+  const Json::Value child_summaries_value = source_object.getValue("child_summaries");
+  const Json::Array child_summaries_array = child_summaries_value.getArray();
+  Json::Array::const_iterator child_iterator = child_summaries_array.begin();
+  for (; child_iterator!=child_summaries_array.end(); ++child_iterator)
+  {
+    const Json::Value child_value = *child_iterator;
+    const Json::Object child_object = child_value.getObject();
+    if (EQUAL != parent_tree_number_string.compare(child_object.getValue("parent_tree_number").getString()) || //Child of another of the parent's tree_numbers
+        child_object.getValue("id").getString().empty())
+      continue;
+
+    standard_item->setChild(row++, 0, CreateSummaryItem(child_object));
+  }
+
+  if (0 < row)
+  {
+    m_hierarchy_model->sort(0);
+  }
+  return true;
+}
+
 bool HierarchyTab::AddChildPlaceholderIfNeeded(const Json::Object& source_object, const std::string& current_tree_number_string, std::unique_ptr<Wt::WStandardItem>& current_item)
 {
   bool added_placeholder = false;
+  if (source_object.member("child_summaries"))
+  {
+    const Json::Value child_summaries_value = source_object.getValue("child_summaries");
+    const Json::Array child_summaries_array = child_summaries_value.getArray();
+    Json::Array::const_iterator child_iterator = child_summaries_array.begin();
+    for (; child_iterator!=child_summaries_array.end() && !added_placeholder; ++child_iterator)
+    {
+      const Json::Value child_value = *child_iterator;
+      const Json::Object child_object = child_value.getObject();
+      if (EQUAL == current_tree_number_string.compare(child_object.getValue("parent_tree_number").getString()))
+      {
+        current_item->setChild(0, 0, std::make_unique<Wt::WStandardItem>(Wt::WString(""))); //Placeholder, adds the [+]-icon
+        added_placeholder = true;
+      }
+    }
+  }
   //Check if we have a matching child in the child_tree_numbers array
-  if (source_object.member("child_tree_numbers"))
+  else if (source_object.member("child_tree_numbers"))
   {
     std::string possible_parent_tree_number_string;
 
@@ -343,6 +477,52 @@ bool HierarchyTab::AddChildPlaceholderIfNeeded(const Json::Object& source_object
   return added_placeholder;
 }
 
+std::unique_ptr<Wt::WStandardItem> HierarchyTab::CreateSnapshotItem(const MeshSnapshot& snapshot, uint32_t tree_number_index)
+{
+  uint32_t descriptor = snapshot.GetTreeNumberDescriptor(tree_number_index);
+  std::string tree_number_string = snapshot.GetTreeNumber(tree_number_index);
+
+  std::string name_str = snapshot.GetName(descriptor);
+
+  std::stringstream node_text;
+  node_text << name_str << " [" << tree_number_string << "]";
+
+  auto item = std::make_unique<Wt::WStandardItem>(Wt::WString::fromUTF8(node_text.str()));
+  if (0 < snapshot.GetChildCount(tree_number_index))
+  {
+    item->setChild(0, 0, std::make_unique<Wt::WStandardItem>(Wt::WString(""))); //Placeholder, adds the [+]-icon
+  }
+  item->setData(Wt::cpp17::any(tree_number_string), HIERARCHY_ITEM_TREE_NUMBER_ROLE);
+  item->setData(Wt::cpp17::any(std::string(snapshot.GetId(descriptor))), HIERARCHY_ITEM_ID_ROLE);
+  item->setData(Wt::cpp17::any(name_str), HIERARCHY_ITEM_NAME_ROLE);
+  return item;
+}
+
+std::unique_ptr<Wt::WStandardItem> HierarchyTab::CreateSummaryItem(const Json::Object& child_object)
+{
+  std::string name_str;
+  SearchTab::InfoFromSourceObject(child_object, name_str); //Summaries have the same name fields as a descriptor
+  std::string tree_number_string = child_object.getValue("tree_number").getString();
+  int descendant_count = child_object.member("descendant_count") ? child_object.getValue("descendant_count").getInt() : 0;
+
+  std::stringstream node_text;
+  node_text << name_str << " [" << tree_number_string << "]";
+  if (0 < descendant_count)
+  {
+    node_text << " (" << descendant_count << ")";
+  }
+
+  auto item = std::make_unique<Wt::WStandardItem>(Wt::WString::fromUTF8(node_text.str()));
+  if (child_object.member("child_count") && 0<child_object.getValue("child_count").getInt())
+  {
+    item->setChild(0, 0, std::make_unique<Wt::WStandardItem>(Wt::WString(""))); //Placeholder, adds the [+]-icon
+  }
+  item->setData(Wt::cpp17::any(tree_number_string), HIERARCHY_ITEM_TREE_NUMBER_ROLE);
+  item->setData(Wt::cpp17::any(child_object.getValue("id").getString()), HIERARCHY_ITEM_ID_ROLE);
+  item->setData(Wt::cpp17::any(name_str), HIERARCHY_ITEM_NAME_ROLE);
+  return item;
+}
+
 void HierarchyTab::GetParentTreeNumber(const std::string& child_tree_number, std::string& parent_tree_number)
 {
   size_t substring_length = child_tree_number.find_last_of('.');
@@ -6,6 +6,7 @@
 #include <Wt/WTemplate.h>
 
 #include "elasticsearchutil.h"
+#include "snapshot.h"
 
 
 class MeSHApplication;
@@ -24,11 +25,15 @@ protected:
   void TreeItemExpanded(const Wt::WModelIndex& index);
   void TreeItemClicked(const Wt::WModelIndex& index, const Wt::WMouseEvent& mouse);
   void PopupMenuTriggered(Wt::WMenuItem* item);
+  void SubtreeMenuTriggered(Wt::WMenuItem* item);
 
 private:
   void ExpandTreeNumberRecursive(const std::string& current_tree_number_string, Wt::WModelIndex& model_index);
   bool FindChildModelIndex(const std::string& tree_number_string, bool top_level, Wt::WModelIndex& index);
+  bool AddSummarizedChildren(Wt::WStandardItem* standard_item, const std::string& parent_id_string, const std::string& parent_tree_number_string);
   bool AddChildPlaceholderIfNeeded(const Json::Object& source_object, const std::string& current_tree_number_string, std::unique_ptr<Wt::WStandardItem>& current_item);
+  std::unique_ptr<Wt::WStandardItem> CreateSnapshotItem(const MeshSnapshot& snapshot, uint32_t tree_number_index);
+  std::unique_ptr<Wt::WStandardItem> CreateSummaryItem(const Json::Object& child_object);
 public:
   static void GetParentTreeNumber(const std::string& child_tree_number, std::string& parent_tree_number);
   
@@ -43,6 +48,8 @@ private:
 
   std::unique_ptr<Wt::WPopupMenu> m_hierarchy_popup_menu;
   std::string m_popup_menu_id_string;
+  std::string m_popup_menu_tree_number_string;
+  std::string m_popup_menu_name_string;
 };
 
 #endif // _HIERARCHY_TAB_H_
@@ -200,6 +200,23 @@ void MeshResult::OnSearch(const Wt::WString& mesh_id, const std::string& search_
   {
     setCondition("show-related", true);
 
+    //Names resolved by the importer. Indexes without them look up each link
+    std::map<std::string, std::string> see_related_titles;
+    if (source_object.member("see_related_names"))
+    {
+      const Json::Array see_related_names_array = source_object.getValue("see_related_names").getArray();
+      Json::Array::const_iterator see_related_name_iterator = see_related_names_array.begin();
+      for (; see_related_name_iterator!=see_related_names_array.end(); ++see_related_name_iterator)
+      {
+        const Json::Value see_related_name_value = *see_related_name_iterator;
+        const Json::Object see_related_name_object = see_related_name_value.getObject();
+        std::string see_related_name_id;
+        std::string see_related_name;
+        SearchTab::InfoFromSourceObject(see_related_name_object, see_related_name, &see_related_name_id);
+        see_related_titles[see_related_name_id] = see_related_name;
+      }
+    }
+
     const Json::Array see_related_array = source_object.getValue("see_related").getArray();
     Json::Array::const_iterator see_related_iterator = see_related_array.begin();
     for (; see_related_iterator!=see_related_array.end(); ++see_related_iterator)
@@ -208,7 +225,15 @@ void MeshResult::OnSearch(const Wt::WString& mesh_id, const std::string& search_
 
       std::string see_related_id = see_related_value.getString();
       std::string title;
-      SearchTab::MeSHToName(es_util, see_related_id, title);
+      std::map<std::string, std::string>::const_iterator title_iterator = see_related_titles.find(see_related_id);
+      if (see_related_titles.end() != title_iterator)
+      {
+        title = title_iterator->second;
+      }
+      else
+      {
+        SearchTab::MeSHToName(es_util, see_related_id, title);
+      }
       std::string url = (Wt::WString::tr("MeshIdInternalPath")+"&"+Wt::WString::tr("MeshIdInternalPathParam").arg(see_related_id)).toUTF8();
       auto see_related_anchor = std::make_unique<Wt::WAnchor>(Wt::WLink(Wt::LinkType::InternalPath, url), Wt::WString::fromUTF8(title));
       see_related_anchor->setStyleClass("mesh-link");
@@ -288,7 +313,8 @@ void MeshResult::SetOtherTermTexts(Wt::WLayout* term_layout, const Json::Array&
   }
 }
 
-void MeshResult::RecursiveAddHierarchyItem(std::shared_ptr<ElasticSearchUtil> es_util, int& row, std::map<std::string, Wt::WStandardItem*>& node_map, const std::string& tree_number, bool mark_item) {
+void MeshResult::RecursiveAddHierarchyItem(std::shared_ptr<ElasticSearchUtil> es_util, int& row, std::map<std::string, Wt::WStandardItem*>& node_map,
+                                           const std::map<std::string, std::pair<std::string, std::string> >& known_nodes, const std::string& tree_number, bool mark_item) {
   if (tree_number.empty() || //parent of top-node
     0<node_map.count(tree_number)) //Already added?
   {
@@ -298,11 +324,20 @@ void MeshResult::RecursiveAddHierarchyItem(std::shared_ptr<ElasticSearchUtil> es
   //Make sure parent is added
   std::string parent_tree_number;
   HierarchyTab::GetParentTreeNumber(tree_number, parent_tree_number);
-  RecursiveAddHierarchyItem(es_util, row, node_map, parent_tree_number, false);
+  RecursiveAddHierarchyItem(es_util, row, node_map, known_nodes, parent_tree_number, false);
 
   std::string name;
   std::string mesh_id;
-  SearchTab::TreeNumberToName(es_util, tree_number, name, &mesh_id);
+  std::map<std::string, std::pair<std::string, std::string> >::const_iterator known_iterator = known_nodes.find(tree_number);
+  if (known_nodes.end() != known_iterator) //From the document itself, no lookup needed
+  {
+    name = known_iterator->second.first;
+    mesh_id = known_iterator->second.second;
+  }
+  else
+  {
+    SearchTab::TreeNumberToName(es_util, tree_number, name, &mesh_id);
+  }
   std::stringstream node_text;
   node_text << name;
   if (!tree_number.empty())
@@ -341,14 +376,35 @@ void MeshResult::PopulateHierarchy(std::shared_ptr<ElasticSearchUtil> es_util, c
 
   std::map<std::string,Wt::WStandardItem*> node_map;
 
+  //The importer stores every ancestor's name on the document, so only older indices need a lookup per node
+  std::map<std::string,std::pair<std::string,std::string> > known_nodes; //Tree number -> name and id
+  if (source_object.member("ancestors"))
+  {
+    const Json::Array ancestors_array = source_object.getValue("ancestors").getArray();
+    Json::Array::const_iterator ancestors_iterator = ancestors_array.begin();
+    for (; ancestors_iterator!=ancestors_array.end(); ++ancestors_iterator)
+    {
+      const Json::Object ancestor_object = (*ancestors_iterator).getObject();
+      std::pair<std::string,std::string>& node = known_nodes[ancestor_object.getValue("tree_number").getString()];
+      SearchTab::InfoFromSourceObject(ancestor_object, node.first, &node.second);
+    }
+  }
+
   if (source_object.member("tree_numbers"))
   {
+    std::pair<std::string,std::string> this_node;
+    SearchTab::InfoFromSourceObject(source_object, this_node.first, &this_node.second);
+
     const Json::Array tree_numbers_array = source_object.getValue("tree_numbers").getArray();
     Json::Array::const_iterator tree_numbers_iterator = tree_numbers_array.begin();
     for (; tree_numbers_iterator!=tree_numbers_array.end(); ++tree_numbers_iterator)
+    {
+      known_nodes[(*tree_numbers_iterator).getString()] = this_node;
+    }
+    for (tree_numbers_iterator=tree_numbers_array.begin(); tree_numbers_iterator!=tree_numbers_array.end(); ++tree_numbers_iterator)
     {
       const Json::Value tree_number_value = *tree_numbers_iterator;
-      RecursiveAddHierarchyItem(es_util, row, node_map, tree_number_value.getString(), true);
+      RecursiveAddHierarchyItem(es_util, row, node_map, known_nodes, tree_number_value.getString(), true);
     }
   }
   if (source_object.member("child_tree_numbers"))
@@ -358,7 +414,7 @@ void MeshResult::PopulateHierarchy(std::shared_ptr<ElasticSearchUtil> es_util, c
     for (; child_tree_numbers_iterator!=child_tree_numbers_array.end(); ++child_tree_numbers_iterator)
     {
       const Json::Value child_tree_number_value = *child_tree_numbers_iterator;
-      RecursiveAddHierarchyItem(es_util, row, node_map, child_tree_number_value.getString(), false);
+      RecursiveAddHierarchyItem(es_util, row, node_map, known_nodes, child_tree_number_value.getString(), false);
     }
   }
 }
@@ -32,7 +32,8 @@ protected:
 private:
   void SetAndActivateDescription(Wt::WText* text_ctrl, const std::string& text);
   void SetOtherTermTexts(Wt::WLayout* term_layout, const Json::Array& terms_array);
-	void RecursiveAddHierarchyItem(std::shared_ptr<ElasticSearchUtil> es_util, int& row, std::map<std::string,Wt::WStandardItem*>& node_map, const std::string& tree_number, bool mark_item);
+	void RecursiveAddHierarchyItem(std::shared_ptr<ElasticSearchUtil> es_util, int& row, std::map<std::string,Wt::WStandardItem*>& node_map,
+	                               const std::map<std::string,std::pair<std::string,std::string> >& known_nodes, const std::string& tree_number, bool mark_item);
 	void PopulateHierarchy(std::shared_ptr<ElasticSearchUtil> es_util, const Json::Object& source_object);
 
 private:
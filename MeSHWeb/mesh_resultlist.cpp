@@ -31,7 +31,16 @@ void MeshResultList::OnSearch(const Wt::WString& filter)
   std::string cleaned_filter_str;
   SearchTab::CleanFilterString(filter_str, cleaned_filter_str);
 
-  Wt::WString query = Wt::WString::tr("SuggestionFilterQuery").arg(0).arg(RESULTLIST_COUNT).arg(filter);
+  std::string subtree_filter, subtree_sort;
+  Wt::WString query;
+  if (m_mesh_application->GetSearch()->GetSubtreeFilter(subtree_filter, &subtree_sort) && filter_str.empty())
+  {
+    query = Wt::WString::tr("SubtreeListQuery").arg(RESULTLIST_COUNT).arg(subtree_sort).arg(subtree_filter); //The whole subtree, in order of the tree numbers inside it
+  }
+  else
+  {
+    query = Wt::WString::tr("SuggestionFilterQuery").arg(0).arg(RESULTLIST_COUNT).arg(filter).arg(subtree_filter);
+  }
 
   Json::Object search_result;
   auto es_util = m_mesh_application->GetElasticSearchUtil();
@@ -9,6 +9,8 @@
 #include "application.h"
 
 #include "about_tab.h"
+#include "mesh_tree_path.h"
+#include "snapshot.h"
 
 
 SearchTab::SearchTab(const Wt::WString& text, MeSHApplication* mesh_application)
@@ -36,6 +38,12 @@ SearchTab::SearchTab(const Wt::WString& text, MeSHApplication* mesh_application)
 
   bindWidget("search_button", std::move(search_button));
 
+  m_subtree_text = bindWidget("subtree_text", std::make_unique<Wt::WText>());
+  auto subtree_clear_button = std::make_unique<Wt::WPushButton>(Wt::WString::tr("SearchSubtreeClear"));
+  subtree_clear_button->clicked().connect(this, &SearchTab::ClearSubtree);
+  bindWidget("subtree_clear", std::move(subtree_clear_button));
+  setCondition("show-subtree", false);
+
   setCondition("show-result", false);
   setCondition("show-resultlist", false);
   m_mesh_result = bindWidget("result", std::make_unique<MeshResult>(Wt::WString::tr("resultTemplate"), mesh_application));
@@ -61,6 +69,55 @@ void SearchTab::OnSearch(const Wt::WString& mesh_id)
   setCondition("show-resultlist", false);
 }
 
+void SearchTab::SetSubtree(const std::string& tree_number, const std::string& name)
+{
+  m_subtree_tree_number = tree_number;
+  m_subtree_text->setText(Wt::WString::tr("SearchSubtree").arg(name).arg(tree_number));
+  setCondition("show-subtree", true);
+}
+
+void SearchTab::ClearSubtree()
+{
+  m_subtree_tree_number.clear();
+  setCondition("show-subtree", false);
+}
+
+bool SearchTab::GetSubtreeFilter(std::string& filter, std::string* sort) const
+{
+  filter.clear();
+  if (sort)
+  {
+    sort->clear();
+  }
+  int64_t path;
+  int depth;
+  if (m_subtree_tree_number.empty() || !MeshTreePath(m_subtree_tree_number.c_str(), path, depth))
+  {
+    return false;
+  }
+
+  if (MESH_TREE_PATH_DEPTH < depth) //Too deep for its own path, see mesh_tree_path.h
+  {
+    filter = Wt::WString::tr("SubtreePrefixFilter").arg(m_subtree_tree_number).toUTF8();
+  }
+  else
+  {
+    const std::string path_str = std::to_string(path);
+    const std::string end_str = std::to_string(MeshTreePathSubtreeEnd(path, depth));
+    filter = Wt::WString::tr("SubtreeRangeFilter").arg(path_str).arg(end_str).toUTF8();
+    if (sort) //By the path inside the subtree, as a descriptor may also sit elsewhere in the tree
+    {
+      *sort = Wt::WString::tr("SubtreeRangeSort").arg(path_str).arg(end_str).toUTF8() + ", ";
+    }
+  }
+
+  if (sort) //Paths are shared below MESH_TREE_PATH_DEPTH, so also by the tree number inside the subtree
+  {
+    *sort += Wt::WString::tr("SubtreePrefixSort").arg(m_subtree_tree_number).toUTF8();
+  }
+  return true;
+}
+
 void SearchTab::SearchButtonClicked()
 {
 	m_mesh_resultlist->OnSearch(m_search_edit->text().toUTF8());
@@ -90,11 +147,21 @@ void SearchTab::FilterSuggestion(const Wt::WString& filter)
   std::string cleaned_filter_str;
   CleanFilterString(filter_str, cleaned_filter_str);
 
-  Wt::WString query = Wt::WString::tr("SuggestionFilterQuery").arg(0).arg(SUGGESTION_COUNT+1 /* +1 is to see if we got more than SUGGESTION_COUNT hits */).arg(filter);
+  //One hit per descriptor from the term index, with the term that matched best
+  std::string subtree_filter;
+  GetSubtreeFilter(subtree_filter);
+  Wt::WString query = Wt::WString::tr("SuggestionTermQuery").arg(0).arg(SUGGESTION_COUNT+1 /* +1 is to see if we got more than SUGGESTION_COUNT hits */).arg(filter).arg(subtree_filter);
 
   Json::Object search_result;
 	auto es_util = m_mesh_application->GetElasticSearchUtil();
-  long result_size = es_util->search("mesh", query.toUTF8(), search_result);
+  long result_size = es_util->search("mesh_terms", query.toUTF8(), search_result);
+  bool from_terms = (0 < result_size);
+  if (!from_terms) //Also when the term index is missing, or the search failed. The descriptor index can still answer
+  {
+    query = Wt::WString::tr("SuggestionFilterQuery").arg(0).arg(SUGGESTION_COUNT+1).arg(filter).arg(subtree_filter);
+    search_result = Json::Object();
+    result_size = es_util->search("mesh", query.toUTF8(), search_result);
+  }
 
   int row = 0;
   if (0 == result_size)
@@ -127,7 +194,14 @@ void SearchTab::FilterSuggestion(const Wt::WString& filter)
       std::unique_ptr<Wt::WStandardItem> item;
       if (std::string::npos == lowercase_name_str.find(lowercase_filter_str))
       {
-        FindIndirectHit(source_object, cleaned_filter_str, indirect_hit_str);
+        if (!from_terms)
+        {
+          FindIndirectHit(source_object, cleaned_filter_str, indirect_hit_str);
+        }
+        else if (source_object.member("term") && source_object.getValue("term").getString() != name_str)
+        {
+          indirect_hit_str = source_object.getValue("term").getString();
+        }
       }
 
       if (!indirect_hit_str.empty())
@@ -308,6 +382,14 @@ void SearchTab::MeSHToName(std::shared_ptr<ElasticSearchUtil> es_util, const std
 {
   name = mesh_id;
 
+  std::shared_ptr<const MeshSnapshot> snapshot = MeshSnapshot::Get();
+  uint32_t descriptor;
+  if (snapshot && snapshot->FindDescriptor(mesh_id, descriptor))
+  {
+    name = snapshot->GetName(descriptor);
+    return;
+  }
+
   Wt::WString query = Wt::WString::tr("SearchFilterQuery").arg(mesh_id);
   Json::Object search_result;
   long result_size = es_util->search("mesh", query.toUTF8(), search_result);
@@ -323,6 +405,19 @@ void SearchTab::TreeNumberToName(std::shared_ptr<ElasticSearchUtil> es_util, con
 {
 	name = tree_number;
 
+	std::shared_ptr<const MeshSnapshot> snapshot = MeshSnapshot::Get();
+	uint32_t tree_number_index;
+	if (snapshot && snapshot->FindTreeNumber(tree_number, tree_number_index))
+	{
+		uint32_t descriptor = snapshot->GetTreeNumberDescriptor(tree_number_index);
+		name = snapshot->GetName(descriptor);
+		if (nullptr != mesh_id)
+		{
+			*mesh_id = snapshot->GetId(descriptor);
+		}
+		return;
+	}
+
 	Wt::WString query = Wt::WString::tr("HierarchyTreeNodeQuery").arg(tree_number);
 	Json::Object search_result;
 	long result_size = es_util->search("mesh", query.toUTF8(), search_result);
@@ -5,6 +5,7 @@
 #include <Wt/WStandardItemModel.h>
 #include <Wt/WSuggestionPopup.h>
 #include <Wt/WTemplate.h>
+#include <Wt/WText.h>
 
 #define INLINE_JAVASCRIPT(...) #__VA_ARGS__
 
@@ -25,6 +26,10 @@ public:
   void FocusSearchEdit();
   void OnSearch(const Wt::WString& mesh_id);
 
+  void SetSubtree(const std::string& tree_number, const std::string& name); //Searches only find descriptors under it
+  void ClearSubtree();
+  bool GetSubtreeFilter(std::string& filter, std::string* sort = nullptr) const; //A query clause for the subtree, if one is set, and optionally sort clauses for tree order within it
+
 protected:
   void SearchButtonClicked();
   void OnSearchEditFocussed();
@@ -48,6 +53,8 @@ private:
   MeSHApplication* m_mesh_application;
 
   Wt::WLineEdit* m_search_edit;
+  Wt::WText* m_subtree_text;
+  std::string m_subtree_tree_number;
   std::unique_ptr<Wt::WSuggestionPopup> m_search_suggestion;
   std::shared_ptr<Wt::WStandardItemModel> m_search_suggestion_model;
 
@@ -0,0 +1,257 @@
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <mutex>
+
+#include <boost/algorithm/string/replace.hpp>
+
+#include "application.h"
+#include "elasticsearchutil.h"
+#include "global.h"
+
+
+static std::mutex s_snapshot_mutex;
+static std::shared_ptr<const MeshSnapshot> s_snapshot; //What Get() returns. s_mapped_snapshot while it matches the mesh index
+static std::shared_ptr<const MeshSnapshot> s_mapped_snapshot;
+static ino_t s_snapshot_inode = 0;
+static time_t s_snapshot_mtime = 0;
+
+
+MeshSnapshot::MeshSnapshot()
+: m_data(nullptr),
+  m_size(0),
+  m_header(nullptr),
+  m_descriptors(nullptr),
+  m_tree_numbers(nullptr),
+  m_children(nullptr),
+  m_descriptor_tree_numbers(nullptr),
+  m_strings(nullptr)
+{
+}
+
+MeshSnapshot::~MeshSnapshot()
+{
+  Unmap();
+}
+
+bool MeshSnapshot::Load(const std::string& filename)
+{
+  Unmap();
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (-1 == fd)
+  {
+    return false;
+  }
+
+  struct stat filestat;
+  if (0==fstat(fd, &filestat) && sizeof(MeshSnapshotHeader)<=static_cast<size_t>(filestat.st_size))
+  {
+    m_size = filestat.st_size;
+    m_data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == m_data)
+    {
+      m_data = nullptr;
+    }
+  }
+  close(fd);
+  if (!m_data)
+  {
+    return false;
+  }
+
+  const char* data = static_cast<const char*>(m_data);
+  const MeshSnapshotHeader* header = reinterpret_cast<const MeshSnapshotHeader*>(data);
+  auto fits = [this](uint64_t offset, uint64_t length) {return offset<=m_size && length<=m_size-offset;};
+  auto table_fits = [&fits](uint64_t offset, uint64_t length) {return 0==offset%sizeof(uint32_t) && fits(offset, length);};
+  if (0 != memcmp(header->magic, MESH_SNAPSHOT_MAGIC, sizeof(header->magic)) ||
+      MESH_SNAPSHOT_VERSION != header->version ||
+      sizeof(MeshSnapshotHeader) != header->header_size ||
+      m_size != header->file_size ||
+      '\0' != header->index_name[sizeof(header->index_name)-1] ||
+      !table_fits(header->descriptors_offset, uint64_t(header->descriptor_count)*sizeof(MeshSnapshotDescriptor)) ||
+      !table_fits(header->tree_numbers_offset, uint64_t(header->tree_number_count)*sizeof(MeshSnapshotTreeNumber)) ||
+      !table_fits(header->children_offset, uint64_t(header->child_count)*sizeof(uint32_t)) ||
+      !table_fits(header->descriptor_tree_numbers_offset, uint64_t(header->descriptor_tree_number_count)*sizeof(uint32_t)) ||
+      !fits(header->strings_offset, header->strings_size) || 0==header->strings_size ||
+      '\0' != data[header->strings_offset + header->strings_size - 1] ||
+      header->checksum != MeshSnapshotChecksum(data+sizeof(MeshSnapshotHeader), m_size-sizeof(MeshSnapshotHeader)))
+  {
+    Unmap();
+    return false;
+  }
+
+  m_header = header;
+  m_descriptors = reinterpret_cast<const MeshSnapshotDescriptor*>(data + header->descriptors_offset);
+  m_tree_numbers = reinterpret_cast<const MeshSnapshotTreeNumber*>(data + header->tree_numbers_offset);
+  m_children = reinterpret_cast<const uint32_t*>(data + header->children_offset);
+  m_descriptor_tree_numbers = reinterpret_cast<const uint32_t*>(data + header->descriptor_tree_numbers_offset);
+  m_strings = data + header->strings_offset;
+  if (!CheckTables())
+  {
+    Unmap();
+    return false;
+  }
+  return true;
+}
+
+bool MeshSnapshot::CheckTables() const
+//The lookups index the tables with what the tables hold, so every such index must be inside its table. The string
+//section ends with a NUL, so any offset inside it is a terminated string
+{
+  const uint64_t strings_size = m_header->strings_size;
+  for (uint32_t i=0; i<m_header->descriptor_count; i++)
+  {
+    const MeshSnapshotDescriptor& item = m_descriptors[i];
+    if (strings_size<=item.id || strings_size<=item.nor_name || strings_size<=item.eng_name ||
+        m_header->descriptor_tree_number_count < uint64_t(item.first_tree_number)+item.tree_number_count)
+    {
+      return false;
+    }
+  }
+
+  for (uint32_t i=0; i<m_header->tree_number_count; i++)
+  {
+    const MeshSnapshotTreeNumber& item = m_tree_numbers[i];
+    if (strings_size<=item.tree_number || m_header->descriptor_count<=item.descriptor ||
+        m_header->child_count < uint64_t(item.first_child)+item.child_count)
+    {
+      return false;
+    }
+  }
+
+  for (uint32_t i=0; i<m_header->child_count; i++)
+  {
+    if (m_header->tree_number_count <= m_children[i])
+    {
+      return false;
+    }
+  }
+
+  for (uint32_t i=0; i<m_header->descriptor_tree_number_count; i++)
+  {
+    if (m_header->tree_number_count <= m_descriptor_tree_numbers[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MeshSnapshot::FindDescriptor(const std::string& id, uint32_t& descriptor) const
+{
+  const MeshSnapshotDescriptor* end = m_descriptors + m_header->descriptor_count;
+  const MeshSnapshotDescriptor* found = std::lower_bound(m_descriptors, end, id,
+    [this](const MeshSnapshotDescriptor& item, const std::string& value) {return 0 > strcmp(String(item.id), value.c_str());});
+  if (end==found || EQUAL!=id.compare(String(found->id)))
+  {
+    return false;
+  }
+
+  descriptor = found - m_descriptors;
+  return true;
+}
+
+bool MeshSnapshot::FindTreeNumber(const std::string& tree_number, uint32_t& tree_number_index) const
+{
+  const MeshSnapshotTreeNumber* end = m_tree_numbers + m_header->tree_number_count;
+  const MeshSnapshotTreeNumber* found = std::lower_bound(m_tree_numbers, end, tree_number,
+    [this](const MeshSnapshotTreeNumber& item, const std::string& value) {return 0 > strcmp(String(item.tree_number), value.c_str());});
+  if (end==found || EQUAL!=tree_number.compare(String(found->tree_number)))
+  {
+    return false;
+  }
+
+  tree_number_index = found - m_tree_numbers;
+  return true;
+}
+
+std::string MeshSnapshot::GetName(uint32_t descriptor) const
+{
+  const MeshSnapshotDescriptor& item = m_descriptors[descriptor];
+  std::string name = String(item.nor_name);
+  if (name.empty())
+  {
+    name = String(item.eng_name);
+  }
+  if (name.empty())
+  {
+    name = String(item.id);
+  }
+
+  boost::algorithm::replace_all(name, "\\n", "");
+  return name;
+}
+
+std::shared_ptr<const MeshSnapshot> MeshSnapshot::Get()
+{
+  return std::atomic_load(&s_snapshot);
+}
+
+void MeshSnapshot::Refresh(const std::string& app_root, ElasticSearchUtil& es_util)
+{
+  const char* environment_filename = getenv("MESH_SNAPSHOT");
+  std::string filename = environment_filename ? environment_filename : app_root + DEFAULT_SNAPSHOT_FILENAME;
+
+  //Asked before locking, so sessions do not wait for each other's requests
+  std::string index_name;
+  Json::Object meta;
+  bool index_known = es_util.getIndexMeta("mesh", index_name, meta);
+
+  std::lock_guard<std::mutex> lock(s_snapshot_mutex);
+  struct stat filestat;
+  if (0 != stat(filename.c_str(), &filestat)) //MeSHImport removes a snapshot it could not bring up to date
+  {
+    s_mapped_snapshot.reset();
+    s_snapshot_inode = 0;
+    s_snapshot_mtime = 0;
+  }
+  else if (filestat.st_ino!=s_snapshot_inode || filestat.st_mtime!=s_snapshot_mtime) //MeSHImport replaces the file by renaming, so a new snapshot has a new inode
+  {
+    s_snapshot_inode = filestat.st_ino;
+    s_snapshot_mtime = filestat.st_mtime;
+
+    auto snapshot = std::make_shared<MeshSnapshot>();
+    if (snapshot->Load(filename))
+    {
+      s_mapped_snapshot = snapshot;
+    }
+    else
+    {
+      s_mapped_snapshot.reset();
+      Log("error", "Ignoring invalid MeSH snapshot " + filename);
+    }
+  }
+
+  //Without ElasticSearch the snapshot is all there is. Otherwise it must be of the index and stamp the mesh alias has now
+  std::shared_ptr<const MeshSnapshot> snapshot = s_mapped_snapshot;
+  if (snapshot && index_known &&
+      (EQUAL!=index_name.compare(snapshot->GetIndexName()) || !meta.member(MESH_SNAPSHOT_META_KEY) ||
+       EQUAL!=meta.getValue(MESH_SNAPSHOT_META_KEY).getString().compare(std::to_string(snapshot->GetIndexStamp()))))
+  {
+    if (std::atomic_load(&s_snapshot))
+    {
+      Log("info", "Not using MeSH snapshot " + filename + ", the mesh index has changed since it was written");
+    }
+    snapshot.reset();
+  }
+  std::atomic_store(&s_snapshot, snapshot);
+}
+
+void MeshSnapshot::Unmap()
+{
+  if (m_data)
+  {
+    munmap(m_data, m_size);
+  }
+  m_data = nullptr;
+  m_size = 0;
+  m_header = nullptr;
+}
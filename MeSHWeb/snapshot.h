@@ -0,0 +1,66 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "mesh_snapshot.h"
+
+#define DEFAULT_SNAPSHOT_FILENAME "mesh.snapshot" //In the application root. Override with the MESH_SNAPSHOT environment variable
+
+class ElasticSearchUtil;
+
+
+// Memory-mapped snapshot written by MeSHImport --snapshot. Answers id, tree
+// number and children lookups without asking ElasticSearch.
+class MeshSnapshot
+{
+public:
+  MeshSnapshot();
+  ~MeshSnapshot();
+
+public:
+  bool Load(const std::string& filename);
+
+  bool FindDescriptor(const std::string& id, uint32_t& descriptor) const;
+  bool FindTreeNumber(const std::string& tree_number, uint32_t& tree_number_index) const;
+
+  const char* GetIndexName() const {return m_header->index_name;}
+  uint64_t GetIndexStamp() const {return m_header->index_stamp;}
+
+  const char* GetId(uint32_t descriptor) const {return String(m_descriptors[descriptor].id);}
+  std::string GetName(uint32_t descriptor) const; //Same choice as SearchTab::InfoFromSourceObject
+  bool IsTopNode(uint32_t descriptor) const {return 0 != (m_descriptors[descriptor].flags & MESH_SNAPSHOT_TOP_NODE);}
+
+  uint32_t GetTreeNumberCount() const {return m_header->tree_number_count;}
+  const char* GetTreeNumber(uint32_t tree_number_index) const {return String(m_tree_numbers[tree_number_index].tree_number);}
+  uint32_t GetTreeNumberDescriptor(uint32_t tree_number_index) const {return m_tree_numbers[tree_number_index].descriptor;}
+  uint32_t GetChildCount(uint32_t tree_number_index) const {return m_tree_numbers[tree_number_index].child_count;}
+  uint32_t GetChild(uint32_t tree_number_index, uint32_t child) const {return m_children[m_tree_numbers[tree_number_index].first_child + child];}
+
+public:
+  static std::shared_ptr<const MeshSnapshot> Get(); //nullptr if there is no usable snapshot. Use ElasticSearch then
+  // Maps the snapshot again if MeSHImport has replaced it, and stops using it
+  // once the mesh index has changed since it was written
+  static void Refresh(const std::string& app_root, ElasticSearchUtil& es_util);
+
+private:
+  const char* String(uint32_t offset) const {return m_strings + offset;}
+  bool CheckTables() const;
+  void Unmap();
+
+private:
+  void* m_data;
+  size_t m_size;
+
+  const MeshSnapshotHeader* m_header;
+  const MeshSnapshotDescriptor* m_descriptors;
+  const MeshSnapshotTreeNumber* m_tree_numbers;
+  const uint32_t* m_children;
+  const uint32_t* m_descriptor_tree_numbers;
+  const char* m_strings;
+};
+
+#endif // _SNAPSHOT_H_
@@ -0,0 +1,87 @@
+#ifndef _MESH_SNAPSHOT_H_
+#define _MESH_SNAPSHOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary MeSH snapshot, written by MeSHImport and memory-mapped by MeSHWeb.
+//
+// Layout (little endian, every section 8-byte aligned):
+//   MeshSnapshotHeader
+//   MeshSnapshotDescriptor[descriptor_count]    sorted by id
+//   MeshSnapshotTreeNumber[tree_number_count]   sorted by tree number
+//   uint32_t[child_count]                       tree number indices, children of each tree number
+//   uint32_t[descriptor_tree_number_count]      tree number indices, tree numbers of each descriptor
+//   char[strings_size]                          NUL-terminated strings. Offset 0 is ""
+//
+// Offsets in the header are from the start of the file. String references are
+// offsets into the string section. The checksum covers everything after the header.
+//
+// index_name and index_stamp tell which state of the mesh index the snapshot was
+// built from. MeSHImport stores a new stamp in the index's _meta whenever it
+// changes documents in place, and MeSHWeb only uses a snapshot while the mesh
+// alias still points to index_name with that stamp. An empty index_name is a
+// snapshot written with --emit-ndjson, before the shards are loaded anywhere.
+
+#define MESH_SNAPSHOT_MAGIC   "MESHSNAP"
+#define MESH_SNAPSHOT_VERSION (2)
+
+#define MESH_SNAPSHOT_META_KEY "snapshot_stamp" //In the mesh index's _meta, as a string
+
+#define MESH_SNAPSHOT_TOP_NODE (1u<<0)
+
+
+struct MeshSnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t file_size;
+    uint64_t checksum;
+    uint64_t created; //Unix time
+    char index_name[64]; //NUL-terminated
+    uint64_t index_stamp;
+
+    uint32_t descriptor_count;
+    uint32_t tree_number_count;
+    uint32_t child_count;
+    uint32_t descriptor_tree_number_count;
+    uint64_t strings_size;
+
+    uint64_t descriptors_offset;
+    uint64_t tree_numbers_offset;
+    uint64_t children_offset;
+    uint64_t descriptor_tree_numbers_offset;
+    uint64_t strings_offset;
+};
+
+struct MeshSnapshotDescriptor
+{
+    uint32_t id;
+    uint32_t nor_name;
+    uint32_t eng_name;
+    uint32_t flags;
+    uint32_t first_tree_number; //Into the descriptor tree number section
+    uint32_t tree_number_count;
+};
+
+struct MeshSnapshotTreeNumber
+{
+    uint32_t tree_number;
+    uint32_t descriptor;
+    uint32_t first_child; //Into the children section
+    uint32_t child_count;
+};
+
+inline uint64_t MeshSnapshotChecksum(const char* data, size_t length) //64-bit FNV-1a
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i=0; i<length; i++)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+#endif // _MESH_SNAPSHOT_H_
@@ -0,0 +1,89 @@
+#ifndef _MESH_TREE_PATH_H_
+#define _MESH_TREE_PATH_H_
+
+#include <stdint.h>
+
+// Fixed-width numeric encoding of a MeSH tree number, stored by MeSHImport in
+// tree_paths and used by MeSHWeb for subtree range filters.
+//
+// A tree number is a category letter, two digits and then groups of three
+// digits, e.g. "C04.557.337". The path is 62 bits, most significant first:
+//   5 bits   category letter, A=1 .. Z=26
+//   7 bits   first group, 00..99 stored as 1..100
+//   5x10 bits next groups, 000..999 stored as 1..1000
+// A level the tree number does not have is 0, so a parent sorts right before
+// its children and comparing paths compares tree numbers. Everything under a
+// tree number lies between its path and MeshTreePathSubtreeEnd() of it.
+// Levels deeper than MESH_TREE_PATH_DEPTH are cut off, so those tree numbers
+// share the path of their ancestor at that depth. Their subtrees need a
+// prefix filter on tree_numbers instead.
+
+#define MESH_TREE_PATH_DEPTH (6) //Levels with their own bits, counting "C04" as 1
+
+#define MESH_TREE_PATH_LETTER_SHIFT (57)
+#define MESH_TREE_PATH_FIRST_SHIFT  (50)
+#define MESH_TREE_PATH_GROUP_BITS   (10)
+
+
+inline int MeshTreePathShift(int depth) //Of the lowest bit of the level at depth
+{
+    return (0 >= depth) ? MESH_TREE_PATH_LETTER_SHIFT
+                        : MESH_TREE_PATH_FIRST_SHIFT - (depth-1)*MESH_TREE_PATH_GROUP_BITS;
+}
+
+inline bool MeshTreePathDigits(const char* text, int count, int64_t& value)
+{
+    value = 0;
+    for (int i=0; i<count; i++)
+    {
+        if ('0'>text[i] || '9'<text[i])
+            return false;
+        value = value*10 + (text[i]-'0');
+    }
+    return true;
+}
+
+// False if tree_number is not a well-formed tree number. depth is the real
+// depth, also when it is deeper than the path can tell apart
+inline bool MeshTreePath(const char* tree_number, int64_t& path, int& depth)
+{
+    path = 0;
+    depth = 0;
+    if ('A'>tree_number[0] || 'Z'<tree_number[0])
+        return false;
+
+    path = static_cast<int64_t>(tree_number[0]-'A'+1) << MESH_TREE_PATH_LETTER_SHIFT;
+    const char* group = tree_number+1;
+    if ('\0' == *group) //A forced topnode, e.g. "C"
+        return true;
+
+    int64_t value;
+    if (!MeshTreePathDigits(group, 2, value))
+        return false;
+    path |= (value+1) << MESH_TREE_PATH_FIRST_SHIFT;
+    depth = 1;
+    group += 2;
+
+    while ('\0' != *group)
+    {
+        if ('.'!=group[0] || !MeshTreePathDigits(group+1, 3, value))
+            return false;
+        depth++;
+        if (MESH_TREE_PATH_DEPTH >= depth)
+        {
+            path |= (value+1) << MeshTreePathShift(depth);
+        }
+        group += 4;
+    }
+    return true;
+}
+
+// The largest path under the tree number at depth with the given path
+inline int64_t MeshTreePathSubtreeEnd(int64_t path, int depth)
+{
+    if (MESH_TREE_PATH_DEPTH <= depth)
+        return path;
+    return path | ((static_cast<int64_t>(1) << MeshTreePathShift(depth)) - 1);
+}
+
+#endif // _MESH_TREE_PATH_H_